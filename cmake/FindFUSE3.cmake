@@ -0,0 +1,50 @@
+# This module can find the libfuse 3 library
+#
+# The following variables will be defined for your use:
+# - FUSE3_FOUND : was libfuse 3 found?
+# - FUSE3_INCLUDE_DIRS : directory containing fuse.h
+# - FUSE3_LIBRARIES : libfuse 3 library
+# - FUSE3_VERSION : version reported by pkg-config, if available
+#
+# Example Usage:
+#
+# find_package(FUSE3 3.8 REQUIRED)
+# target_include_directories(myapp PRIVATE ${FUSE3_INCLUDE_DIRS})
+# target_link_libraries(myapp PRIVATE ${FUSE3_LIBRARIES})
+
+find_package(PkgConfig QUIET)
+
+if(PKG_CONFIG_FOUND)
+    pkg_check_modules(PC_FUSE3 QUIET fuse3)
+endif()
+
+# the headers are installed as fuse3/fuse.h next to the libfuse 2 ones,
+# so look for the subdirectory explicitly and hand that out
+find_path(
+    FUSE3_INCLUDE_PREFIX
+    NAMES fuse3/fuse.h
+    HINTS ${PC_FUSE3_INCLUDEDIR}
+    DOC "Include prefix for libfuse 3"
+)
+
+find_library(
+    FUSE3_LIBRARIES
+    NAMES fuse3
+    HINTS ${PC_FUSE3_LIBDIR} ${PC_FUSE3_LIBRARY_DIRS}
+    DOC "libfuse 3 library"
+)
+
+if(FUSE3_INCLUDE_PREFIX)
+    set(FUSE3_INCLUDE_DIRS "${FUSE3_INCLUDE_PREFIX}/fuse3")
+endif()
+
+set(FUSE3_VERSION "${PC_FUSE3_VERSION}")
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(
+    FUSE3
+    REQUIRED_VARS FUSE3_LIBRARIES FUSE3_INCLUDE_DIRS
+    VERSION_VAR FUSE3_VERSION
+)
+
+mark_as_advanced(FUSE3_INCLUDE_PREFIX FUSE3_LIBRARIES)
@@ -0,0 +1,40 @@
+# This module can find liburing
+#
+# The following variables will be defined for your use:
+# - LibUring_FOUND : was liburing found?
+# - LIBURING_INCLUDE_DIRS : directory containing liburing.h
+# - LIBURING_LIBRARIES : liburing library
+#
+# Example Usage:
+#
+# find_package(LibUring REQUIRED)
+# target_include_directories(myapp PRIVATE ${LIBURING_INCLUDE_DIRS})
+# target_link_libraries(myapp PRIVATE ${LIBURING_LIBRARIES})
+
+find_package(PkgConfig QUIET)
+
+if(PKG_CONFIG_FOUND)
+    pkg_check_modules(PC_LIBURING QUIET liburing)
+endif()
+
+find_path(
+    LIBURING_INCLUDE_DIRS
+    NAMES liburing.h
+    HINTS ${PC_LIBURING_INCLUDEDIR} ${PC_LIBURING_INCLUDE_DIRS}
+    DOC "Include directory for liburing"
+)
+
+find_library(
+    LIBURING_LIBRARIES
+    NAMES uring
+    HINTS ${PC_LIBURING_LIBDIR} ${PC_LIBURING_LIBRARY_DIRS}
+    DOC "liburing library"
+)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(
+    LibUring
+    REQUIRED_VARS LIBURING_LIBRARIES LIBURING_INCLUDE_DIRS
+)
+
+mark_as_advanced(LIBURING_INCLUDE_DIRS LIBURING_LIBRARIES)
@@ -10,8 +10,6 @@
  * **
  */
 
-#define FUSE_USE_VERSION 29
-
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
@@ -19,6 +17,7 @@
 #include <fuse.h>
 
 #include "mungefs_operations.hpp"
+#include "mungefs_options.hpp"
 
 static struct fuse_operations mungefs_oper = {
 	.getattr     = mungefs_getattr,
@@ -54,8 +53,10 @@ static struct fuse_operations mungefs_oper = {
 
     .access      = mungefs_access,
     .create      = mungefs_create,
+#if FUSE_MAJOR_VERSION < 3
     .ftruncate   = mungefs_ftruncate,
     .fgetattr    = mungefs_fgetattr,
+#endif
     .lock        = mungefs_lock,
     .utimens     = mungefs_utimens,
     .bmap        = mungefs_bmap,
@@ -63,11 +64,22 @@ static struct fuse_operations mungefs_oper = {
     .poll        = mungefs_poll,
     .flock       = mungefs_flock,
     .fallocate   = mungefs_fallocate,
+#if FUSE_MAJOR_VERSION >= 3
+    .copy_file_range = mungefs_copy_file_range,
+    .lseek           = mungefs_lseek,
+#endif
 };
 
 int main(int argc, char *argv[]) {
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    if (parse_mungefs_options(&args)) {
+        return 1;
+    }
+
     printf("starting fuse filesystem\n");
-	return fuse_main(argc, argv, &mungefs_oper, NULL);
+	int ret = fuse_main(args.argc, args.argv, &mungefs_oper, NULL);
+    fuse_opt_free_args(&args);
+    return ret;
 }
 
 
@@ -6,6 +6,7 @@
 
 #include <vector>
 #include <iostream>
+#include <memory>
 #include <sstream>
 
 #include "zmq.hpp"
@@ -41,6 +42,18 @@ public:
 
     typedef std::vector<uint8_t> data_type;
 
+    // where the socket errors the broker swallows are reported. clients
+    // keep stderr, the mungefs server sends them to its log.
+    typedef void (*error_reporter)(const char* _what);
+
+    static error_reporter& reporter() {
+        static error_reporter report = [](const char* _what) {
+            std::cerr << _what << std::endl;
+        };
+
+        return report;
+    }
+
     message_broker(const message_broker& _rhs) = delete;
     message_broker& operator=(const message_broker& _rhs) = delete;
 
@@ -71,74 +84,112 @@ public:
         }
     }
 
-    void send(const data_type& _data) {
+    // hand _data to zmq without copying it, zmq frees it once sent
+    void send(data_type&& _data, const int _flags=0) {
+        if(_data.empty()) {
+            zmq::message_t msg;
+            send(msg, _flags);
+            return;
+        }
+
+        std::unique_ptr<data_type> owned(new data_type(std::move(_data)));
+        zmq::message_t msg(owned->data(), owned->size(), free_data, owned.get());
+        owned.release();
+        send(msg, _flags);
+    }
+
+    void send(const data_type& _data, const int _flags=0) {
+        send(data_type(_data), _flags);
+    }
+
+    // a full queue or a missing peer is waited out by polling, backing off
+    // up to the send timeout, after which the message is dropped
+    void send(zmq::message_t& _data, const int _flags=0) {
         try {
-            zmq::message_t msg( _data.size() );
-            memcpy(
-                msg.data(),
-                _data.data(),
-                _data.size() );
-            while(!skt_ptr_->send( msg ) ) {
-                //TODO: need backoff
-                    continue;
+            long backoff_ms = 1;
+            long waited_ms = 0;
+            while(!skt_ptr_->send( _data, _flags | ZMQ_DONTWAIT ) ) {
+                if(waited_ms >= time_out_ms) {
+                    throw exception(-1, "time out in send");
+                }
+
+                wait_for(ZMQ_POLLOUT, backoff_ms);
+                waited_ms += backoff_ms;
+                if(backoff_ms < max_backoff_ms) {
+                    backoff_ms *= 2;
+                }
             }
         }
         catch ( const zmq::error_t& _e) {
-            std::cerr << _e.what() << std::endl;
+            reporter()(_e.what());
         }
     }
 
-    void send(zmq::message_t& _data) {
+    // wait for a message, returning false if none came in time or, with
+    // ZMQ_DONTWAIT, none was there. the message keeps the buffer zmq
+    // received it into, so nothing is copied.
+    bool receive(zmq::message_t& _msg, const int _flags=0) {
         try {
-            while(!skt_ptr_->send( _data ) ) {
-                //TODO: need backoff
-                    continue;
-            }
+            return skt_ptr_->recv( &_msg, _flags );
         }
         catch ( const zmq::error_t& _e) {
-            std::cerr << _e.what() << std::endl;
+            // interrupted by a signal, the caller waits again
+            reporter()(_e.what());
+            return false;
         }
     }
 
-    void receive(data_type& _data, const int flags=0, const bool debug=false) {
-        try {
-            zmq::message_t msg;
-            while(true) {
-                int ret = skt_ptr_->recv( &msg, flags );
-                if(-1 == ret && ZMQ_DONTWAIT == flags) {
-                    if(debug) {
-                        std::cout << "dontwait failed in receive" << std::endl; fflush(stdout);
-                    }
-                    if(zmq_errno() == EAGAIN) {
-                        if(debug) {
-                           std::cout << "dontwait with EAGAIN" << std::endl; fflush(stdout);
-                        }
-                        break;
-                    }
-                }
-                else if(ret <= 0 && ZMQ_DONTWAIT != flags) {
-                    int eno = zmq_errno();
-                    std::cout << "read error :: ret - " << ret << "    errno - " << eno << std::endl;
-                    if(EAGAIN == ret || eno == EAGAIN) {
-                        throw exception(-1, "time out in receive");
-                    }
-
-                    //TODO: need backoff
-                    continue;
-                }
-                break;
-            }
-        
-            if(msg.size() > 0) {
-                _data.resize(msg.size());
-                std::memcpy(_data.data(), msg.data(), msg.size());
+    // throws if a blocking receive times out
+    void receive(data_type& _data, const int _flags=0) {
+        zmq::message_t msg;
+        if(!receive(msg, _flags)) {
+            if(ZMQ_DONTWAIT & _flags) {
+                return;
             }
+
+            throw exception(-1, "time out in receive");
+        }
+
+        const uint8_t* data = static_cast<const uint8_t*>(msg.data());
+        _data.assign(data, data + msg.size());
+    }
+
+    // a dealer talking to a rep socket frames every message with an
+    // empty delimiter, as a req socket would, and may have many in flight
+    void send_envelope(data_type _data) {
+        zmq::message_t delimiter;
+        send(delimiter, ZMQ_SNDMORE);
+        send(std::move(_data));
+    }
+
+    void receive_envelope(zmq::message_t& _msg) {
+        zmq::message_t delimiter;
+        if(!receive(delimiter) || !receive(_msg)) {
+            throw exception(-1, "time out in receive");
+        }
+    }
+
+    void receive_envelope(data_type& _data) {
+        data_type delimiter;
+        receive(delimiter);
+        receive(_data);
+    }
+
+    // wait up to _timeout_ms for the socket to be ready for _events
+    bool wait_for(const short _events, const long _timeout_ms) {
+        zmq::pollitem_t item = { static_cast<void*>(*skt_ptr_), 0, _events, 0 };
+        try {
+            return zmq::poll(&item, 1, _timeout_ms) > 0;
         }
         catch ( const zmq::error_t& _e) {
-            std::cerr << _e.what() << std::endl;
+            return false;
         }
     }
 
+    zmq::socket_t& socket() {
+        return *skt_ptr_;
+    }
+
     void connect(const std::string& _conn) {
         try {
             skt_ptr_->connect(_conn);
@@ -190,14 +241,23 @@ public:
 
 
 private:
+    static void free_data(void* _data, void* _hint) {
+        delete static_cast<data_type*>(_hint);
+    }
+
     void create_socket(const std::string& _ctx) {
         try {
-            int time_out = 1500;
+            int time_out = time_out_ms;
             if("ZMQ_REQ" == _ctx ) {
                 skt_ptr_ = std::unique_ptr<zmq::socket_t>(
                                std::make_unique<zmq::socket_t>(
                                    *ctx_ptr_, ZMQ_REQ));
             }
+            else if("ZMQ_DEALER" == _ctx ) {
+                skt_ptr_ = std::unique_ptr<zmq::socket_t>(
+                               std::make_unique<zmq::socket_t>(
+                                   *ctx_ptr_, ZMQ_DEALER));
+            }
             else {
                 skt_ptr_ = std::unique_ptr<zmq::socket_t>(
                                std::make_unique<zmq::socket_t>(
@@ -213,6 +273,9 @@ private:
         }
     }
 
+    static const long time_out_ms = 1500;
+    static const long max_backoff_ms = 64;
+
     zmq::context_t* ctx_ptr_;
     bool do_not_delete_ctx_ptr_;
     std::unique_ptr<zmq::socket_t> skt_ptr_;
@@ -220,7 +283,7 @@ private:
 }; // class message_broker
 
 
-std::ostream& operator<<(
+inline std::ostream& operator<<(
     std::ostream& _os,
     const message_broker::data_type& _dt) {
     std::string msg;
@@ -0,0 +1,169 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+#include "mungefs_caller.hpp"
+
+// how long a cached entry is trusted, bounding how stale it gets after
+// an exec or a reused pid
+static const std::chrono::milliseconds entry_lifetime(1000);
+
+// a shard drops its expired entries once it grows past this
+static const size_t shard_prune_size = 1024;
+
+// deepest process tree walked looking for an ancestor
+static const int max_tree_depth = 64;
+
+class process_cache {
+public:
+    struct entry {
+        std::string name;
+        pid_t       ppid;
+        pid_t       tgid;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    // false if the process is gone
+    bool lookup(pid_t _pid, entry& _out) {
+        auto& shard = shards_[static_cast<size_t>(_pid) % shard_count];
+        const auto now = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lk(shard.mutex);
+            auto it = shard.entries.find(_pid);
+            if (shard.entries.end() != it && it->second.expires > now) {
+                _out = it->second;
+                return true;
+            }
+        }
+
+        // read without the lock, racing readers just both store the result
+        if (!read_stat(_pid, _out)) {
+            return false;
+        }
+
+        _out.expires = now + entry_lifetime;
+        std::lock_guard<std::mutex> lk(shard.mutex);
+        if (shard.entries.size() >= shard_prune_size) {
+            prune(shard, now);
+        }
+
+        shard.entries[_pid] = _out;
+        return true;
+    }
+
+private:
+    struct shard {
+        std::mutex                       mutex;
+        std::unordered_map<pid_t, entry> entries;
+    };
+
+    static const size_t shard_count = 16;
+
+    // /proc/<pid>/stat is "pid (comm) state ppid ...", comm may itself
+    // contain spaces and parentheses so it ends at the last ')'
+    static bool read_stat(pid_t _pid, entry& _out) {
+        std::ifstream in("/proc/" + std::to_string(_pid) + "/stat");
+        std::string stat;
+        if (!in || !std::getline(in, stat)) {
+            return false;
+        }
+
+        const auto open = stat.find('(');
+        const auto close = stat.rfind(')');
+        if (std::string::npos == open || std::string::npos == close || close < open) {
+            return false;
+        }
+
+        _out.name = stat.substr(open + 1, close - open - 1);
+
+        std::istringstream rest(stat.substr(close + 1));
+        char state = 0;
+        long ppid = 0;
+        if (!(rest >> state >> ppid)) {
+            return false;
+        }
+
+        _out.ppid = ppid;
+        return read_tgid(_pid, _out);
+    }
+
+    // the stat of a thread names the thread, the tgid only shows in status
+    static bool read_tgid(pid_t _pid, entry& _out) {
+        std::ifstream in("/proc/" + std::to_string(_pid) + "/status");
+        std::string line;
+        while (std::getline(in, line)) {
+            if (0 == line.compare(0, 5, "Tgid:")) {
+                _out.tgid = std::stol(line.substr(5));
+                return _out.tgid > 0;
+            }
+        }
+
+        return false;
+    }
+
+    static void prune(shard& _shard, std::chrono::steady_clock::time_point _now) {
+        for (auto it = _shard.entries.begin(); it != _shard.entries.end();) {
+            if (it->second.expires <= _now) {
+                it = _shard.entries.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    shard shards_[shard_count];
+}; // class process_cache
+
+static process_cache static_process_cache;
+
+pid_t thread_group(pid_t _tid) {
+    process_cache::entry e;
+    if (!static_process_cache.lookup(_tid, e)) {
+        return 0;
+    }
+
+    return e.tgid;
+} // thread_group
+
+std::string process_name(pid_t _pid) {
+    process_cache::entry e;
+    if (!static_process_cache.lookup(_pid, e)) {
+        return std::string();
+    }
+
+    return e.name;
+} // process_name
+
+bool is_descendant(pid_t _pid, pid_t _ancestor) {
+    pid_t pid = _pid;
+    for (int depth = 0; depth < max_tree_depth && pid > 0; ++depth) {
+        if (pid == _ancestor) {
+            return true;
+        }
+
+        process_cache::entry e;
+        if (!static_process_cache.lookup(pid, e)) {
+            return false;
+        }
+
+        pid = e.ppid;
+    }
+
+    return false;
+} // is_descendant
+
@@ -0,0 +1,34 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_CALLER_HPP
+#define MUNGEFS_CALLER_HPP
+
+#include <string>
+
+#include <sys/types.h>
+
+// process details read from /proc/<pid>/stat, cached per pid for a short
+// while so rules scoped to a caller do not read /proc on every request
+
+// the process, the thread group id, of the thread _tid that fuse reports
+// as the caller, 0 if it is gone
+pid_t thread_group(pid_t _tid);
+
+// the command name of _pid, at most 15 characters, "" if it is gone
+std::string process_name(pid_t _pid);
+
+// true if the process _pid is _ancestor or one of its descendants
+bool is_descendant(pid_t _pid, pid_t _ancestor);
+
+#endif // MUNGEFS_CALLER_HPP
+
@@ -0,0 +1,365 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+
+#include "message_broker.hpp"
+#include "mungefs_client.hpp"
+#include "mungefs_endpoint.hpp"
+#include "mungefs_journal_request.hpp"
+#include "mungefs_protocol.hpp"
+
+typedef message_broker::data_type data_t;
+
+mungefs_rule_builder::mungefs_rule_builder(const std::vector<std::string>& _operations) {
+    rule_.action = SET_FAULT;
+    rule_.operations = _operations;
+    rule_.uid = -1;
+    rule_.gid = -1;
+} // mungefs_rule_builder::mungefs_rule_builder
+
+mungefs_rule_builder::mungefs_rule_builder(const std::string& _operation) :
+    mungefs_rule_builder(std::vector<std::string>{_operation}) {
+} // mungefs_rule_builder::mungefs_rule_builder
+
+mungefs_rule_builder& mungefs_rule_builder::add() {
+    rule_.action = ADD_FAULT;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::clear() {
+    rule_.action = CLEAR_FAULT;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::err_no(int _err_no) {
+    rule_.err_no = _err_no;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::random_errno() {
+    rule_.random = true;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::probability(int64_t _percent) {
+    rule_.probability = _percent;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::regexp(const std::string& _regexp) {
+    rule_.regexp = _regexp;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::kill_caller() {
+    rule_.kill_caller = true;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::delay_us(int64_t _delay_us) {
+    rule_.delay_us = _delay_us;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::auto_delay() {
+    rule_.auto_delay = true;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::corrupt_data() {
+    rule_.corrupt_data = true;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::corrupt_size() {
+    rule_.corrupt_size = true;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::skip_first(int64_t _calls) {
+    rule_.skip_first = _calls;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::every_nth(int64_t _calls) {
+    rule_.every_nth = _calls;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::max_fires(int64_t _fires) {
+    rule_.max_fires = _fires;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::active_after_us(int64_t _us) {
+    rule_.active_after_us = _us;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::active_for_us(int64_t _us) {
+    rule_.active_for_us = _us;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::queue_depth(int64_t _depth) {
+    rule_.queue_depth = _depth;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::pid(pid_t _pid, bool _tree) {
+    rule_.pid = _pid;
+    rule_.pid_tree = _tree;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::uid(uid_t _uid) {
+    rule_.uid = _uid;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::gid(gid_t _gid) {
+    rule_.gid = _gid;
+    return *this;
+}
+
+mungefs_rule_builder& mungefs_rule_builder::comm(const std::string& _comm) {
+    rule_.comm = _comm;
+    return *this;
+}
+
+// the socket and the requests waiting on it. a dealer socket lets any
+// number of requests be sent before the first reply is read.
+class mungefs_client::impl {
+public:
+    // where the reply to one request ends up, dropped if nobody waits
+    struct reply_slot {
+        bool           ready;
+        long           wait_ms;
+        zmq::message_t data;
+
+        explicit reply_slot(long _wait_ms) : ready{false}, wait_ms{_wait_ms} {
+        }
+    };
+
+    explicit impl(const std::string& _endpoint) : bro_("ZMQ_DEALER") {
+        bro_.connect(connect_endpoint(_endpoint));
+    }
+
+    std::shared_ptr<reply_slot> send(data_t&& _msg, long _wait_ms) {
+        auto slot = std::make_shared<reply_slot>(_wait_ms);
+        std::lock_guard<std::mutex> lk(mutex_);
+        bro_.send_envelope(std::move(_msg));
+        pending_.push_back(slot);
+        return slot;
+    }
+
+    // read replies in order until the one for _slot is in. replies stay in
+    // the buffers zmq received them into and are decoded from there.
+    zmq::message_t wait(const std::shared_ptr<reply_slot>& _slot) {
+        std::lock_guard<std::mutex> lk(mutex_);
+        while (!_slot->ready) {
+            auto waiting = pending_.front().lock();
+            if (waiting && waiting->wait_ms) {
+                bro_.wait_for(ZMQ_POLLIN, waiting->wait_ms);
+            }
+
+            zmq::message_t msg;
+            try {
+                bro_.receive_envelope(msg);
+            }
+            catch (const message_broker::exception& _e) {
+                throw std::runtime_error(std::string("no reply from mungefs - ") + _e.what());
+            }
+
+            pending_.pop_front();
+            if (waiting) {
+                waiting->data = std::move(msg);
+                waiting->ready = true;
+            }
+        }
+
+        return std::move(_slot->data);
+    }
+
+private:
+    std::mutex                             mutex_;
+    message_broker                         bro_;
+    std::deque<std::weak_ptr<reply_slot>>  pending_;
+}; // class mungefs_client::impl
+
+mungefs_client::mungefs_client(const std::string& _endpoint) :
+    impl_(std::make_unique<impl>(_endpoint)) {
+} // mungefs_client::mungefs_client
+
+mungefs_client::~mungefs_client() {
+} // mungefs_client::~mungefs_client
+
+std::string mungefs_client::endpoint_for_mountpoint(const std::string& _mountpoint) {
+    return default_endpoint(_mountpoint);
+} // mungefs_client::endpoint_for_mountpoint
+
+template <typename T>
+std::future<T> mungefs_client::request(
+    data_t&&      _msg,
+    const uint8_t _reply_type,
+    const long    _wait_ms) {
+    impl* i = impl_.get();
+    auto slot = i->send(std::move(_msg), _wait_ms);
+    return std::async(
+               std::launch::deferred,
+               [i, slot, _reply_type]() {
+                   zmq::message_t msg = i->wait(slot);
+                   uint8_t type = 0;
+                   if (!get_message_type(msg, type) || _reply_type != type) {
+                       throw std::runtime_error("unexpected reply from mungefs");
+                   }
+
+                   T body;
+                   decode_message(msg, body);
+                   return body;
+               });
+} // mungefs_client::request
+
+std::future<mungefs_reply> mungefs_client::apply_async(const mungefs_batch& _batch) {
+    return request<mungefs_reply>(
+               encode_message(BATCH_MSG_TYPE, _batch),
+               REPLY_MSG_TYPE);
+} // mungefs_client::apply_async
+
+std::future<mungefs_scenario_status> mungefs_client::scenario_async(const mungefs_scenario_ctl& _ctl) {
+    return request<mungefs_scenario_status>(
+               encode_message(SCENARIO_MSG_TYPE, _ctl),
+               SCENARIO_STATUS_MSG_TYPE);
+} // mungefs_client::scenario_async
+
+std::future<mungefs_stats> mungefs_client::stats_async() {
+    return request<mungefs_stats>(
+               encode_message(STATS_MSG_TYPE),
+               STATS_REPLY_MSG_TYPE);
+} // mungefs_client::stats_async
+
+std::future<mungefs_snapshot_status> mungefs_client::snapshot_async(const mungefs_snapshot_ctl& _ctl) {
+    return request<mungefs_snapshot_status>(
+               encode_message(SNAPSHOT_MSG_TYPE, _ctl),
+               SNAPSHOT_STATUS_MSG_TYPE,
+               SNAPSHOT_REPLY_WAIT_MS);
+} // mungefs_client::snapshot_async
+
+std::future<mungefs_power_status> mungefs_client::power_async(const mungefs_power_ctl& _ctl) {
+    return request<mungefs_power_status>(
+               encode_message(POWER_MSG_TYPE, _ctl),
+               POWER_STATUS_MSG_TYPE,
+               SNAPSHOT_REPLY_WAIT_MS);
+} // mungefs_client::power_async
+
+std::future<mungefs_journal_reply> mungefs_client::journal_async(
+    int64_t _after_seq,
+    int32_t _max_events) {
+    mungefs_journal_request req;
+    req.after_seq = _after_seq;
+    req.max_events = _max_events;
+    return request<mungefs_journal_reply>(
+               encode_message(JOURNAL_MSG_TYPE, req),
+               JOURNAL_REPLY_MSG_TYPE);
+} // mungefs_client::journal_async
+
+mungefs_reply mungefs_client::apply(const mungefs_batch& _batch) {
+    return apply_async(_batch).get();
+} // mungefs_client::apply
+
+mungefs_reply mungefs_client::apply(const mungefs_rule_builder& _rule) {
+    mungefs_batch batch;
+    batch.replace_all = false;
+    batch.rules.push_back(_rule.rule());
+    return apply(batch);
+} // mungefs_client::apply
+
+mungefs_reply mungefs_client::clear_all() {
+    mungefs_batch batch;
+    batch.replace_all = true;
+    return apply(batch);
+} // mungefs_client::clear_all
+
+mungefs_scenario_status mungefs_client::start_scenario(
+    const std::string& _name,
+    const std::string& _document) {
+    mungefs_scenario_ctl ctl;
+    ctl.command = START_SCENARIO;
+    ctl.name = _name;
+    ctl.document = _document;
+    return scenario_async(ctl).get();
+} // mungefs_client::start_scenario
+
+mungefs_scenario_status mungefs_client::stop_scenario() {
+    mungefs_scenario_ctl ctl;
+    ctl.command = STOP_SCENARIO;
+    return scenario_async(ctl).get();
+} // mungefs_client::stop_scenario
+
+mungefs_scenario_status mungefs_client::scenario_status() {
+    mungefs_scenario_ctl ctl;
+    ctl.command = SCENARIO_STATUS;
+    return scenario_async(ctl).get();
+} // mungefs_client::scenario_status
+
+mungefs_snapshot_status mungefs_client::take_snapshot(
+    const std::string& _root,
+    const std::string& _store) {
+    mungefs_snapshot_ctl ctl;
+    ctl.command = TAKE_SNAPSHOT;
+    ctl.root = _root;
+    ctl.store = _store;
+    return snapshot_async(ctl).get();
+} // mungefs_client::take_snapshot
+
+mungefs_snapshot_status mungefs_client::reset_snapshot() {
+    mungefs_snapshot_ctl ctl;
+    ctl.command = RESET_SNAPSHOT;
+    return snapshot_async(ctl).get();
+} // mungefs_client::reset_snapshot
+
+mungefs_snapshot_status mungefs_client::drop_snapshot() {
+    mungefs_snapshot_ctl ctl;
+    ctl.command = DROP_SNAPSHOT;
+    return snapshot_async(ctl).get();
+} // mungefs_client::drop_snapshot
+
+mungefs_snapshot_status mungefs_client::snapshot_status() {
+    mungefs_snapshot_ctl ctl;
+    ctl.command = SNAPSHOT_STATUS;
+    return snapshot_async(ctl).get();
+} // mungefs_client::snapshot_status
+
+mungefs_power_status mungefs_client::cut_power(bool _tear) {
+    mungefs_power_ctl ctl;
+    ctl.command = CUT_POWER;
+    ctl.mode = _tear ? TEAR_UNSYNCED : DISCARD_UNSYNCED;
+    return power_async(ctl).get();
+} // mungefs_client::cut_power
+
+mungefs_power_status mungefs_client::power_status() {
+    mungefs_power_ctl ctl;
+    ctl.command = POWER_STATUS;
+    return power_async(ctl).get();
+} // mungefs_client::power_status
+
+mungefs_stats mungefs_client::stats() {
+    return stats_async().get();
+} // mungefs_client::stats
+
+mungefs_journal_reply mungefs_client::journal(int64_t _after_seq) {
+    return journal_async(_after_seq).get();
+} // mungefs_client::journal
+
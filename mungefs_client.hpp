@@ -0,0 +1,151 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_CLIENT_HPP
+#define MUNGEFS_CLIENT_HPP
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "mungefs_batch.hpp"
+#include "mungefs_journal_reply.hpp"
+#include "mungefs_reply.hpp"
+#include "mungefs_scenario_ctl.hpp"
+#include "mungefs_scenario_status.hpp"
+#include "mungefs_power_ctl.hpp"
+#include "mungefs_power_status.hpp"
+#include "mungefs_snapshot_ctl.hpp"
+#include "mungefs_snapshot_status.hpp"
+#include "mungefs_stats.hpp"
+
+// builds one rule of a batch, which sets the fault of its operations and
+// applies to every caller unless told otherwise
+class mungefs_rule_builder {
+public:
+    explicit mungefs_rule_builder(const std::vector<std::string>& _operations);
+    explicit mungefs_rule_builder(const std::string& _operation);
+
+    mungefs_rule_builder& add();     // append to the operations' faults
+    mungefs_rule_builder& clear();   // remove the operations' faults
+
+    mungefs_rule_builder& err_no(int _err_no);
+    mungefs_rule_builder& random_errno();
+    mungefs_rule_builder& probability(int64_t _percent);
+    mungefs_rule_builder& regexp(const std::string& _regexp);
+    mungefs_rule_builder& kill_caller();
+    mungefs_rule_builder& delay_us(int64_t _delay_us);
+    mungefs_rule_builder& auto_delay();
+    mungefs_rule_builder& corrupt_data();
+    mungefs_rule_builder& corrupt_size();
+
+    mungefs_rule_builder& skip_first(int64_t _calls);
+    mungefs_rule_builder& every_nth(int64_t _calls);
+    mungefs_rule_builder& max_fires(int64_t _fires);
+    mungefs_rule_builder& active_after_us(int64_t _us);
+    mungefs_rule_builder& active_for_us(int64_t _us);
+    mungefs_rule_builder& queue_depth(int64_t _depth);
+
+    mungefs_rule_builder& pid(pid_t _pid, bool _tree = false);
+    mungefs_rule_builder& uid(uid_t _uid);
+    mungefs_rule_builder& gid(gid_t _gid);
+    mungefs_rule_builder& comm(const std::string& _comm);
+
+    const mungefs_rule& rule() const {
+        return rule_;
+    }
+
+private:
+    mungefs_rule rule_;
+}; // class mungefs_rule_builder
+
+// a connection to the control socket of one mount, kept open for the life
+// of the client. requests go out as soon as they are made and mungefs
+// answers them in order, so many can be in flight. a future reads replies
+// off the socket when it is waited on, no thread is involved, and it must
+// not outlive its client. a client may be shared between threads.
+//
+// a mount that does not answer in time makes the wait throw a
+// std::runtime_error, as does a reply that is not the one expected.
+class mungefs_client {
+public:
+    // a tcp:// or ipc:// address, as given with -o mungefs_endpoint
+    explicit mungefs_client(const std::string& _endpoint);
+    ~mungefs_client();
+
+    mungefs_client(const mungefs_client&) = delete;
+    mungefs_client& operator=(const mungefs_client&) = delete;
+
+    // the endpoint a mount listens on when none was given
+    static std::string endpoint_for_mountpoint(const std::string& _mountpoint);
+
+    std::future<mungefs_reply>           apply_async(const mungefs_batch& _batch);
+    std::future<mungefs_scenario_status> scenario_async(const mungefs_scenario_ctl& _ctl);
+    std::future<mungefs_stats>           stats_async();
+    std::future<mungefs_snapshot_status> snapshot_async(const mungefs_snapshot_ctl& _ctl);
+    std::future<mungefs_power_status>    power_async(const mungefs_power_ctl& _ctl);
+
+    // journaled faults numbered _after_seq or later, at most _max_events of
+    // them or as many as the mount sends at once when 0. ask again from the
+    // reply's next_seq to follow the journal.
+    std::future<mungefs_journal_reply> journal_async(
+        int64_t _after_seq,
+        int32_t _max_events = 0);
+
+    mungefs_reply apply(const mungefs_batch& _batch);
+    mungefs_reply apply(const mungefs_rule_builder& _rule);
+
+    // drop every fault
+    mungefs_reply clear_all();
+
+    mungefs_scenario_status start_scenario(
+        const std::string& _name,
+        const std::string& _document);
+    mungefs_scenario_status stop_scenario();
+    mungefs_scenario_status scenario_status();
+
+    // record the backing directory _root, the path as given to the subdir
+    // module, to reset it later. _store defaults to _root.mungefs_snapshot.
+    mungefs_snapshot_status take_snapshot(
+        const std::string& _root,
+        const std::string& _store = std::string());
+    mungefs_snapshot_status reset_snapshot();
+    mungefs_snapshot_status drop_snapshot();
+    mungefs_snapshot_status snapshot_status();
+
+    // lose what was written and not synced since the mount or the last
+    // cut, with -o mungefs_powerloss. _tear keeps a random subset of it.
+    mungefs_power_status cut_power(bool _tear = false);
+    mungefs_power_status power_status();
+
+    mungefs_stats stats();
+    mungefs_journal_reply journal(int64_t _after_seq = 0);
+
+private:
+    // send _msg and return a future decoding the reply as a T, waiting
+    // _wait_ms longer than usual for it
+    template <typename T>
+    std::future<T> request(
+        std::vector<uint8_t>&& _msg,
+        const uint8_t          _reply_type,
+        const long             _wait_ms = 0);
+
+    class impl;
+    std::unique_ptr<impl> impl_;
+}; // class mungefs_client
+
+#endif // MUNGEFS_CLIENT_HPP
+
@@ -0,0 +1,180 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_COMPACT_MAP_HPP
+#define MUNGEFS_COMPACT_MAP_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+// a hash map from strings laid out like a compact dict: the entries sit in
+// one dense array and the open addressed table only holds 32 bit indices
+// into it, so a small map costs little more than its keys and values and
+// iterating it walks contiguous memory. erasing moves the last entry into
+// the hole, which changes the order of iteration.
+template <typename V>
+class compact_map {
+public:
+    compact_map() : mask_{0} {
+    }
+
+    size_t size() const {
+        return entries_.size();
+    }
+
+    bool empty() const {
+        return entries_.empty();
+    }
+
+    V* find(const std::string& _key) {
+        if (index_.empty()) {
+            return nullptr;
+        }
+
+        const size_t slot = find_slot(_key, hash(_key));
+        return empty_slot == index_[slot] ? nullptr : &entries_[index_[slot]].value;
+    }
+
+    const V* find(const std::string& _key) const {
+        return const_cast<compact_map*>(this)->find(_key);
+    }
+
+    // returns false, leaving the map alone, if _key is already there
+    bool insert(const std::string& _key, V _value) {
+        if ((entries_.size() + 1) * 2 > index_.size()) {
+            rehash(index_.empty() ? 8 : index_.size() * 2);
+        }
+
+        const uint64_t h = hash(_key);
+        const size_t slot = find_slot(_key, h);
+        if (empty_slot != index_[slot]) {
+            return false;
+        }
+
+        index_[slot] = static_cast<int32_t>(entries_.size());
+        entries_.push_back(entry{h, _key, std::move(_value)});
+        return true;
+    }
+
+    bool erase(const std::string& _key) {
+        if (index_.empty()) {
+            return false;
+        }
+
+        size_t slot = find_slot(_key, hash(_key));
+        const int32_t pos = index_[slot];
+        if (empty_slot == pos) {
+            return false;
+        }
+
+        // backward shift deletion keeps probe sequences unbroken without
+        // leaving tombstones behind
+        size_t next = slot;
+        while (true) {
+            next = (next + 1) & mask_;
+            if (empty_slot == index_[next]) {
+                break;
+            }
+
+            const size_t home = entries_[index_[next]].hash & mask_;
+            if (((next - home) & mask_) >= ((next - slot) & mask_)) {
+                index_[slot] = index_[next];
+                slot = next;
+            }
+        }
+        index_[slot] = empty_slot;
+
+        // fill the hole in the dense array with the last entry
+        const int32_t last = static_cast<int32_t>(entries_.size()) - 1;
+        if (pos != last) {
+            entries_[pos] = std::move(entries_[last]);
+            size_t moved = entries_[pos].hash & mask_;
+            while (index_[moved] != last) {
+                moved = (moved + 1) & mask_;
+            }
+            index_[moved] = pos;
+        }
+
+        entries_.pop_back();
+        return true;
+    }
+
+    void clear() {
+        entries_.clear();
+        index_.clear();
+        mask_ = 0;
+    }
+
+    template <typename F>
+    void for_each(F _visit) const {
+        for (const auto& e : entries_) {
+            _visit(e.key, e.value);
+        }
+    }
+
+private:
+    struct entry {
+        uint64_t    hash;
+        std::string key;
+        V           value;
+    };
+
+    enum : int32_t { empty_slot = -1 };
+
+    // 64 bit fnv-1a
+    static uint64_t hash(const std::string& _key) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (unsigned char c : _key) {
+            h ^= c;
+            h *= 0x100000001b3ULL;
+        }
+
+        return h;
+    }
+
+    // the slot holding _key, or the empty one it would go in
+    size_t find_slot(const std::string& _key, uint64_t _hash) const {
+        size_t slot = _hash & mask_;
+        while (empty_slot != index_[slot]) {
+            const entry& e = entries_[index_[slot]];
+            if (e.hash == _hash && e.key == _key) {
+                break;
+            }
+
+            slot = (slot + 1) & mask_;
+        }
+
+        return slot;
+    }
+
+    void rehash(size_t _slots) {
+        index_.assign(_slots, empty_slot);
+        mask_ = _slots - 1;
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            size_t slot = entries_[i].hash & mask_;
+            while (empty_slot != index_[slot]) {
+                slot = (slot + 1) & mask_;
+            }
+            index_[slot] = static_cast<int32_t>(i);
+        }
+    }
+
+    std::vector<entry>   entries_;
+    std::vector<int32_t> index_;
+    size_t               mask_;
+}; // class compact_map
+
+#endif // MUNGEFS_COMPACT_MAP_HPP
+
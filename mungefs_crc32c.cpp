@@ -0,0 +1,202 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <string.h>
+
+#include "mungefs_crc32c.hpp"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// the castagnoli polynomial, bit reflected
+static const uint32_t crc32c_poly = 0x82f63b78;
+
+struct crc32c_tables {
+    uint32_t t[8][256];
+};
+
+static crc32c_tables make_tables() {
+    crc32c_tables tb;
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ crc32c_poly : crc >> 1;
+        }
+        tb.t[0][i] = crc;
+    }
+
+    for (uint32_t i = 0; i < 256; ++i) {
+        for (int k = 1; k < 8; ++k) {
+            tb.t[k][i] = (tb.t[k - 1][i] >> 8) ^ tb.t[0][tb.t[k - 1][i] & 0xff];
+        }
+    }
+
+    return tb;
+} // make_tables
+
+static const crc32c_tables static_tables = make_tables();
+
+// the raw state without the inversions, one of the kernels below
+typedef uint32_t (*crc32c_kernel)(uint32_t, const unsigned char*, size_t);
+
+static uint32_t crc32c_table(uint32_t _crc, const unsigned char* _p, size_t _size) {
+    const auto& t = static_tables.t;
+    while (_size >= 8) {
+        const uint32_t lo = _crc ^ (static_cast<uint32_t>(_p[0]) |
+                                    static_cast<uint32_t>(_p[1]) << 8 |
+                                    static_cast<uint32_t>(_p[2]) << 16 |
+                                    static_cast<uint32_t>(_p[3]) << 24);
+        const uint32_t hi = static_cast<uint32_t>(_p[4]) |
+                            static_cast<uint32_t>(_p[5]) << 8 |
+                            static_cast<uint32_t>(_p[6]) << 16 |
+                            static_cast<uint32_t>(_p[7]) << 24;
+        _crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^
+               t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+               t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^
+               t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+        _p += 8;
+        _size -= 8;
+    }
+
+    while (_size--) {
+        _crc = t[0][(_crc ^ *_p++) & 0xff] ^ (_crc >> 8);
+    }
+
+    return _crc;
+} // crc32c_table
+
+#if defined(__x86_64__)
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t _crc, const unsigned char* _p, size_t _size) {
+    uint64_t crc = _crc;
+    while (_size >= 8) {
+        uint64_t word;
+        memcpy(&word, _p, sizeof(word));
+        crc = _mm_crc32_u64(crc, word);
+        _p += 8;
+        _size -= 8;
+    }
+
+    uint32_t crc32 = static_cast<uint32_t>(crc);
+    while (_size--) {
+        crc32 = _mm_crc32_u8(crc32, *_p++);
+    }
+
+    return crc32;
+} // crc32c_sse42
+
+// x^_power mod the polynomial, bit reflected
+static uint32_t xpow_mod(uint64_t _power) {
+    uint32_t v = 0x80000000u;
+    while (_power--) {
+        v = (v & 1) ? (v >> 1) ^ crc32c_poly : v >> 1;
+    }
+
+    return v;
+} // xpow_mod
+
+// the three stream kernel runs a stream over each third of a chunk, as the
+// crc32 instruction has a latency of three cycles and a throughput of one.
+// the first stream's state is then moved past the other two by multiplying
+// it by x^(8 * bytes) with pclmulqdq, reducing the 64 bit product with crc32.
+struct stream_split {
+    size_t   bytes;   // per stream
+    uint32_t shift1;  // x^(8 * bytes - 32)
+    uint32_t shift2;  // x^(16 * bytes - 32)
+};
+
+static stream_split make_split(size_t _bytes) {
+    return stream_split{_bytes, xpow_mod(8 * _bytes - 32), xpow_mod(16 * _bytes - 32)};
+} // make_split
+
+// the second covers a 4 KiB block in one pass
+static const stream_split static_splits[] = {
+    make_split(8192),
+    make_split(1360),
+    make_split(256)
+};
+
+__attribute__((target("sse4.2,pclmul")))
+static inline uint32_t shift_crc(uint32_t _crc, uint32_t _shift) {
+    const __m128i product = _mm_clmulepi64_si128(
+                                _mm_cvtsi32_si128(static_cast<int>(_crc)),
+                                _mm_cvtsi32_si128(static_cast<int>(_shift)),
+                                0x00);
+    const uint64_t low = static_cast<uint64_t>(_mm_cvtsi128_si64(product));
+    return static_cast<uint32_t>(_mm_crc32_u64(0, low << 1));
+} // shift_crc
+
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t crc32c_sse42_pclmul(uint32_t _crc, const unsigned char* _p, size_t _size) {
+    for (const auto& split : static_splits) {
+        const size_t words = split.bytes / 8;
+        while (_size >= 3 * split.bytes) {
+            uint64_t crc0 = _crc;
+            uint64_t crc1 = 0;
+            uint64_t crc2 = 0;
+            const unsigned char* p1 = _p + split.bytes;
+            const unsigned char* p2 = p1 + split.bytes;
+            for (size_t i = 0; i < words; ++i) {
+                uint64_t w0, w1, w2;
+                memcpy(&w0, _p + 8 * i, 8);
+                memcpy(&w1, p1 + 8 * i, 8);
+                memcpy(&w2, p2 + 8 * i, 8);
+                crc0 = _mm_crc32_u64(crc0, w0);
+                crc1 = _mm_crc32_u64(crc1, w1);
+                crc2 = _mm_crc32_u64(crc2, w2);
+            }
+
+            _crc = shift_crc(static_cast<uint32_t>(crc0), split.shift2) ^
+                   shift_crc(static_cast<uint32_t>(crc1), split.shift1) ^
+                   static_cast<uint32_t>(crc2);
+            _p += 3 * split.bytes;
+            _size -= 3 * split.bytes;
+        }
+    }
+
+    return crc32c_sse42(_crc, _p, _size);
+} // crc32c_sse42_pclmul
+
+#endif
+
+struct kernel_choice {
+    crc32c_kernel kernel;
+    const char*   name;
+};
+
+static kernel_choice choose_kernel() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul")) {
+        return kernel_choice{crc32c_sse42_pclmul, "sse4.2 and pclmul"};
+    }
+
+    if (__builtin_cpu_supports("sse4.2")) {
+        return kernel_choice{crc32c_sse42, "sse4.2"};
+    }
+#endif
+
+    return kernel_choice{crc32c_table, "slicing-by-8 tables"};
+} // choose_kernel
+
+static const kernel_choice static_kernel = choose_kernel();
+
+uint32_t crc32c(uint32_t _crc, const void* _buf, size_t _size) {
+    return ~static_kernel.kernel(~_crc, static_cast<const unsigned char*>(_buf), _size);
+} // crc32c
+
+const char* crc32c_kernel_name() {
+    return static_kernel.name;
+} // crc32c_kernel_name
+
@@ -0,0 +1,30 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_CRC32C_HPP
+#define MUNGEFS_CRC32C_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+// crc32c, the castagnoli polynomial, of _size bytes continuing from _crc,
+// which is 0 to start a new checksum. crc32c(0, "123456789", 9) is
+// 0xe3069283. x86-64 cpus with sse4.2 compute it with the crc32
+// instruction, on three streams at once combined with pclmulqdq when the
+// cpu has it, and everything else with slicing-by-8 tables.
+uint32_t crc32c(uint32_t _crc, const void* _buf, size_t _size);
+
+// the implementation picked for this cpu, for the log
+const char* crc32c_kernel_name();
+
+#endif // MUNGEFS_CRC32C_HPP
+
@@ -0,0 +1,102 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <atomic>
+
+#include "mungefs_decision.hpp"
+
+static std::atomic<bool>     static_seeded(false);
+static std::atomic<uint64_t> static_seed(0);
+
+void set_fault_seed(uint64_t _seed) {
+    static_seed.store(_seed, std::memory_order_relaxed);
+    static_seeded.store(true, std::memory_order_release);
+} // set_fault_seed
+
+bool fault_seeded() {
+    return static_seeded.load(std::memory_order_acquire);
+} // fault_seeded
+
+uint64_t fault_seed() {
+    return static_seed.load(std::memory_order_relaxed);
+} // fault_seed
+
+std::array<uint32_t, 4> philox4x32(
+    std::array<uint32_t, 4> _counter,
+    std::array<uint32_t, 2> _key) {
+    static const uint64_t multiplier_0 = 0xD2511F53;
+    static const uint64_t multiplier_1 = 0xCD9E8D57;
+    static const uint32_t weyl_0 = 0x9E3779B9;
+    static const uint32_t weyl_1 = 0xBB67AE85;
+
+    for (int round = 0; round < 10; ++round) {
+        const uint64_t product_0 = multiplier_0 * _counter[0];
+        const uint64_t product_1 = multiplier_1 * _counter[2];
+        _counter = {{
+            static_cast<uint32_t>(product_1 >> 32) ^ _counter[1] ^ _key[0],
+            static_cast<uint32_t>(product_1),
+            static_cast<uint32_t>(product_0 >> 32) ^ _counter[3] ^ _key[1],
+            static_cast<uint32_t>(product_0)
+        }};
+        _key[0] += weyl_0;
+        _key[1] += weyl_1;
+    }
+
+    return _counter;
+} // philox4x32
+
+uint64_t fnv1a(
+    const std::string& _text,
+    uint64_t           _hash) {
+    for (unsigned char c : _text) {
+        _hash ^= c;
+        _hash *= 0x100000001b3ULL;
+    }
+
+    return _hash;
+} // fnv1a
+
+uint64_t invocation_counter::next(uint64_t _key) {
+    auto& s = shards_[_key % shard_count];
+    std::lock_guard<std::mutex> lk(s.mutex);
+    if (s.counts.size() >= shard_limit && !s.counts.count(_key)) {
+        s.counts.clear();
+    }
+
+    return s.counts[_key]++;
+} // invocation_counter::next
+
+fault_draw draw_fault(
+    uint64_t            _rule_key,
+    const std::string&  _operation,
+    const std::string&  _path,
+    invocation_counter& _invocations) {
+    // the nul keeps "ab" on "c" apart from "a" on "bc"
+    const uint64_t path_key = fnv1a(_path, fnv1a(_operation + '\0'));
+    const uint64_t call = _invocations.next(path_key);
+
+    // the call and path are the counter, the seed and rule the key
+    const uint64_t key = fault_seed() ^ _rule_key;
+    const auto out = philox4x32(
+                         {{static_cast<uint32_t>(call),
+                           static_cast<uint32_t>(call >> 32),
+                           static_cast<uint32_t>(path_key),
+                           static_cast<uint32_t>(path_key >> 32)}},
+                         {{static_cast<uint32_t>(key),
+                           static_cast<uint32_t>(key >> 32)}});
+
+    fault_draw draw;
+    draw.fire = static_cast<uint64_t>(out[0]) << 32 | out[1];
+    draw.err_no = static_cast<uint64_t>(out[2]) << 32 | out[3];
+    return draw;
+} // draw_fault
+
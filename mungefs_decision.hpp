@@ -0,0 +1,77 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_DECISION_HPP
+#define MUNGEFS_DECISION_HPP
+
+#include <array>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <stdint.h>
+
+// once a seed is set, whether a probabilistic fault fires and the errno a
+// random fault picks are no longer drawn from a shared generator. they are
+// a hash of the seed, the rule, the operation, the path and the number of
+// times the rule saw the operation on that path before. the k-th call on
+// a path then gets the same answer in every run with the same seed, in
+// whatever order threads get to it.
+void set_fault_seed(uint64_t _seed);
+bool fault_seeded();
+uint64_t fault_seed();
+
+// philox4x32-10, a counter based generator: every output is a keyed hash
+// of its counter, so any draw can be computed on its own
+std::array<uint32_t, 4> philox4x32(
+    std::array<uint32_t, 4> _counter,
+    std::array<uint32_t, 2> _key);
+
+// 64 bit fnv-1a, continuing from _hash
+uint64_t fnv1a(
+    const std::string& _text,
+    uint64_t           _hash = 0xcbf29ce484222325ULL);
+
+// how many times each key was counted, shared by the threads of a mount.
+// keys are spread over the shards by their hash, and a shard keeping
+// shard_limit keys forgets all of them when another one comes.
+class invocation_counter {
+public:
+    // the count of _key before this call
+    uint64_t next(uint64_t _key);
+
+private:
+    struct shard {
+        std::mutex                             mutex;
+        std::unordered_map<uint64_t, uint64_t> counts;
+    };
+
+    static const size_t shard_count = 16;
+    static const size_t shard_limit = 4096;
+    std::array<shard, shard_count> shards_;
+}; // class invocation_counter
+
+// the two values a fault draws on a call
+struct fault_draw {
+    uint64_t fire;     // against the probability
+    uint64_t err_no;   // picks a random errno
+};
+
+// draw for this call of _operation on _path, counting it
+fault_draw draw_fault(
+    uint64_t            _rule_key,
+    const std::string&  _operation,
+    const std::string&  _path,
+    invocation_counter& _invocations);
+
+#endif // MUNGEFS_DECISION_HPP
+
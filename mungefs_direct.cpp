@@ -0,0 +1,230 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mungefs_direct.hpp"
+#include "mungefs_handle.hpp"
+#include "mungefs_io.hpp"
+#include "mungefs_log.hpp"
+#include "mungefs_options.hpp"
+#include "mungefs_server.hpp"
+
+// bounce buffers up to this size are kept for reuse, larger ones are not
+static const size_t pooled_buffer_size = 1024 * 1024 + 2 * 4096;
+static const size_t max_pooled_buffers = 32;
+
+// pooled buffers are aligned for any block size up to this
+static const size_t pooled_alignment = 4096;
+
+// aligned scratch memory for requests the backing file would refuse
+class bounce_pool {
+public:
+    struct deleter {
+        bounce_pool* pool;
+        size_t       size;
+        void operator()(char* _buf) const {
+            pool->release(_buf, size);
+        }
+    };
+
+    typedef std::unique_ptr<char, deleter> buffer_ptr;
+
+    ~bounce_pool() {
+        for (auto b : free_) {
+            free(b);
+        }
+    }
+
+    buffer_ptr acquire(size_t _size, size_t _alignment) {
+        const size_t size = std::max(_size, pooled_buffer_size);
+        if (size == pooled_buffer_size && _alignment <= pooled_alignment) {
+            std::lock_guard<std::mutex> lk(mutex_);
+            if (!free_.empty()) {
+                char* b = free_.back();
+                free_.pop_back();
+                return buffer_ptr(b, deleter{this, size});
+            }
+        }
+
+        void* b = nullptr;
+        if (posix_memalign(&b, std::max(_alignment, pooled_alignment), size)) {
+            return buffer_ptr(nullptr, deleter{this, 0});
+        }
+
+        return buffer_ptr(static_cast<char*>(b), deleter{this, size});
+    }
+
+private:
+    void release(char* _buf, size_t _size) {
+        if (_size == pooled_buffer_size) {
+            std::lock_guard<std::mutex> lk(mutex_);
+            if (free_.size() < max_pooled_buffers) {
+                free_.push_back(_buf);
+                return;
+            }
+        }
+
+        free(_buf);
+    }
+
+    std::mutex         mutex_;
+    std::vector<char*> free_;
+}; // class bounce_pool
+
+static bounce_pool static_bounce_pool;
+
+// a misaligned write reads and rewrites the blocks around it, so it must
+// not interleave with other writes to the same file. aligned writes only
+// exclude these read-modify-write cycles, not each other.
+static const size_t lock_stripes = 64;
+static std::shared_timed_mutex static_write_locks[lock_stripes];
+
+static std::shared_timed_mutex& write_lock_for(const mungefs_file_handle& _handle) {
+    return static_write_locks[(_handle.ino * 31 + _handle.dev) % lock_stripes];
+} // write_lock_for
+
+static size_t direct_alignment() {
+    return std::max(512u, get_mungefs_options().direct_io_align);
+} // direct_alignment
+
+static bool is_aligned(const void* _buf, size_t _size, off_t _offset, size_t _alignment) {
+    return 0 == ((reinterpret_cast<uintptr_t>(_buf) | _size | static_cast<size_t>(_offset)) % _alignment);
+} // is_aligned
+
+int open_backing_file(const char* _path, int _flags, mode_t _mode) {
+    if (!get_mungefs_options().direct_io) {
+        int fd = open(_path, _flags, _mode);
+        return fd < 0 ? -errno : fd;
+    }
+
+    int fd = open(_path, _flags | O_DIRECT, _mode);
+    if (fd < 0 && EINVAL == errno) {
+        // tmpfs and friends, the kernel still bypasses its cache on our side
+        static std::once_flag warned;
+        std::call_once(warned, [] {
+            MUNGEFS_LOG(log_level::warning, "backing file system refuses O_DIRECT, using buffered descriptors");
+        });
+
+        fd = open(_path, _flags, _mode);
+    }
+
+    return fd < 0 ? -errno : fd;
+} // open_backing_file
+
+bool is_direct_descriptor(int _fd) {
+    int flags = fcntl(_fd, F_GETFL);
+    return flags >= 0 && (flags & O_DIRECT);
+} // is_direct_descriptor
+
+ssize_t direct_pread(mungefs_file_handle& _handle, char* _buf, size_t _size, off_t _offset) {
+    const size_t align = direct_alignment();
+    if (is_aligned(_buf, _size, _offset, align)) {
+        return backing_pread(_handle.fd, _buf, _size, _offset);
+    }
+
+    const off_t  start = _offset - (_offset % align);
+    const off_t  end   = (_offset + _size + align - 1) / align * align;
+    const size_t len   = end - start;
+    auto bounce = static_bounce_pool.acquire(len, align);
+    if (!bounce) {
+        return -ENOMEM;
+    }
+
+    ssize_t ret = backing_pread(_handle.fd, bounce.get(), len, start);
+    if (ret < 0) {
+        return ret;
+    }
+
+    const off_t skip = _offset - start;
+    if (ret <= skip) {
+        return 0;
+    }
+
+    size_t n = std::min<size_t>(ret - skip, _size);
+    memcpy(_buf, bounce.get() + skip, n);
+    return n;
+} // direct_pread
+
+ssize_t direct_pwrite(mungefs_file_handle& _handle, const char* _buf, size_t _size, off_t _offset) {
+    const size_t align = direct_alignment();
+    if (is_aligned(_buf, _size, _offset, align)) {
+        std::shared_lock<std::shared_timed_mutex> lk(write_lock_for(_handle));
+        return backing_pwrite(_handle.fd, _buf, _size, _offset);
+    }
+
+    const off_t  start = _offset - (_offset % align);
+    const off_t  end   = (_offset + _size + align - 1) / align * align;
+    const size_t len   = end - start;
+    auto bounce = static_bounce_pool.acquire(len, align);
+    if (!bounce) {
+        return -ENOMEM;
+    }
+
+    std::unique_lock<std::shared_timed_mutex> lk(write_lock_for(_handle));
+    struct stat st;
+    if (fstat(_handle.fd, &st) < 0) {
+        return -errno;
+    }
+
+    // fill the partial blocks at either end from the file, past the end
+    // of the file they read short and stay zero
+    memset(bounce.get(), 0, len);
+    if (start != _offset && start < st.st_size) {
+        ssize_t ret = backing_pread(_handle.fd, bounce.get(), align, start);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    const off_t tail = end - align;
+    if (static_cast<off_t>(_offset + _size) != end &&
+        (tail != start || start == _offset) &&
+        tail < st.st_size) {
+        ssize_t ret = backing_pread(_handle.fd, bounce.get() + (tail - start), align, tail);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    memcpy(bounce.get() + (_offset - start), _buf, _size);
+    ssize_t ret = backing_pwrite(_handle.fd, bounce.get(), len, start);
+    if (ret < 0) {
+        return ret;
+    }
+
+    // the padding may have grown the file past what was written
+    const off_t size = std::max<off_t>(st.st_size, _offset + _size);
+    if (end > size && ftruncate(_handle.fd, size) < 0) {
+        return -errno;
+    }
+
+    const off_t skip = _offset - start;
+    if (ret <= skip) {
+        return 0;
+    }
+
+    return std::min<size_t>(ret - skip, _size);
+} // direct_pwrite
+
@@ -0,0 +1,35 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_DIRECT_HPP
+#define MUNGEFS_DIRECT_HPP
+
+#include <sys/types.h>
+
+struct mungefs_file_handle;
+
+// open a backing file, adding O_DIRECT when mounted with -o mungefs_direct_io.
+// a file system that refuses O_DIRECT gets a buffered descriptor instead.
+// returns the descriptor or -errno.
+int open_backing_file(const char* _path, int _flags, mode_t _mode);
+
+// true if _fd was opened with O_DIRECT and needs aligned transfers
+bool is_direct_descriptor(int _fd);
+
+// read and write through an O_DIRECT descriptor. aligned requests go
+// straight to the backing file, the rest are widened to whole blocks in a
+// pooled bounce buffer. return the byte count or -errno.
+ssize_t direct_pread(mungefs_file_handle& _handle, char* _buf, size_t _size, off_t _offset);
+ssize_t direct_pwrite(mungefs_file_handle& _handle, const char* _buf, size_t _size, off_t _offset);
+
+#endif // MUNGEFS_DIRECT_HPP
+
@@ -0,0 +1,100 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_ENDPOINT_HPP
+#define MUNGEFS_ENDPOINT_HPP
+
+#include <string>
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// the real path of a mountpoint, found without looking up the mountpoint
+// itself. on a live mount that lookup is answered by mungefs, where an
+// injected delay or error would stall or break it, so only the parent is
+// resolved and a symlink in the last component is followed by hand.
+// readlink does not reach into a mounted directory, it fails at once.
+inline std::string resolve_mountpoint(const std::string& _mountpoint) {
+    std::string path = _mountpoint;
+    for (int links = 0; links < 40; ++links) {
+        while (path.size() > 1 && '/' == path.back()) {
+            path.pop_back();
+        }
+
+        const size_t slash = path.rfind('/');
+        const std::string name = std::string::npos == slash ? path : path.substr(slash + 1);
+        const std::string parent = std::string::npos == slash ? "." :
+                                   0 == slash ? "/" : path.substr(0, slash);
+
+        // these are resolved from the working directory, not looked up
+        char resolved[PATH_MAX];
+        if (name.empty() || "." == name || ".." == name) {
+            return realpath(path.c_str(), resolved) ? resolved : path;
+        }
+
+        // nothing can be mounted under a directory that does not exist
+        if (!realpath(parent.c_str(), resolved)) {
+            return path;
+        }
+
+        const std::string dir = resolved;
+        path = ("/" == dir ? "" : dir) + "/" + name;
+
+        char target[PATH_MAX];
+        ssize_t len = readlink(path.c_str(), target, sizeof(target) - 1);
+        if (len < 0) {
+            return path;
+        }
+
+        target[len] = '\0';
+        path = '/' == target[0] ? target : dir + "/" + target;
+    }
+
+    return path;
+} // resolve_mountpoint
+
+// the control socket of a mount, unless given with -o mungefs_endpoint, is
+// a unix domain socket named after a hash of the real path of its
+// mountpoint. mungefs and mungefsctl both derive it the same way, so any
+// number of mounts can run side by side on one host.
+inline std::string default_endpoint(const std::string& _mountpoint) {
+    const std::string path = resolve_mountpoint(_mountpoint);
+
+    // 64 bit fnv-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : path) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "ipc:///tmp/mungefs.%016llx",
+             static_cast<unsigned long long>(hash));
+    return name;
+} // default_endpoint
+
+// the address a client connects to for an endpoint mungefs binds, which
+// differ only for a tcp endpoint bound to every interface
+inline std::string connect_endpoint(const std::string& _endpoint) {
+    static const std::string any_interface = "tcp://*:";
+    if (0 == _endpoint.compare(0, any_interface.size(), any_interface)) {
+        return "tcp://localhost:" + _endpoint.substr(any_interface.size());
+    }
+
+    return _endpoint;
+} // connect_endpoint
+
+#endif // MUNGEFS_ENDPOINT_HPP
+
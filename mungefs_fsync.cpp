@@ -0,0 +1,128 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "mungefs_decision.hpp"
+#include "mungefs_fsync.hpp"
+
+static fsync_model           static_model{0, 0, 0, 0, 0, false};
+static bool                  static_model_active = false;
+static uint64_t              static_stall_seed = 0;
+static std::atomic<uint64_t> static_sync_count(0);
+
+// the syncs waiting for the next commit, and the commits done so far.
+// a commit's leader collects syncs for group_us, then waits for the
+// commit before its own and pays for its syncs, so commits run in the
+// order their groups formed and the next group forms during a commit.
+struct commit_group {
+    std::mutex              mutex;
+    std::condition_variable committed_cv;
+    bool                    open = false;
+    uint64_t                dirty = 0;
+    uint64_t                generation = 0;
+    uint64_t                committed = 0;
+};
+
+static commit_group static_group;
+
+static void sleep_us(uint64_t _us) {
+    if (_us) {
+        std::this_thread::sleep_for(std::chrono::microseconds(_us));
+    }
+} // sleep_us
+
+static uint64_t flush_cost_us(uint64_t _dirty) {
+    return static_model.base_us +
+           (_dirty * static_model.us_per_mb) / (1024 * 1024);
+} // flush_cost_us
+
+// whether this sync stalls, the same for the k-th sync of every run with
+// the same seed
+static bool draw_stall() {
+    if (!static_model.stall_pct) {
+        return false;
+    }
+
+    const uint64_t n = static_sync_count.fetch_add(1, std::memory_order_relaxed);
+    const uint64_t seed = fault_seeded() ? fault_seed() : static_stall_seed;
+    auto draw = philox4x32(
+                    {{static_cast<uint32_t>(n), static_cast<uint32_t>(n >> 32), 0, 0}},
+                    {{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)}});
+    return draw[0] % 100 < static_model.stall_pct;
+} // draw_stall
+
+static void group_commit(uint64_t _dirty) {
+    auto& g = static_group;
+    std::unique_lock<std::mutex> lk(g.mutex);
+    if (g.open) {
+        g.dirty += _dirty;
+        const uint64_t generation = g.generation;
+        g.committed_cv.wait(lk, [&] { return g.committed >= generation; });
+        return;
+    }
+
+    g.open = true;
+    g.dirty = _dirty;
+    const uint64_t generation = ++g.generation;
+    lk.unlock();
+
+    sleep_us(static_model.group_us);
+
+    lk.lock();
+    g.open = false;
+    const uint64_t dirty = g.dirty;
+    g.committed_cv.wait(lk, [&] { return g.committed == generation - 1; });
+    lk.unlock();
+
+    sleep_us(flush_cost_us(dirty));
+
+    lk.lock();
+    g.committed = generation;
+    lk.unlock();
+    g.committed_cv.notify_all();
+} // group_commit
+
+void start_fsync_model(const fsync_model& _model) {
+    static_model = _model;
+    static_model_active = _model.base_us || _model.us_per_mb ||
+                          _model.group_us || _model.stall_pct;
+    static_stall_seed = std::random_device()();
+    static_stall_seed = (static_stall_seed << 32) | std::random_device()();
+} // start_fsync_model
+
+bool fsync_is_noop() {
+    return static_model.noop;
+} // fsync_is_noop
+
+void charge_fsync(uint64_t _dirty) {
+    if (!static_model_active) {
+        return;
+    }
+
+    if (static_model.group_us) {
+        group_commit(_dirty);
+    }
+    else {
+        sleep_us(flush_cost_us(_dirty));
+    }
+
+    if (draw_stall()) {
+        sleep_us(static_cast<uint64_t>(static_model.stall_ms) * 1000);
+    }
+} // charge_fsync
+
@@ -0,0 +1,44 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_FSYNC_HPP
+#define MUNGEFS_FSYNC_HPP
+
+#include <stdint.h>
+
+// how long a sync takes on the emulated device, on top of the backing sync.
+// a sync pays base_us plus us_per_mb for every MiB written through the
+// handle since its last sync. with group_us, syncs arriving within that
+// window of the first one are committed together, one after the other
+// like a journal, each commit paying once for the bytes of all its syncs.
+// stall_pct of syncs then stall for another stall_ms on top.
+struct fsync_model {
+    unsigned base_us;
+    unsigned us_per_mb;
+    unsigned group_us;
+    unsigned stall_pct;
+    unsigned stall_ms;
+    bool     noop;      // syncs return at once and sync nothing
+};
+
+void start_fsync_model(const fsync_model& _model);
+
+// fsync and fdatasync succeed without syncing, so what they cover is still
+// lost to a power cut
+bool fsync_is_noop();
+
+// wait out the modeled latency of a sync covering _dirty bytes, after the
+// backing sync returned
+void charge_fsync(uint64_t _dirty);
+
+#endif // MUNGEFS_FSYNC_HPP
+
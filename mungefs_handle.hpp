@@ -0,0 +1,100 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_HANDLE_HPP
+#define MUNGEFS_HANDLE_HPP
+
+#include <atomic>
+#include <memory>
+
+#include <dirent.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <fuse.h>
+
+#include "mungefs_integrity.hpp"
+#include "mungefs_memfs.hpp"
+#include "mungefs_powerloss.hpp"
+#include "mungefs_prefetch.hpp"
+#include "mungefs_server.hpp"
+#include "mungefs_snapshot.hpp"
+#include "mungefs_writeback.hpp"
+
+// state kept for an open file or directory, allocated from a pool and
+// stored in fi->fh
+struct mungefs_file_handle {
+    int             fd;
+    bool            direct;     // fd was opened with O_DIRECT
+    bool            sync_writes; // or with O_SYNC or O_DSYNC
+    DIR*            dir;        // set instead of fd for an open directory
+    memfs_inode_ptr mem;        // set instead of either with mungefs_memfs
+    dev_t           dev;        // identity of the backing file, shared by
+    ino_t           ino;        // every handle open on it
+    readahead_state readahead;
+    write_buffer    writeback;
+    unsynced_ranges_ptr unsynced;  // set for writable files with mungefs_powerloss
+    integrity_file_ptr  crc;       // set for regular files with mungefs_crc
+    uint64_t        power_cycle;   // when the handle was opened
+
+    // rules last resolved for this path, only accessed with the
+    // std::atomic_load and std::atomic_store overloads
+    std::shared_ptr<const resolved_fault> read_fault;
+    std::shared_ptr<const resolved_fault> write_fault;
+
+    std::atomic<uint64_t> dirty_bytes;  // written since the last sync
+    std::atomic<uint64_t> epoch;  // of the snapshot, see mungefs_snapshot.hpp
+
+    explicit mungefs_file_handle(int _fd) :
+        fd{_fd},
+        direct{false},
+        sync_writes{false},
+        dir{nullptr},
+        dev{0},
+        ino{0},
+        power_cycle{current_power_cycle()},
+        dirty_bytes{0},
+        epoch{snapshot_epoch()} {
+    }
+
+    explicit mungefs_file_handle(DIR* _dir) :
+        fd{-1},
+        direct{false},
+        sync_writes{false},
+        dir{_dir},
+        dev{0},
+        ino{0},
+        power_cycle{current_power_cycle()},
+        dirty_bytes{0},
+        epoch{snapshot_epoch()} {
+    }
+
+    explicit mungefs_file_handle(const memfs_inode_ptr& _mem) :
+        fd{-1},
+        direct{false},
+        sync_writes{false},
+        dir{nullptr},
+        mem{_mem},
+        dev{0},
+        ino{0},
+        power_cycle{current_power_cycle()},
+        dirty_bytes{0},
+        epoch{snapshot_epoch()} {
+    }
+};
+
+inline mungefs_file_handle* get_file_handle(struct fuse_file_info* _fi) {
+    return reinterpret_cast<mungefs_file_handle*>(_fi->fh);
+}
+
+#endif // MUNGEFS_HANDLE_HPP
+
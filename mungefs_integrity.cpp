@@ -0,0 +1,478 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mungefs_crc32c.hpp"
+#include "mungefs_direct.hpp"
+#include "mungefs_handle.hpp"
+#include "mungefs_integrity.hpp"
+#include "mungefs_io.hpp"
+#include "mungefs_log.hpp"
+
+// a sidecar starts with this header and then holds a sum for each block,
+// 0 for a block without one
+struct sidecar_header {
+    char     magic[8];
+    uint32_t block_size;
+    uint32_t reserved;
+    int64_t  btime_sec;   // birth time of the file, so a sidecar left
+    int64_t  btime_nsec;  // behind by a reused inode is not trusted
+};
+
+static const char   sidecar_magic[8] = {'M', 'U', 'N', 'G', 'E', 'C', 'R', 'C'};
+static const off_t  sums_offset = sizeof(sidecar_header);
+
+// files are read back this much at a time when their sums are refreshed
+static const size_t refresh_chunk = 1024 * 1024;
+
+struct integrity_file {
+    int      fd;  // of the sidecar
+    dev_t    dev;
+    ino_t    ino;
+    unsigned handles;  // guarded by the registry
+    std::mutex mutex;
+
+    integrity_file(int _fd, dev_t _dev, ino_t _ino) :
+        fd{_fd},
+        dev{_dev},
+        ino{_ino},
+        handles{0} {
+    }
+
+    ~integrity_file() {
+        close(fd);
+    }
+};
+
+struct file_key {
+    dev_t dev;
+    ino_t ino;
+
+    bool operator==(const file_key& _rhs) const {
+        return ino == _rhs.ino && dev == _rhs.dev;
+    }
+};
+
+struct file_key_hash {
+    size_t operator()(const file_key& _k) const {
+        size_t h = std::hash<uint64_t>()(_k.ino);
+        h ^= std::hash<uint64_t>()(_k.dev) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        return h;
+    }
+};
+
+static bool              static_enabled = false;
+static bool              static_log_only = false;
+static std::string       static_dir;
+static off_t             static_block = 4096;
+static std::vector<char> static_zeros;
+
+static std::mutex static_registry_mutex;
+static std::unordered_map<file_key, integrity_file_ptr, file_key_hash> static_registry;
+
+bool integrity_enabled() {
+    return static_enabled;
+} // integrity_enabled
+
+int start_integrity(const char* _dir, unsigned _block_kb, bool _log_only) {
+    if (mkdir(_dir, 0700) != 0 && EEXIST != errno) {
+        return -errno;
+    }
+
+    static_dir = _dir;
+    static_block = static_cast<off_t>(_block_kb) * 1024;
+    static_zeros.assign(static_block, 0);
+    static_log_only = _log_only;
+    static_enabled = true;
+    return 0;
+} // start_integrity
+
+static std::string sidecar_path(dev_t _dev, ino_t _ino) {
+    char name[64];
+    snprintf(name, sizeof(name), "/%llx.%llx.crc",
+             static_cast<unsigned long long>(_dev),
+             static_cast<unsigned long long>(_ino));
+    return static_dir + name;
+} // sidecar_path
+
+static sidecar_header expected_header(int _data_fd) {
+    sidecar_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, sidecar_magic, sizeof(header.magic));
+    header.block_size = static_cast<uint32_t>(static_block);
+
+    struct statx stx;
+    if (statx(_data_fd, "", AT_EMPTY_PATH, STATX_BTIME, &stx) == 0 && (stx.stx_mask & STATX_BTIME)) {
+        header.btime_sec = stx.stx_btime.tv_sec;
+        header.btime_nsec = stx.stx_btime.tv_nsec;
+    }
+
+    return header;
+} // expected_header
+
+// open the sidecar of a file, starting it over if it was kept for another
+// file or block size
+static integrity_file_ptr load_sidecar(int _data_fd, dev_t _dev, ino_t _ino) {
+    const std::string path = sidecar_path(_dev, _ino);
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        MUNGEFS_LOG(log_level::error, "no checksums for inode %llu, cannot open %s [%s]",
+                    static_cast<unsigned long long>(_ino), path.c_str(), strerror(errno));
+        return nullptr;
+    }
+
+    const sidecar_header expected = expected_header(_data_fd);
+    sidecar_header header;
+    if (pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+        0 != memcmp(&header, &expected, sizeof(header))) {
+        if (ftruncate(fd, 0) != 0 ||
+            pwrite(fd, &expected, sizeof(expected), 0) != static_cast<ssize_t>(sizeof(expected))) {
+            MUNGEFS_LOG(log_level::error, "no checksums for inode %llu, cannot write %s [%s]",
+                        static_cast<unsigned long long>(_ino), path.c_str(), strerror(errno));
+            close(fd);
+            return nullptr;
+        }
+    }
+
+    return std::make_shared<integrity_file>(fd, _dev, _ino);
+} // load_sidecar
+
+integrity_file_ptr open_integrity(int _fd, dev_t _dev, ino_t _ino) {
+    if (!static_enabled) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lk(static_registry_mutex);
+    auto& slot = static_registry[file_key{_dev, _ino}];
+    if (!slot) {
+        slot = load_sidecar(_fd, _dev, _ino);
+        if (!slot) {
+            static_registry.erase(file_key{_dev, _ino});
+            return nullptr;
+        }
+    }
+
+    ++slot->handles;
+    return slot;
+} // open_integrity
+
+void release_integrity(integrity_file_ptr& _file) {
+    if (!_file) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lk(static_registry_mutex);
+    if (0 == --_file->handles) {
+        static_registry.erase(file_key{_file->dev, _file->ino});
+    }
+
+    _file.reset();
+} // release_integrity
+
+integrity_guard::integrity_guard(const integrity_file_ptr& _file) :
+    file_{_file.get()} {
+    if (file_) {
+        file_->mutex.lock();
+    }
+} // integrity_guard::integrity_guard
+
+integrity_guard::~integrity_guard() {
+    if (file_) {
+        file_->mutex.unlock();
+    }
+} // integrity_guard::~integrity_guard
+
+// the sum kept for a block of _size bytes, zero padded to a whole block.
+// 0 is kept for blocks without one, so a checksum of 0 is kept as 1.
+static uint32_t block_sum(const char* _data, size_t _size) {
+    uint32_t crc = crc32c(0, _data, _size);
+    if (_size < static_cast<size_t>(static_block)) {
+        crc = crc32c(crc, static_zeros.data(), static_block - _size);
+    }
+
+    return crc ? crc : 1;
+} // block_sum
+
+static void read_sums(integrity_file& _f, uint64_t _first, std::vector<uint32_t>& _sums) {
+    const size_t bytes = _sums.size() * sizeof(uint32_t);
+    ssize_t got = pread(_f.fd, _sums.data(), bytes, sums_offset + _first * sizeof(uint32_t));
+    got = std::max<ssize_t>(got, 0);
+
+    // past the end of the sidecar there are no sums yet
+    memset(reinterpret_cast<char*>(_sums.data()) + got, 0, bytes - got);
+} // read_sums
+
+static void write_sums(integrity_file& _f, uint64_t _first, const std::vector<uint32_t>& _sums) {
+    const size_t bytes = _sums.size() * sizeof(uint32_t);
+    if (pwrite(_f.fd, _sums.data(), bytes, sums_offset + _first * sizeof(uint32_t)) !=
+        static_cast<ssize_t>(bytes)) {
+        MUNGEFS_LOG(log_level::error, "checksums of inode %llu not updated [%s]",
+                    static_cast<unsigned long long>(_f.ino), strerror(errno));
+    }
+} // write_sums
+
+// drop the sums past the blocks of a file of _size bytes
+static void trim_sums(integrity_file& _f, off_t _size) {
+    const off_t blocks = (_size + static_block - 1) / static_block;
+    struct stat st;
+    const off_t keep = sums_offset + blocks * static_cast<off_t>(sizeof(uint32_t));
+    if (fstat(_f.fd, &st) == 0 && st.st_size > keep) {
+        if (ftruncate(_f.fd, keep) != 0) {
+            MUNGEFS_LOG(log_level::error, "checksums of inode %llu not trimmed [%s]",
+                        static_cast<unsigned long long>(_f.ino), strerror(errno));
+        }
+    }
+} // trim_sums
+
+// read back the file, through the handle when there is one
+static ssize_t read_back(
+    mungefs_file_handle* _handle,
+    int                  _fd,
+    char*                _buf,
+    size_t               _size,
+    off_t                _offset) {
+    if (_handle && _handle->direct) {
+        return direct_pread(*_handle, _buf, _size, _offset);
+    }
+
+    return backing_pread(_handle ? _handle->fd : _fd, _buf, _size, _offset);
+} // read_back
+
+static std::vector<char>& bounce_buffer(size_t _size) {
+    thread_local std::vector<char> buffer;
+    if (buffer.size() < _size) {
+        buffer.resize(_size);
+    }
+
+    return buffer;
+} // bounce_buffer
+
+// the sum of block _index as the file holds it now, false if it cannot be read
+static bool current_sum(
+    mungefs_file_handle* _handle,
+    int                  _fd,
+    uint64_t             _index,
+    uint32_t&            _sum) {
+    auto& block = bounce_buffer(static_block);
+    ssize_t got = read_back(_handle, _fd, block.data(), static_block, _index * static_block);
+    if (got < 0) {
+        return false;
+    }
+
+    _sum = got ? block_sum(block.data(), got) : 0;
+    return true;
+} // current_sum
+
+void integrity_update(mungefs_file_handle& _handle, const char* _buf, size_t _size, off_t _offset) {
+    if (!_handle.crc || !_size) {
+        return;
+    }
+
+    const off_t end = _offset + static_cast<off_t>(_size);
+    const uint64_t first = _offset / static_block;
+    const uint64_t last = (end - 1) / static_block;
+    std::vector<uint32_t> sums(last - first + 1, 0);
+
+    // whole blocks are summed from the data written, the blocks at the
+    // edges are read back to sum what the write did not cover
+    for (uint64_t b = first; b <= last; ++b) {
+        const off_t start = b * static_block;
+        if (start >= _offset && start + static_block <= end) {
+            sums[b - first] = block_sum(_buf + (start - _offset), static_block);
+        }
+        else if (!current_sum(&_handle, -1, b, sums[b - first])) {
+            sums[b - first] = 0;
+        }
+    }
+
+    write_sums(*_handle.crc, first, sums);
+} // integrity_update
+
+// sum [_offset, _offset + _length) of the file again, to its end if _length is 0
+static void refresh_sums(
+    integrity_file&      _f,
+    mungefs_file_handle* _handle,
+    int                  _fd,
+    off_t                _offset,
+    off_t                _length) {
+    struct stat st;
+    if (fstat(_handle ? _handle->fd : _fd, &st) != 0) {
+        return;
+    }
+
+    const off_t end = _length ? std::min(st.st_size, _offset + _length) : st.st_size;
+    const size_t chunk = std::max<size_t>(refresh_chunk, static_block);
+    auto& data = bounce_buffer(chunk);
+    for (off_t at = _offset - _offset % static_block; at < end;) {
+        const size_t want = std::min<off_t>(chunk, end - at + static_block - 1) / static_block * static_block;
+        const ssize_t got = read_back(_handle, _fd, data.data(), want, at);
+        if (got <= 0) {
+            break;
+        }
+
+        std::vector<uint32_t> sums((got + static_block - 1) / static_block);
+        for (size_t i = 0; i < sums.size(); ++i) {
+            const size_t n = std::min<size_t>(static_block, got - i * static_block);
+            sums[i] = block_sum(data.data() + i * static_block, n);
+        }
+
+        write_sums(_f, at / static_block, sums);
+        at += got;
+    }
+
+    if (!_length) {
+        trim_sums(_f, st.st_size);
+    }
+} // refresh_sums
+
+void integrity_refresh(mungefs_file_handle& _handle, off_t _offset, off_t _length) {
+    if (_handle.crc) {
+        refresh_sums(*_handle.crc, &_handle, -1, _offset, _length);
+    }
+} // integrity_refresh
+
+// a file cut to _length loses the sums past it, and the block it now ends
+// in is summed again as the rest of it reads back as zeros
+static void truncate_sums(integrity_file& _f, mungefs_file_handle* _handle, int _fd, off_t _length) {
+    trim_sums(_f, _length);
+    if (_length % static_block) {
+        std::vector<uint32_t> sums(1, 0);
+        current_sum(_handle, _fd, _length / static_block, sums[0]);
+        write_sums(_f, _length / static_block, sums);
+    }
+} // truncate_sums
+
+void integrity_truncated(mungefs_file_handle& _handle, off_t _length) {
+    if (_handle.crc) {
+        truncate_sums(*_handle.crc, &_handle, -1, _length);
+    }
+} // integrity_truncated
+
+void integrity_truncated(const char* _path, off_t _length) {
+    if (!static_enabled) {
+        return;
+    }
+
+    int fd = open(_path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+
+        return;
+    }
+
+    integrity_file_ptr f = open_integrity(fd, st.st_dev, st.st_ino);
+    if (f) {
+        integrity_guard guard(f);
+        truncate_sums(*f, nullptr, fd, _length);
+    }
+
+    release_integrity(f);
+    close(fd);
+} // integrity_truncated
+
+int integrity_verify(
+    mungefs_file_handle& _handle,
+    const char*          _buf,
+    size_t               _got,
+    size_t               _size,
+    off_t                _offset,
+    const char*          _path) {
+    if (!_handle.crc || !_got) {
+        return 0;
+    }
+
+    auto& f = *_handle.crc;
+    const off_t end = _offset + static_cast<off_t>(_got);
+    const uint64_t first = _offset / static_block;
+    const uint64_t last = (end - 1) / static_block;
+    thread_local std::vector<uint32_t> sums;
+    sums.resize(last - first + 1);
+    read_sums(f, first, sums);
+
+    // a short read ended at the end of the file, where the last block ends
+    const bool at_eof = _got < _size;
+    for (uint64_t b = first; b <= last; ++b) {
+        const uint32_t expected = sums[b - first];
+        if (!expected) {
+            continue;
+        }
+
+        const off_t start = b * static_block;
+        uint32_t found = 0;
+        if (start >= _offset && (start + static_block <= end || at_eof)) {
+            found = block_sum(_buf + (start - _offset), std::min<off_t>(static_block, end - start));
+        }
+        else if (!current_sum(&_handle, -1, b, found)) {
+            continue;
+        }
+
+        if (found == expected) {
+            continue;
+        }
+
+        // a write may have landed between the read and the sums, look
+        // again with writes held off
+        uint32_t now_expected = 0;
+        {
+            integrity_guard guard(_handle.crc);
+            std::vector<uint32_t> again(1, 0);
+            read_sums(f, b, again);
+            now_expected = again[0];
+            if (!now_expected || !current_sum(&_handle, -1, b, found) || found == now_expected) {
+                continue;
+            }
+        }
+
+        MUNGEFS_LOG(log_level::error, "checksum mismatch in %s at block %llu of %lld bytes, kept %08x, found %08x",
+                    _path, static_cast<unsigned long long>(b), static_cast<long long>(static_block),
+                    now_expected, found);
+        if (!static_log_only) {
+            return -EIO;
+        }
+    }
+
+    return 0;
+} // integrity_verify
+
+integrity_name integrity_name_going(const char* _path) {
+    integrity_name name = {false, 0, 0};
+    struct stat st;
+    if (static_enabled && lstat(_path, &st) == 0 && S_ISREG(st.st_mode) && 1 == st.st_nlink) {
+        name.last = true;
+        name.dev = st.st_dev;
+        name.ino = st.st_ino;
+    }
+
+    return name;
+} // integrity_name_going
+
+void integrity_name_gone(const integrity_name& _name) {
+    if (_name.last) {
+        unlink(sidecar_path(_name.dev, _name.ino).c_str());
+    }
+} // integrity_name_gone
+
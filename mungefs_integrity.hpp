@@ -0,0 +1,89 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_INTEGRITY_HPP
+#define MUNGEFS_INTEGRITY_HPP
+
+#include <memory>
+
+#include <sys/types.h>
+
+// with -o mungefs_crc=DIR every regular file has a crc32c for each block
+// of -o mungefs_crc_block_kb, kept in a sidecar file in DIR named after
+// the file's device and inode. writes through mungefs update the sums of
+// the blocks they touch and reads verify them, so a block changed in the
+// backing store behind mungefs' back fails the read with EIO, or is only
+// logged with -o mungefs_crc_log. data corrupted by a corrupt_data fault
+// passes, as mungefs wrote it itself. blocks that have not been written
+// since the sums were kept carry no sum and are not verified.
+struct integrity_file;
+typedef std::shared_ptr<integrity_file> integrity_file_ptr;
+
+struct mungefs_file_handle;
+
+bool integrity_enabled();
+int start_integrity(const char* _dir, unsigned _block_kb, bool _log_only);
+
+// the sums of the regular file open on _fd, shared by every handle on it,
+// null unless enabled
+integrity_file_ptr open_integrity(int _fd, dev_t _dev, ino_t _ino);
+void release_integrity(integrity_file_ptr& _file);
+
+// held around a change to the file and the update of its sums, so a read
+// verifying a block never sees one without the other
+class integrity_guard {
+public:
+    explicit integrity_guard(const integrity_file_ptr& _file);
+    ~integrity_guard();
+
+    integrity_guard(const integrity_guard&) = delete;
+    integrity_guard& operator=(const integrity_guard&) = delete;
+
+private:
+    integrity_file* file_;
+}; // class integrity_guard
+
+// after _size bytes of _buf were written at _offset
+void integrity_update(mungefs_file_handle& _handle, const char* _buf, size_t _size, off_t _offset);
+
+// after the file changed in [_offset, _offset + _length) by other means,
+// _length 0 meaning up to the end of the file
+void integrity_refresh(mungefs_file_handle& _handle, off_t _offset, off_t _length);
+
+// after the file was truncated to _length, through a handle or by path
+void integrity_truncated(mungefs_file_handle& _handle, off_t _length);
+void integrity_truncated(const char* _path, off_t _length);
+
+// check _got bytes read at _offset in answer to a read of _size, returning
+// 0 or -EIO
+int integrity_verify(
+    mungefs_file_handle& _handle,
+    const char*          _buf,
+    size_t               _got,
+    size_t               _size,
+    off_t                _offset,
+    const char*          _path);
+
+// the sums of a file go when its last name does. integrity_name_going is
+// called before unlinking or replacing _path and integrity_name_gone after
+// it worked.
+struct integrity_name {
+    bool  last;
+    dev_t dev;
+    ino_t ino;
+};
+
+integrity_name integrity_name_going(const char* _path);
+void integrity_name_gone(const integrity_name& _name);
+
+#endif // MUNGEFS_INTEGRITY_HPP
+
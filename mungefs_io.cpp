@@ -0,0 +1,405 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <unistd.h>
+
+#ifdef MUNGEFS_WITH_IO_URING
+#include <liburing.h>
+#endif
+
+#include "mungefs_io.hpp"
+#include "mungefs_log.hpp"
+#include "mungefs_options.hpp"
+#include "mungefs_server.hpp"
+
+static std::atomic<bool> static_use_uring{false};
+
+static ssize_t sync_pread(int _fd, void* _buf, size_t _size, off_t _offset) {
+    ssize_t ret = pread(_fd, _buf, _size, _offset);
+    if (ret < 0) {
+        return -errno;
+    }
+
+    return ret;
+} // sync_pread
+
+static ssize_t sync_pwrite(int _fd, const void* _buf, size_t _size, off_t _offset) {
+    ssize_t ret = pwrite(_fd, _buf, _size, _offset);
+    if (ret < 0) {
+        return -errno;
+    }
+
+    return ret;
+} // sync_pwrite
+
+static int sync_fsync(int _fd, bool _datasync) {
+    int ret = _datasync ? fdatasync(_fd) : fsync(_fd);
+    if (ret < 0) {
+        return -errno;
+    }
+
+    return 0;
+} // sync_fsync
+
+#ifdef MUNGEFS_WITH_IO_URING
+
+// transfers larger than this are split and the pieces submitted as a batch
+static const size_t uring_chunk_size = 256 * 1024;
+
+class uring_batch {
+public:
+    enum kind_t { READ, WRITE, FSYNC };
+
+    struct request {
+        kind_t kind;
+        void*  buf;
+        size_t size;
+        off_t  offset;
+        int    result;
+    };
+
+    static const size_t max_requests = 16;
+
+    uring_batch(int _fd) : fd_{_fd}, count_{0} {
+    }
+
+    // returns false if the transfer cannot be expressed in one batch
+    bool add_transfer(kind_t _kind, void* _buf, size_t _size, off_t _offset) {
+        size_t done = 0;
+        do {
+            if (count_ == max_requests) {
+                return false;
+            }
+
+            size_t chunk = std::min(uring_chunk_size, _size - done);
+            reqs_[count_++] = {_kind, static_cast<char*>(_buf) + done, chunk, static_cast<off_t>(_offset + done), 0};
+            done += chunk;
+        } while (done < _size);
+
+        return true;
+    }
+
+    bool add_fsync(bool _datasync) {
+        if (count_ == max_requests) {
+            return false;
+        }
+
+        reqs_[count_++] = {FSYNC, nullptr, 0, 0, _datasync ? 1 : 0};
+        return true;
+    }
+
+    size_t count() const {
+        return count_;
+    }
+
+    request& operator[](size_t _idx) {
+        return reqs_[_idx];
+    }
+
+    // combined byte count of the data requests, stopping at the first
+    // short or failed piece just as a single pread or pwrite would
+    ssize_t transferred() const {
+        ssize_t total = 0;
+        for (size_t i = 0; i < count_; ++i) {
+            if (FSYNC == reqs_[i].kind) {
+                break;
+            }
+
+            if (reqs_[i].result < 0) {
+                return total ? total : reqs_[i].result;
+            }
+
+            total += reqs_[i].result;
+            if (static_cast<size_t>(reqs_[i].result) < reqs_[i].size) {
+                break;
+            }
+        }
+
+        return total;
+    }
+
+    int fd() const {
+        return fd_;
+    }
+
+private:
+    int     fd_;
+    size_t  count_;
+    request reqs_[max_requests];
+}; // class uring_batch
+
+// one ring per fuse worker thread, created on first use
+class thread_ring {
+public:
+    thread_ring() : ok_{false} {
+        int ret = io_uring_queue_init(
+                      get_mungefs_options().io_uring_depth,
+                      &ring_,
+                      0);
+        if (ret < 0) {
+            std::stringstream msg;
+            msg << "io_uring_queue_init failed [" << strerror(-ret)
+                << "], falling back to synchronous io";
+            log_text(log_level::warning, msg.str());
+            static_use_uring = false;
+            return;
+        }
+
+        ok_ = true;
+    }
+
+    ~thread_ring() {
+        teardown();
+    }
+
+    thread_ring(const thread_ring&) = delete;
+    thread_ring& operator=(const thread_ring&) = delete;
+
+    // submit every request in _batch at once and wait for all of them.
+    // a trailing fsync is linked to the last write and drains the ones
+    // before it. returns false if the ring could not be used.
+    bool run(uring_batch& _batch) {
+        if (!ok_ || _batch.count() > get_mungefs_options().io_uring_depth) {
+            return false;
+        }
+
+        for (size_t i = 0; i < _batch.count(); ++i) {
+            auto& req = _batch[i];
+            struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+            if (!sqe) {
+                // the ring is sized for a whole batch and drained after
+                // each one, this only happens if that invariant broke.
+                // exiting discards the entries prepared so far.
+                teardown();
+                return false;
+            }
+
+            switch (req.kind) {
+                case uring_batch::READ:
+                    io_uring_prep_read(sqe, _batch.fd(), req.buf, req.size, req.offset);
+                    break;
+                case uring_batch::WRITE:
+                    io_uring_prep_write(sqe, _batch.fd(), req.buf, req.size, req.offset);
+                    break;
+                case uring_batch::FSYNC:
+                    io_uring_prep_fsync(sqe, _batch.fd(), req.result ? IORING_FSYNC_DATASYNC : 0);
+                    if (i > 1) {
+                        sqe->flags |= IOSQE_IO_DRAIN;
+                    }
+                    break;
+            }
+
+            if (i + 1 < _batch.count() && uring_batch::FSYNC == _batch[i + 1].kind) {
+                sqe->flags |= IOSQE_IO_LINK;
+            }
+
+            io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(i));
+        }
+
+        int ret = io_uring_submit_and_wait(&ring_, _batch.count());
+        if (ret < 0) {
+            // the prepared entries may still sit in the submission queue,
+            // pointing at buffers we are about to hand back. exiting the
+            // ring makes sure they are never submitted.
+            teardown();
+            for (size_t i = 0; i < _batch.count(); ++i) {
+                _batch[i].result = ret;
+            }
+
+            return true;
+        }
+
+        bool reaped[uring_batch::max_requests] = {};
+        size_t left = _batch.count();
+        int err = 0;
+        while (left) {
+            struct io_uring_cqe* cqe = nullptr;
+            ret = io_uring_wait_cqe(&ring_, &cqe);
+            if (-EINTR == ret) {
+                continue;
+            }
+
+            // keep draining past the first failure, the kernel may still
+            // be reading into or writing from the callers' buffers
+            if (ret < 0) {
+                if (err) {
+                    break;
+                }
+
+                err = ret;
+                continue;
+            }
+
+            auto idx = reinterpret_cast<size_t>(io_uring_cqe_get_data(cqe));
+            if (idx < _batch.count() && !reaped[idx]) {
+                _batch[idx].result = cqe->res;
+                reaped[idx] = true;
+                --left;
+            }
+
+            io_uring_cqe_seen(&ring_, cqe);
+        }
+
+        if (left) {
+            for (size_t i = 0; i < _batch.count(); ++i) {
+                if (!reaped[i]) {
+                    _batch[i].result = err;
+                }
+            }
+
+            // exiting the ring cancels what the kernel has not started
+            teardown();
+        }
+
+        return true;
+    }
+
+private:
+    void teardown() {
+        if (ok_) {
+            io_uring_queue_exit(&ring_);
+            ok_ = false;
+        }
+    }
+
+    bool            ok_;
+    struct io_uring ring_;
+}; // class thread_ring
+
+static thread_ring& get_thread_ring() {
+    static thread_local thread_ring ring;
+    return ring;
+} // get_thread_ring
+
+#endif // MUNGEFS_WITH_IO_URING
+
+void init_backing_io() {
+    if (!get_mungefs_options().io_uring) {
+        return;
+    }
+
+#ifdef MUNGEFS_WITH_IO_URING
+    // probe on this thread so an unsupported kernel is reported once,
+    // at mount time, rather than by the first worker to do io
+    struct io_uring probe;
+    int ret = io_uring_queue_init(get_mungefs_options().io_uring_depth, &probe, 0);
+    if (ret < 0) {
+        std::stringstream msg;
+        msg << "io_uring unavailable [" << strerror(-ret)
+            << "], using synchronous io";
+        log_text(log_level::warning, msg.str());
+        return;
+    }
+
+    io_uring_queue_exit(&probe);
+    static_use_uring = true;
+#else
+    log_text(log_level::warning, "mungefs_io_uring requested but mungefs was built without io_uring support");
+#endif
+} // init_backing_io
+
+const char* backing_io_name() {
+    return static_use_uring ? "io_uring" : "sync";
+} // backing_io_name
+
+ssize_t backing_pread(int _fd, void* _buf, size_t _size, off_t _offset) {
+#ifdef MUNGEFS_WITH_IO_URING
+    if (static_use_uring) {
+        uring_batch batch(_fd);
+        if (batch.add_transfer(uring_batch::READ, _buf, _size, _offset) &&
+            get_thread_ring().run(batch)) {
+            return batch.transferred();
+        }
+    }
+#endif
+
+    return sync_pread(_fd, _buf, _size, _offset);
+} // backing_pread
+
+ssize_t backing_pwrite(int _fd, const void* _buf, size_t _size, off_t _offset) {
+#ifdef MUNGEFS_WITH_IO_URING
+    if (static_use_uring) {
+        uring_batch batch(_fd);
+        if (batch.add_transfer(uring_batch::WRITE, const_cast<void*>(_buf), _size, _offset) &&
+            get_thread_ring().run(batch)) {
+            return batch.transferred();
+        }
+    }
+#endif
+
+    return sync_pwrite(_fd, _buf, _size, _offset);
+} // backing_pwrite
+
+int backing_fsync(int _fd, bool _datasync) {
+#ifdef MUNGEFS_WITH_IO_URING
+    if (static_use_uring) {
+        uring_batch batch(_fd);
+        if (batch.add_fsync(_datasync) && get_thread_ring().run(batch)) {
+            return batch[0].result < 0 ? batch[0].result : 0;
+        }
+    }
+#endif
+
+    return sync_fsync(_fd, _datasync);
+} // backing_fsync
+
+ssize_t backing_pwrite_and_sync(
+    int         _fd,
+    const void* _buf,
+    size_t      _size,
+    off_t       _offset,
+    bool        _datasync) {
+#ifdef MUNGEFS_WITH_IO_URING
+    if (static_use_uring) {
+        uring_batch batch(_fd);
+        if (batch.add_transfer(uring_batch::WRITE, const_cast<void*>(_buf), _size, _offset) &&
+            batch.add_fsync(_datasync) &&
+            get_thread_ring().run(batch)) {
+            ssize_t written = batch.transferred();
+            int synced = batch[batch.count() - 1].result;
+            if (written < 0) {
+                return written;
+            }
+
+            // a short write breaks the link and cancels the sync
+            if (synced < 0 && -ECANCELED != synced) {
+                return synced;
+            }
+
+            if (static_cast<size_t>(written) < _size) {
+                return written;
+            }
+
+            return synced < 0 ? synced : written;
+        }
+    }
+#endif
+
+    ssize_t written = sync_pwrite(_fd, _buf, _size, _offset);
+    if (written < 0 || static_cast<size_t>(written) < _size) {
+        return written;
+    }
+
+    int ret = sync_fsync(_fd, _datasync);
+    if (ret < 0) {
+        return ret;
+    }
+
+    return written;
+} // backing_pwrite_and_sync
+
@@ -0,0 +1,40 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_IO_HPP
+#define MUNGEFS_IO_HPP
+
+#include <sys/types.h>
+
+// data path to the backing files. when mungefs is built with io_uring
+// support and mounted with -o mungefs_io_uring, each fuse worker thread
+// submits to its own ring, otherwise these are plain system calls.
+// all of them return the byte count or zero on success, -errno on failure.
+
+void init_backing_io();
+const char* backing_io_name();
+
+ssize_t backing_pread(int _fd, void* _buf, size_t _size, off_t _offset);
+ssize_t backing_pwrite(int _fd, const void* _buf, size_t _size, off_t _offset);
+int backing_fsync(int _fd, bool _datasync);
+
+// write _buf and then sync the file, the sync is linked to the write so
+// both are submitted together and the sync only runs if the write succeeded
+ssize_t backing_pwrite_and_sync(
+    int         _fd,
+    const void* _buf,
+    size_t      _size,
+    off_t       _offset,
+    bool        _datasync);
+
+#endif // MUNGEFS_IO_HPP
+
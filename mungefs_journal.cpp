@@ -0,0 +1,202 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+
+#include <time.h>
+
+#include "mungefs_journal.hpp"
+
+// events kept before the oldest is overwritten
+static const uint64_t journal_slots = 4096;
+
+static const size_t record_operation_size = 22;
+static const size_t record_path_size = 128;
+
+// an event as stored, sized to three cache lines
+struct journal_record {
+    int64_t  mono_ns;
+    int64_t  wall_ns;
+    uint64_t rule_id;
+    int32_t  pid;
+    int32_t  err_no;
+    uint32_t delay_us;
+    uint32_t flags;
+    uint8_t  operation_length;
+    uint8_t  path_length;
+    char     operation[record_operation_size];
+    char     path[record_path_size];
+};
+
+static const size_t record_words = sizeof(journal_record) / sizeof(uint64_t);
+static_assert(sizeof(journal_record) == 192, "journal_record is not 192 bytes");
+
+// the state of a slot is the sequence number of its event plus one, shifted
+// left two bits, with the stage of the event in the low bits. the record is
+// kept in atomic words so a reader can copy it while a writer overwrites
+// it, and finds out afterwards from the state.
+static const uint64_t slot_writing = 1;
+static const uint64_t slot_written = 2;
+static const uint64_t slot_lost    = 3;
+
+struct journal_slot {
+    std::atomic<uint64_t>                           state;
+    std::array<std::atomic<uint64_t>, record_words> words;
+};
+
+static std::atomic<uint64_t>                     static_next_seq(0);
+static std::atomic<uint64_t>                     static_lost(0);
+static std::array<journal_slot, journal_slots>   static_slots;
+
+static int64_t clock_ns(clockid_t _clock) {
+    timespec now;
+    clock_gettime(_clock, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+} // clock_ns
+
+void journal_fault(
+    const uint64_t     _rule_id,
+    const pid_t        _pid,
+    const std::string& _operation,
+    const std::string& _path,
+    const int          _err_no,
+    const uint32_t     _delay_us,
+    const uint32_t     _flags) {
+    journal_record r;
+    memset(&r, 0, sizeof(r));
+    r.mono_ns = clock_ns(CLOCK_MONOTONIC);
+    r.wall_ns = clock_ns(CLOCK_REALTIME);
+    r.rule_id = _rule_id;
+    r.pid = _pid;
+    r.err_no = _err_no;
+    r.delay_us = _delay_us;
+    r.flags = _flags;
+    r.operation_length = std::min(_operation.size(), record_operation_size);
+    memcpy(r.operation, _operation.data(), r.operation_length);
+
+    // the end of a long path names the file, keep that
+    size_t skip = 0;
+    if (_path.size() > record_path_size) {
+        skip = _path.size() - record_path_size;
+        r.flags |= JOURNAL_TRUNCATED;
+    }
+
+    r.path_length = _path.size() - skip;
+    memcpy(r.path, _path.data() + skip, r.path_length);
+
+    uint64_t words[record_words];
+    memcpy(words, &r, sizeof(r));
+
+    const uint64_t seq = static_next_seq.fetch_add(1, std::memory_order_relaxed);
+    journal_slot& slot = static_slots[seq % journal_slots];
+    const uint64_t mine = (seq + 1) << 2;
+
+    uint64_t state = slot.state.load(std::memory_order_relaxed);
+    while (true) {
+        // a later turn of the ring got here first
+        if (state >> 2 > seq + 1) {
+            static_lost.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // the writer of an earlier turn is still at it, mark this event
+        // lost so readers do not wait for it, and that one fails to finish
+        if (slot_writing == (state & 3)) {
+            if (slot.state.compare_exchange_weak(state, mine | slot_lost, std::memory_order_relaxed)) {
+                static_lost.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            continue;
+        }
+
+        if (slot.state.compare_exchange_weak(state, mine | slot_writing, std::memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    // the words must not be seen before the state says they are changing
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < record_words; ++i) {
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    }
+
+    uint64_t expected = mine | slot_writing;
+    if (!slot.state.compare_exchange_strong(expected, mine | slot_written, std::memory_order_release)) {
+        static_lost.fetch_add(1, std::memory_order_relaxed);
+    }
+} // journal_fault
+
+uint64_t read_journal(
+    const uint64_t              _after,
+    const size_t                _max,
+    std::vector<journal_event>& _events) {
+    const uint64_t next = static_next_seq.load(std::memory_order_acquire);
+
+    // what is more than a turn behind has been overwritten
+    uint64_t seq = _after;
+    if (next > journal_slots && seq < next - journal_slots) {
+        seq = next - journal_slots;
+    }
+
+    for (size_t n = 0; seq < next && n < _max; ++seq) {
+        journal_slot& slot = static_slots[seq % journal_slots];
+        const uint64_t mine = (seq + 1) << 2;
+
+        const uint64_t state = slot.state.load(std::memory_order_acquire);
+        if (state >> 2 < seq + 1 || (mine | slot_writing) == state) {
+            break;
+        }
+
+        // lost or already overwritten
+        if ((mine | slot_written) != state) {
+            continue;
+        }
+
+        uint64_t words[record_words];
+        for (size_t i = 0; i < record_words; ++i) {
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.state.load(std::memory_order_relaxed) != state) {
+            continue;
+        }
+
+        journal_record r;
+        memcpy(&r, words, sizeof(r));
+
+        journal_event e;
+        e.seq = seq;
+        e.mono_ns = r.mono_ns;
+        e.wall_ns = r.wall_ns;
+        e.rule_id = r.rule_id;
+        e.pid = r.pid;
+        e.err_no = r.err_no;
+        e.delay_us = r.delay_us;
+        e.flags = r.flags;
+        e.operation.assign(r.operation, r.operation_length);
+        e.path.assign(r.path, r.path_length);
+        _events.push_back(e);
+        ++n;
+    }
+
+    return seq;
+} // read_journal
+
+uint64_t journal_lost() {
+    return static_lost.load(std::memory_order_relaxed);
+} // journal_lost
+
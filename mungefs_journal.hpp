@@ -0,0 +1,67 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_JOURNAL_HPP
+#define MUNGEFS_JOURNAL_HPP
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// the journal keeps the last faults that fired, in the order they fired,
+// for matching a failed test against what was injected. recording one is
+// a handful of atomic operations on a ring of fixed size records, it never
+// waits on a lock. the oldest records are overwritten once the ring wraps.
+
+// what a fault did besides returning its err_no
+static const uint32_t JOURNAL_CORRUPTED = 1 << 0;  // data or size corrupted
+static const uint32_t JOURNAL_KILLED    = 1 << 1;  // the caller was killed
+static const uint32_t JOURNAL_TRUNCATED = 1 << 2;  // only the end of the path kept
+
+struct journal_event {
+    uint64_t    seq;       // numbered from 0, gaps are lost events
+    int64_t     mono_ns;   // CLOCK_MONOTONIC
+    int64_t     wall_ns;   // CLOCK_REALTIME
+    uint64_t    rule_id;   // as reported in the stats
+    pid_t       pid;
+    int32_t     err_no;    // the positive errno returned, 0 for none
+    uint32_t    delay_us;
+    uint32_t    flags;
+    std::string operation;
+    std::string path;
+};
+
+// record a fault that fired
+void journal_fault(
+    const uint64_t     _rule_id,
+    const pid_t        _pid,
+    const std::string& _operation,
+    const std::string& _path,
+    const int          _err_no,
+    const uint32_t     _delay_us,
+    const uint32_t     _flags);
+
+// append up to _max events numbered _after or later to _events and return
+// the number to ask for next. events still being written end the read.
+uint64_t read_journal(
+    const uint64_t              _after,
+    const size_t                _max,
+    std::vector<journal_event>& _events);
+
+// events that could not be recorded because a writer was preempted for a
+// whole turn of the ring
+uint64_t journal_lost();
+
+#endif // MUNGEFS_JOURNAL_HPP
+
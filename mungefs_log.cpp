@@ -0,0 +1,376 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mungefs_log.hpp"
+
+std::atomic<int> log_threshold(static_cast<int>(log_level::info));
+
+// sized so a record fills four cache lines
+static const size_t record_text_size = 240;
+
+// records a thread can have waiting before it starts dropping them
+static const size_t ring_slots = 512;
+
+// how long the writer sleeps once the queues are empty
+static const std::chrono::milliseconds writer_idle(10);
+
+struct log_record {
+    int64_t  time_ns;   // wall clock
+    uint32_t tid;
+    uint16_t level;
+    uint16_t length;
+    char     text[record_text_size];
+};
+
+// a single producer, single consumer queue of records
+class log_ring {
+public:
+    log_ring() : retired{false}, head_{0}, slots_(), tail_{0} {
+    }
+
+    // a slot to fill in and publish, or nullptr if the queue is full
+    log_record* claim() {
+        const uint64_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) >= ring_slots) {
+            return nullptr;
+        }
+
+        return &slots_[head % ring_slots];
+    }
+
+    // returns the number of records now waiting
+    uint64_t publish() {
+        const uint64_t head = head_.load(std::memory_order_relaxed) + 1;
+        head_.store(head, std::memory_order_release);
+        return head - tail_.load(std::memory_order_relaxed);
+    }
+
+    template <typename F>
+    void drain(F _consume) {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        const uint64_t head = head_.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            _consume(slots_[tail % ring_slots]);
+        }
+
+        tail_.store(tail, std::memory_order_release);
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_relaxed);
+    }
+
+    // set once the thread that writes to the queue has exited
+    std::atomic<bool> retired;
+
+private:
+    // the slots keep the two ends of the queue off each other's cache line
+    std::atomic<uint64_t>              head_;
+    std::array<log_record, ring_slots> slots_;
+    std::atomic<uint64_t>              tail_;
+}; // class log_ring
+
+static std::mutex                             static_rings_mutex;
+static std::vector<std::shared_ptr<log_ring>> static_rings;
+static std::atomic<uint64_t>                  static_dropped(0);
+
+// the writer sleeps on this between rounds, a queue filling up wakes it
+static std::mutex              static_writer_mutex;
+static std::condition_variable static_writer_cv;
+
+// hands the queue of an exiting thread over to the writer to finish
+struct ring_holder {
+    std::shared_ptr<log_ring> ring;
+    uint32_t                  tid;
+
+    ring_holder() : tid(static_cast<uint32_t>(syscall(SYS_gettid))) {
+    }
+
+    ~ring_holder() {
+        if (ring) {
+            ring->retired.store(true, std::memory_order_release);
+        }
+    }
+};
+
+static ring_holder& thread_ring() {
+    thread_local ring_holder holder;
+    if (!holder.ring) {
+        holder.ring = std::make_shared<log_ring>();
+        std::lock_guard<std::mutex> lk(static_rings_mutex);
+        static_rings.push_back(holder.ring);
+    }
+
+    return holder;
+} // thread_ring
+
+static const char* level_name(uint16_t _level) {
+    static const char* names[] = {"ERROR", "WARNING", "INFO", "DEBUG"};
+    return _level < 4 ? names[_level] : "?";
+} // level_name
+
+// one line per record, with the line ending left to the text if present
+static void push_text(
+    const log_level _level,
+    const char*     _text,
+    size_t          _length) {
+    ring_holder& holder = thread_ring();
+
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    const int64_t time_ns = static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+
+    do {
+        const char* eol = static_cast<const char*>(memchr(_text, '\n', _length));
+        size_t line = eol ? eol - _text : _length;
+        const size_t chunk = std::min(line, record_text_size);
+
+        log_record* r = holder.ring->claim();
+        if (!r) {
+            static_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        r->time_ns = time_ns;
+        r->tid = holder.tid;
+        r->level = static_cast<uint16_t>(_level);
+        r->length = chunk;
+        memcpy(r->text, _text, chunk);
+        if (ring_slots / 2 == holder.ring->publish()) {
+            static_writer_cv.notify_one();
+        }
+
+        // skip the newline that ended a whole line
+        const size_t used = chunk + (chunk == line && eol ? 1 : 0);
+        _text += used;
+        _length -= used;
+    } while (_length);
+} // push_text
+
+// drains every queue into the log file from its own thread
+class log_writer {
+public:
+    log_writer() : fd_{-1}, stop_{false}, reported_dropped_{0} {
+    }
+
+    ~log_writer() {
+        stop();
+    }
+
+    void start(const std::string& _path) {
+        fd_ = open(_path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            fprintf(stderr, "cannot open log %s [%s], nothing will be logged\n",
+                    _path.c_str(), strerror(errno));
+            return;
+        }
+
+        stop_ = false;
+        thread_ = std::make_unique<std::thread>(&log_writer::run, this);
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lk(static_writer_mutex);
+            stop_ = true;
+        }
+
+        static_writer_cv.notify_all();
+        if (thread_) {
+            thread_->join();
+            thread_.reset();
+        }
+
+        if (fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+private:
+    void run() {
+        while (true) {
+            write_queued();
+
+            // producers do not take the mutex, a missed wake up costs one
+            // idle period at most
+            std::unique_lock<std::mutex> lk(static_writer_mutex);
+            if (!stop_) {
+                static_writer_cv.wait_for(lk, writer_idle);
+            }
+
+            if (stop_) {
+                break;
+            }
+        }
+
+        // whatever was logged while stopping
+        write_queued();
+    }
+
+    void write_queued() {
+        std::vector<std::shared_ptr<log_ring>> rings;
+        {
+            std::lock_guard<std::mutex> lk(static_rings_mutex);
+            rings = static_rings;
+        }
+
+        batch_.clear();
+        for (const auto& ring : rings) {
+            ring->drain([this](const log_record& _r) { batch_.push_back(_r); });
+        }
+
+        // threads are drained one after the other, put them back in order
+        std::stable_sort(
+            batch_.begin(),
+            batch_.end(),
+            [](const log_record& _a, const log_record& _b) {
+                return _a.time_ns < _b.time_ns;
+            });
+
+        out_.clear();
+        for (const auto& r : batch_) {
+            append_line(r.time_ns, r.tid, level_name(r.level), r.text, r.length);
+        }
+
+        const uint64_t dropped = static_dropped.load(std::memory_order_relaxed);
+        if (dropped != reported_dropped_) {
+            char text[64];
+            int n = snprintf(text, sizeof(text), "%llu log records dropped",
+                             static_cast<unsigned long long>(dropped - reported_dropped_));
+            timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            append_line(static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec,
+                        0, "WARNING", text, n);
+            reported_dropped_ = dropped;
+        }
+
+        for (size_t off = 0; off < out_.size();) {
+            ssize_t n = write(fd_, out_.data() + off, out_.size() - off);
+            if (n <= 0) {
+                break;
+            }
+
+            off += n;
+        }
+
+        // forget the threads that have exited once their records are out
+        std::lock_guard<std::mutex> lk(static_rings_mutex);
+        static_rings.erase(
+            std::remove_if(
+                static_rings.begin(),
+                static_rings.end(),
+                [](const std::shared_ptr<log_ring>& _ring) {
+                    return _ring->retired.load(std::memory_order_acquire) && _ring->empty();
+                }),
+            static_rings.end());
+    }
+
+    void append_line(
+        int64_t     _time_ns,
+        uint32_t    _tid,
+        const char* _level,
+        const char* _text,
+        size_t      _length) {
+        time_t seconds = _time_ns / 1000000000;
+        struct tm tm;
+        localtime_r(&seconds, &tm);
+
+        char prefix[96];
+        size_t n = strftime(prefix, sizeof(prefix), "%Y-%m-%d %H:%M:%S", &tm);
+        n += snprintf(prefix + n, sizeof(prefix) - n, ".%06lld %s [%u] ",
+                      static_cast<long long>(_time_ns % 1000000000 / 1000), _level, _tid);
+        out_.append(prefix, n);
+        out_.append(_text, _length);
+        out_.push_back('\n');
+    }
+
+    int                          fd_;
+    bool                         stop_;
+    uint64_t                     reported_dropped_;
+    std::vector<log_record>      batch_;
+    std::string                  out_;
+    std::unique_ptr<std::thread> thread_;
+}; // class log_writer
+
+static log_writer static_log_writer;
+
+bool parse_log_level(const std::string& _name, log_level& _level) {
+    static const char* names[] = {"error", "warning", "info", "debug"};
+    for (int i = 0; i < 4; ++i) {
+        if (_name == names[i]) {
+            _level = static_cast<log_level>(i);
+            return true;
+        }
+    }
+
+    return false;
+} // parse_log_level
+
+void set_log_level(const log_level _level) {
+    log_threshold.store(static_cast<int>(_level), std::memory_order_relaxed);
+} // set_log_level
+
+void start_logger(const std::string& _path) {
+    static_log_writer.start(_path);
+} // start_logger
+
+void stop_logger() {
+    static_log_writer.stop();
+} // stop_logger
+
+void log_printf(const log_level _level, const char* _format, ...) {
+    if (!log_enabled(_level)) {
+        return;
+    }
+
+    char text[1024];
+    va_list args;
+    va_start(args, _format);
+    int n = vsnprintf(text, sizeof(text), _format, args);
+    va_end(args);
+    if (n < 0) {
+        return;
+    }
+
+    push_text(_level, text, std::min(static_cast<size_t>(n), sizeof(text) - 1));
+} // log_printf
+
+void log_text(const log_level _level, const std::string& _text) {
+    if (log_enabled(_level) && !_text.empty()) {
+        push_text(_level, _text.data(), _text.size());
+    }
+} // log_text
+
+void log_message(const std::string& _msg) {
+    log_text(log_level::info, _msg);
+} // log_message
+
@@ -0,0 +1,66 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_LOG_HPP
+#define MUNGEFS_LOG_HPP
+
+#include <atomic>
+#include <string>
+
+// the log is written by a thread of its own. a thread that logs formats
+// its message into a fixed size record on a queue only it writes to, so
+// logging never waits on a lock or on the disk. records that find their
+// queue full are dropped and counted.
+enum class log_level : int {
+    error   = 0,
+    warning = 1,
+    info    = 2,
+    debug   = 3
+};
+
+// records above this level are discarded where they are made
+extern std::atomic<int> log_threshold;
+
+inline bool log_enabled(const log_level _level) {
+    return static_cast<int>(_level) <= log_threshold.load(std::memory_order_relaxed);
+}
+
+// returns false for a name that is not error, warning, info or debug
+bool parse_log_level(const std::string& _name, log_level& _level);
+
+void set_log_level(const log_level _level);
+
+// start writing records to the file at _path, appending to it
+void start_logger(const std::string& _path);
+
+// write what is queued and stop
+void stop_logger();
+
+// queue one message, longer ones are split across lines
+void log_printf(const log_level _level, const char* _format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+void log_text(const log_level _level, const std::string& _text);
+
+// an informational message
+void log_message(const std::string& _msg);
+
+// skips formatting the arguments when the level is filtered out
+#define MUNGEFS_LOG(level, ...)                         \
+    do {                                                \
+        if (log_enabled(level)) {                       \
+            log_printf(level, __VA_ARGS__);             \
+        }                                               \
+    } while (0)
+
+#endif // MUNGEFS_LOG_HPP
+
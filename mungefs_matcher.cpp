@@ -0,0 +1,327 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <deque>
+
+#include "mungefs_matcher.hpp"
+
+static const size_t no_match = std::string::npos;
+
+// what a path must look like for a regexp to match all of it
+struct pattern_literals {
+    bool        usable;    // false if nothing could be worked out
+    std::string prefix;    // the path starts with this
+    std::string required;  // the path contains this
+};
+
+// index just past the bracket expression starting at _pos
+static size_t skip_class(const std::string& _re, size_t _pos) {
+    size_t i = _pos + 1;
+    if (i < _re.size() && '^' == _re[i]) {
+        ++i;
+    }
+
+    // a leading ] is part of the set
+    if (i < _re.size() && ']' == _re[i]) {
+        ++i;
+    }
+
+    while (i < _re.size() && ']' != _re[i]) {
+        i += '\\' == _re[i] ? 2 : 1;
+    }
+
+    return i < _re.size() ? i + 1 : no_match;
+} // skip_class
+
+// index just past the group starting at _pos
+static size_t skip_group(const std::string& _re, size_t _pos) {
+    size_t depth = 0;
+    size_t i = _pos;
+    while (i < _re.size()) {
+        switch (_re[i]) {
+            case '\\':
+                i += 2;
+                break;
+            case '[':
+                i = skip_class(_re, i);
+                if (no_match == i) {
+                    return no_match;
+                }
+                break;
+            case '(':
+                ++depth;
+                ++i;
+                break;
+            case ')':
+                ++i;
+                if (0 == --depth) {
+                    return i;
+                }
+                break;
+            default:
+                ++i;
+        }
+    }
+
+    return no_match;
+} // skip_group
+
+// index just past the quantifier at _pos, or _pos if there is none
+static size_t skip_quantifier(const std::string& _re, size_t _pos) {
+    if (_pos >= _re.size()) {
+        return _pos;
+    }
+
+    size_t i = _pos;
+    switch (_re[i]) {
+        case '*':
+        case '+':
+        case '?':
+            ++i;
+            break;
+        case '{':
+            i = _re.find('}', i);
+            if (no_match == i) {
+                return no_match;
+            }
+            ++i;
+            break;
+        default:
+            return _pos;
+    }
+
+    // lazy quantifier
+    if (i < _re.size() && '?' == _re[i]) {
+        ++i;
+    }
+
+    return i;
+} // skip_quantifier
+
+// split an ecmascript regexp into runs of literal characters that every
+// match contains in order. only a pattern without top level alternation
+// can be reduced, anything not understood makes the pattern unusable.
+static pattern_literals analyze_pattern(const std::string& _re) {
+    pattern_literals lit;
+    lit.usable = false;
+
+    std::string run;
+    bool run_at_start = true;
+    auto end_run = [&]() {
+        if (run_at_start) {
+            lit.prefix = run;
+        }
+
+        if (run.size() > lit.required.size()) {
+            lit.required = run;
+        }
+
+        run.clear();
+        run_at_start = false;
+    };
+
+    size_t i = 0;
+    if (!_re.empty() && '^' == _re[0]) {
+        i = 1;
+    }
+
+    while (i < _re.size()) {
+        const char c = _re[i];
+        bool literal = false;
+        char value = c;
+        size_t next = i + 1;
+
+        if ('\\' == c) {
+            if (i + 1 >= _re.size()) {
+                return pattern_literals{false, "", ""};
+            }
+
+            // \d, \w, \b, \n and the like are one character atoms that
+            // are not literals. \x41, \u0041, \cJ and back references run
+            // on past the letter, anything but the known escapes is left to
+            // the full scan rather than misread.
+            value = _re[i + 1];
+            literal = !std::isalnum(static_cast<unsigned char>(value));
+            if (!literal && !strchr("dDwWsSbBfnrtv", value)) {
+                return pattern_literals{false, "", ""};
+            }
+
+            next = i + 2;
+        }
+        else if ('[' == c) {
+            next = skip_class(_re, i);
+        }
+        else if ('(' == c) {
+            next = skip_group(_re, i);
+        }
+        else if ('.' == c || ('$' == c && i + 1 == _re.size())) {
+        }
+        else if (strchr("|*+?{}()[]^$", c)) {
+            return pattern_literals{false, "", ""};
+        }
+        else {
+            literal = true;
+        }
+
+        if (no_match == next) {
+            return pattern_literals{false, "", ""};
+        }
+
+        // a quantified atom may repeat or vanish, it ends the run
+        size_t after = skip_quantifier(_re, next);
+        if (no_match == after) {
+            return pattern_literals{false, "", ""};
+        }
+
+        if (after != next || !literal) {
+            end_run();
+        }
+        else {
+            run += value;
+        }
+
+        i = after;
+    }
+
+    end_run();
+    lit.usable = true;
+    return lit;
+} // analyze_pattern
+
+path_matcher::path_matcher() :
+    trie_(1),
+    automaton_() {
+} // path_matcher::path_matcher
+
+path_matcher::path_matcher(const std::vector<std::string>& _patterns) :
+    trie_(1),
+    automaton_() {
+    for (uint32_t i = 0; i < _patterns.size(); ++i) {
+        auto lit = analyze_pattern(_patterns[i]);
+        if (!lit.usable) {
+            always_.push_back(i);
+        }
+        else if (!lit.prefix.empty()) {
+            add_prefix(lit.prefix, i);
+        }
+        else if (!lit.required.empty()) {
+            add_literal(lit.required, i);
+        }
+        else {
+            always_.push_back(i);
+        }
+    }
+
+    build_automaton();
+} // path_matcher::path_matcher
+
+void path_matcher::add_prefix(const std::string& _prefix, uint32_t _pattern) {
+    uint32_t node = 0;
+    for (char c : _prefix) {
+        auto it = trie_[node].children.find(c);
+        if (trie_[node].children.end() == it) {
+            trie_.emplace_back();
+            it = trie_[node].children.emplace(c, trie_.size() - 1).first;
+        }
+
+        node = it->second;
+    }
+
+    trie_[node].patterns.push_back(_pattern);
+} // path_matcher::add_prefix
+
+void path_matcher::add_literal(const std::string& _literal, uint32_t _pattern) {
+    if (automaton_.empty()) {
+        automaton_.emplace_back();
+        automaton_[0].next.fill(0);
+        automaton_[0].fail = 0;
+    }
+
+    // node 0 is the root, so 0 also means no child while inserting
+    uint32_t node = 0;
+    for (unsigned char c : _literal) {
+        if (!automaton_[node].next[c]) {
+            automaton_.emplace_back();
+            automaton_.back().next.fill(0);
+            automaton_.back().fail = 0;
+            automaton_[node].next[c] = automaton_.size() - 1;
+        }
+
+        node = automaton_[node].next[c];
+    }
+
+    automaton_[node].patterns.push_back(_pattern);
+} // path_matcher::add_literal
+
+// turn the trie of literals into a complete transition table, so a scan
+// never backtracks
+void path_matcher::build_automaton() {
+    if (automaton_.empty()) {
+        return;
+    }
+
+    std::deque<uint32_t> queue;
+    queue.push_back(0);
+    while (!queue.empty()) {
+        uint32_t u = queue.front();
+        queue.pop_front();
+
+        // the fail node is shallower than u, so its table is complete
+        const uint32_t fail = automaton_[u].fail;
+        for (size_t c = 0; c < 256; ++c) {
+            uint32_t v = automaton_[u].next[c];
+            if (!v) {
+                automaton_[u].next[c] = u ? automaton_[fail].next[c] : 0;
+                continue;
+            }
+
+            automaton_[v].fail = u ? automaton_[fail].next[c] : 0;
+            const auto& inherited = automaton_[automaton_[v].fail].patterns;
+            automaton_[v].patterns.insert(
+                automaton_[v].patterns.end(),
+                inherited.begin(),
+                inherited.end());
+            queue.push_back(v);
+        }
+    }
+} // path_matcher::build_automaton
+
+void path_matcher::candidates(const std::string& _path, std::vector<uint32_t>& _out) const {
+    _out.assign(always_.begin(), always_.end());
+
+    uint32_t node = 0;
+    for (char c : _path) {
+        auto it = trie_[node].children.find(c);
+        if (trie_[node].children.end() == it) {
+            break;
+        }
+
+        node = it->second;
+        _out.insert(_out.end(), trie_[node].patterns.begin(), trie_[node].patterns.end());
+    }
+
+    if (!automaton_.empty()) {
+        uint32_t state = 0;
+        for (unsigned char c : _path) {
+            state = automaton_[state].next[c];
+            const auto& found = automaton_[state].patterns;
+            _out.insert(_out.end(), found.begin(), found.end());
+        }
+    }
+
+    std::sort(_out.begin(), _out.end());
+    _out.erase(std::unique(_out.begin(), _out.end()), _out.end());
+} // path_matcher::candidates
+
@@ -0,0 +1,60 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_MATCHER_HPP
+#define MUNGEFS_MATCHER_HPP
+
+#include <array>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+// narrows a list of path regexps down to the ones that can match a given
+// path, without running any of them. each pattern is reduced to a literal
+// the path has to start with, kept in a trie, or failing that a literal
+// the path has to contain, found with an aho-corasick automaton. patterns
+// that reduce to neither are candidates for every path. the cost of a
+// lookup grows with the length of the path, not the number of patterns.
+class path_matcher {
+public:
+    path_matcher();
+    explicit path_matcher(const std::vector<std::string>& _patterns);
+
+    // indices of the patterns that may match _path in ascending order,
+    // each still to be confirmed with the regexp itself
+    void candidates(const std::string& _path, std::vector<uint32_t>& _out) const;
+
+private:
+    struct trie_node {
+        std::map<char, uint32_t> children;
+        std::vector<uint32_t>    patterns;   // whose prefix ends here
+    };
+
+    struct automaton_node {
+        std::array<uint32_t, 256> next;      // complete transition table
+        uint32_t                  fail;
+        std::vector<uint32_t>     patterns;  // whose literal ends here
+    };
+
+    void add_prefix(const std::string& _prefix, uint32_t _pattern);
+    void add_literal(const std::string& _literal, uint32_t _pattern);
+    void build_automaton();
+
+    std::vector<uint32_t>       always_;
+    std::vector<trie_node>      trie_;
+    std::vector<automaton_node> automaton_;
+}; // class path_matcher
+
+#endif // MUNGEFS_MATCHER_HPP
+
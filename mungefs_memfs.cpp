@@ -0,0 +1,1173 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <algorithm>
+#include <limits>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+#include <fuse.h>
+
+#include "mungefs_compact_map.hpp"
+#include "mungefs_log.hpp"
+#include "mungefs_memfs.hpp"
+#include "mungefs_pool.hpp"
+
+#ifndef RENAME_NOREPLACE
+#define RENAME_NOREPLACE (1 << 0)
+#endif
+#ifndef RENAME_EXCHANGE
+#define RENAME_EXCHANGE (1 << 1)
+#endif
+
+static const size_t page_size = 4096;
+
+struct memfs_page {
+    char data[page_size];
+};
+
+// 2 MiB slabs of pages, recycled without going back to the allocator and
+// never returned to the system before unmount
+typedef object_pool<memfs_page, 512, 16384> page_pool;
+static page_pool static_pages;
+static std::atomic<uint64_t> static_pages_used(0);
+static uint64_t static_page_limit = 512ULL * 16384;
+
+static std::atomic<uint64_t> static_next_ino(1);
+static std::atomic<uint64_t> static_inodes(0);
+
+struct memfs_inode {
+    // guards the attributes, data and extended attributes. the entries of
+    // a directory are guarded by the tree lock instead.
+    std::shared_timed_mutex  mutex;
+    ino_t                    ino;
+    mode_t                   mode;
+    uid_t                    uid;
+    gid_t                    gid;
+    nlink_t                  nlink;
+    dev_t                    rdev;
+    struct timespec          atime;
+    struct timespec          mtime;
+    struct timespec          ctime;
+    off_t                    size;
+    std::vector<memfs_page*> pages;      // a null page is a hole
+    size_t                   allocated;  // pages that are not null
+    std::string              target;     // of a symbolic link
+    compact_map<std::string> xattrs;
+
+    compact_map<memfs_inode_ptr> entries;
+
+    memfs_inode(mode_t _mode, uid_t _uid, gid_t _gid) :
+        ino{static_next_ino.fetch_add(1, std::memory_order_relaxed)},
+        mode{_mode},
+        uid{_uid},
+        gid{_gid},
+        nlink{static_cast<nlink_t>(S_ISDIR(_mode) ? 2 : 1)},
+        rdev{0},
+        size{0},
+        allocated{0} {
+        clock_gettime(CLOCK_REALTIME, &mtime);
+        atime = ctime = mtime;
+        static_inodes.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~memfs_inode() {
+        for (auto p : pages) {
+            if (p) {
+                static_pages.destroy(p);
+                static_pages_used.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        static_inodes.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    memfs_inode(const memfs_inode&) = delete;
+    memfs_inode& operator=(const memfs_inode&) = delete;
+};
+
+typedef std::unique_lock<std::shared_timed_mutex> unique_lock;
+typedef std::shared_lock<std::shared_timed_mutex> shared_lock;
+
+// taken shared to walk paths and exclusively to change any directory,
+// always before the lock of an inode
+static std::shared_timed_mutex static_tree_mutex;
+static memfs_inode_ptr         static_root;
+static bool                    static_enabled = false;
+
+static struct timespec now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts;
+} // now
+
+static memfs_inode_ptr new_inode(mode_t _mode) {
+    struct fuse_context* ctx = fuse_get_context();
+    return std::make_shared<memfs_inode>(
+               _mode,
+               ctx ? ctx->uid : getuid(),
+               ctx ? ctx->gid : getgid());
+} // new_inode
+
+// find the inode at _path, with the tree lock held
+static int lookup(const char* _path, memfs_inode_ptr& _out) {
+    memfs_inode_ptr node = static_root;
+    const char* p = _path;
+    while (*p) {
+        while ('/' == *p) {
+            ++p;
+        }
+
+        const char* end = strchrnul(p, '/');
+        if (end == p) {
+            break;
+        }
+
+        if (!S_ISDIR(node->mode)) {
+            return -ENOTDIR;
+        }
+
+        const memfs_inode_ptr* child = node->entries.find(std::string(p, end - p));
+        if (!child) {
+            return -ENOENT;
+        }
+
+        node = *child;
+        p = end;
+    }
+
+    _out = node;
+    return 0;
+} // lookup
+
+// find the directory _path names an entry of, with the tree lock held
+static int lookup_parent(
+    const char*      _path,
+    memfs_inode_ptr& _parent,
+    std::string&     _name) {
+    std::string path(_path);
+    while (path.size() > 1 && '/' == path.back()) {
+        path.pop_back();
+    }
+
+    const size_t slash = path.rfind('/');
+    _name = path.substr(slash + 1);
+    if (_name.empty()) {
+        return -EBUSY;
+    }
+
+    if (_name.size() > NAME_MAX) {
+        return -ENAMETOOLONG;
+    }
+
+    int ret = lookup(path.substr(0, slash).c_str(), _parent);
+    if (ret) {
+        return ret;
+    }
+
+    return S_ISDIR(_parent->mode) ? 0 : -ENOTDIR;
+} // lookup_parent
+
+static void touch_directory(memfs_inode& _dir, int _nlink_change) {
+    unique_lock lk(_dir.mutex);
+    _dir.nlink += _nlink_change;
+    _dir.mtime = _dir.ctime = now();
+} // touch_directory
+
+static void drop_link(memfs_inode& _node) {
+    unique_lock lk(_node.mutex);
+    _node.nlink = S_ISDIR(_node.mode) ? 0 : _node.nlink - 1;
+    _node.ctime = now();
+} // drop_link
+
+static memfs_page* allocate_page() {
+    if (static_pages_used.fetch_add(1, std::memory_order_relaxed) >= static_page_limit) {
+        static_pages_used.fetch_sub(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    // value initialized, so zero filled
+    memfs_page* page = static_pages.create();
+    if (!page) {
+        static_pages_used.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    return page;
+} // allocate_page
+
+static void free_page(memfs_inode& _node, size_t _index) {
+    if (_node.pages[_index]) {
+        static_pages.destroy(_node.pages[_index]);
+        static_pages_used.fetch_sub(1, std::memory_order_relaxed);
+        _node.pages[_index] = nullptr;
+        --_node.allocated;
+    }
+} // free_page
+
+// change the size with the inode locked. bytes past the size are always
+// zero, so growing leaves holes and shrinking clears the tail page.
+static void resize_locked(memfs_inode& _node, off_t _length) {
+    if (_length < _node.size) {
+        const size_t keep = (_length + page_size - 1) / page_size;
+        for (size_t i = keep; i < _node.pages.size(); ++i) {
+            free_page(_node, i);
+        }
+        _node.pages.resize(keep);
+
+        const size_t tail = _length % page_size;
+        if (tail && keep && _node.pages[keep - 1]) {
+            memset(_node.pages[keep - 1]->data + tail, 0, page_size - tail);
+        }
+    }
+
+    _node.size = _length;
+    _node.mtime = _node.ctime = now();
+} // resize_locked
+
+static void fill_stat(memfs_inode& _node, struct stat* _st) {
+    shared_lock lk(_node.mutex);
+    memset(_st, 0, sizeof(*_st));
+    _st->st_ino = _node.ino;
+    _st->st_mode = _node.mode;
+    _st->st_nlink = _node.nlink;
+    _st->st_uid = _node.uid;
+    _st->st_gid = _node.gid;
+    _st->st_rdev = _node.rdev;
+    _st->st_size = S_ISLNK(_node.mode) ? _node.target.size() :
+                   S_ISDIR(_node.mode) ? page_size : _node.size;
+    _st->st_blksize = page_size;
+    _st->st_blocks = _node.allocated * (page_size / 512);
+    _st->st_atim = _node.atime;
+    _st->st_mtim = _node.mtime;
+    _st->st_ctim = _node.ctime;
+} // fill_stat
+
+// add a new inode at _path, with the tree locked exclusively
+static int add_node(
+    const char*            _path,
+    const memfs_inode_ptr& _node) {
+    memfs_inode_ptr parent;
+    std::string name;
+    int ret = lookup_parent(_path, parent, name);
+    if (ret) {
+        return -EBUSY == ret ? -EEXIST : ret;
+    }
+
+    if (!parent->entries.insert(name, _node)) {
+        return -EEXIST;
+    }
+
+    touch_directory(*parent, S_ISDIR(_node->mode) ? 1 : 0);
+    return 0;
+} // add_node
+
+bool memfs_enabled() {
+    return static_enabled;
+} // memfs_enabled
+
+// copy the file behind _fd into the pages of _node, leaving pages that are
+// all zeros as holes
+static int copy_file_data(int _fd, memfs_inode& _node) {
+    memfs_page buf;
+    static const memfs_page zeros = {};
+    for (size_t index = 0;; ++index) {
+        ssize_t n = 0;
+        while (n < static_cast<ssize_t>(page_size)) {
+            ssize_t r = read(_fd, buf.data + n, page_size - n);
+            if (r < 0) {
+                return -errno;
+            }
+
+            if (0 == r) {
+                break;
+            }
+
+            n += r;
+        }
+
+        if (0 == n) {
+            return 0;
+        }
+
+        _node.pages.push_back(nullptr);
+        _node.size += n;
+        if (0 == memcmp(buf.data, zeros.data, n)) {
+            continue;
+        }
+
+        memfs_page* page = allocate_page();
+        if (!page) {
+            return -ENOSPC;
+        }
+
+        memcpy(page->data, buf.data, n);
+        _node.pages[index] = page;
+        ++_node.allocated;
+    }
+} // copy_file_data
+
+static void copy_xattrs(const std::string& _path, memfs_inode& _node) {
+    ssize_t size = llistxattr(_path.c_str(), nullptr, 0);
+    if (size <= 0) {
+        return;
+    }
+
+    std::vector<char> names(size);
+    size = llistxattr(_path.c_str(), names.data(), names.size());
+    for (ssize_t off = 0; off < size; off += strlen(names.data() + off) + 1) {
+        const char* name = names.data() + off;
+        ssize_t length = lgetxattr(_path.c_str(), name, nullptr, 0);
+        if (length < 0) {
+            continue;
+        }
+
+        std::string value(length, '\0');
+        length = lgetxattr(_path.c_str(), name, &value[0], value.size());
+        if (length >= 0) {
+            value.resize(length);
+            _node.xattrs.insert(name, value);
+        }
+    }
+} // copy_xattrs
+
+typedef std::map<std::pair<dev_t, ino_t>, memfs_inode_ptr> link_map;
+
+// copy the tree below _path into _dir, hard links included
+static int copy_tree(
+    const std::string& _path,
+    memfs_inode&       _dir,
+    link_map&          _links) {
+    DIR* d = opendir(_path.c_str());
+    if (!d) {
+        return -errno;
+    }
+
+    int ret = 0;
+    while (struct dirent* de = readdir(d)) {
+        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) {
+            continue;
+        }
+
+        const std::string path = _path + "/" + de->d_name;
+        struct stat st;
+        if (lstat(path.c_str(), &st) < 0) {
+            MUNGEFS_LOG(log_level::warning, "memfs seed skips %s [%s]", path.c_str(), strerror(errno));
+            continue;
+        }
+
+        const auto key = std::make_pair(st.st_dev, st.st_ino);
+        if (!S_ISDIR(st.st_mode) && st.st_nlink > 1 && _links.count(key)) {
+            const memfs_inode_ptr& node = _links[key];
+            ++node->nlink;
+            _dir.entries.insert(de->d_name, node);
+            continue;
+        }
+
+        auto node = std::make_shared<memfs_inode>(st.st_mode, st.st_uid, st.st_gid);
+        node->rdev = st.st_rdev;
+        if (S_ISDIR(st.st_mode)) {
+            ret = copy_tree(path, *node, _links);
+            ++_dir.nlink;
+        }
+        else if (S_ISREG(st.st_mode)) {
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            ret = fd < 0 ? -errno : copy_file_data(fd, *node);
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        else if (S_ISLNK(st.st_mode)) {
+            char target[PATH_MAX];
+            ssize_t n = readlink(path.c_str(), target, sizeof(target));
+            if (n >= 0) {
+                node->target.assign(target, n);
+            }
+        }
+
+        copy_xattrs(path, *node);
+        node->atime = st.st_atim;
+        node->mtime = st.st_mtim;
+        node->ctime = st.st_ctim;
+        _dir.entries.insert(de->d_name, node);
+        if (st.st_nlink > 1 && !S_ISDIR(st.st_mode)) {
+            _links[key] = node;
+        }
+
+        if (-ENOSPC == ret) {
+            break;
+        }
+
+        if (ret) {
+            MUNGEFS_LOG(log_level::warning, "memfs seed failed to copy %s [%s]", path.c_str(), strerror(-ret));
+            ret = 0;
+        }
+    }
+
+    closedir(d);
+    return ret;
+} // copy_tree
+
+int start_memfs(const char* _seed_dir, unsigned _limit_mb) {
+    const uint64_t pool_pages = static_page_limit;
+    if (_limit_mb) {
+        static_page_limit = std::min<uint64_t>(pool_pages, static_cast<uint64_t>(_limit_mb) * (1024 * 1024 / page_size));
+    }
+
+    static_root = std::make_shared<memfs_inode>(S_IFDIR | 0755, getuid(), getgid());
+    static_enabled = true;
+    if (!_seed_dir) {
+        return 0;
+    }
+
+    struct stat st;
+    if (stat(_seed_dir, &st) < 0) {
+        return -errno;
+    }
+
+    static_root->mode = st.st_mode;
+    static_root->uid = st.st_uid;
+    static_root->gid = st.st_gid;
+
+    link_map links;
+    int ret = copy_tree(_seed_dir, *static_root, links);
+    static_root->mtime = st.st_mtim;
+    return ret;
+} // start_memfs
+
+int memfs_getattr(const char* _path, struct stat* _st) {
+    shared_lock tree(static_tree_mutex);
+    memfs_inode_ptr node;
+    int ret = lookup(_path, node);
+    if (ret) {
+        return ret;
+    }
+
+    fill_stat(*node, _st);
+    return 0;
+} // memfs_getattr
+
+int memfs_readlink(const char* _path, char* _buf, size_t _size) {
+    shared_lock tree(static_tree_mutex);
+    memfs_inode_ptr node;
+    int ret = lookup(_path, node);
+    if (ret) {
+        return ret;
+    }
+
+    if (!S_ISLNK(node->mode)) {
+        return -EINVAL;
+    }
+
+    if (!_size) {
+        return 0;
+    }
+
+    // fuse wants the target nul terminated, truncated if need be
+    const size_t n = std::min(node->target.size(), _size - 1);
+    memcpy(_buf, node->target.data(), n);
+    _buf[n] = '\0';
+    return 0;
+} // memfs_readlink
+
+int memfs_mknod(const char* _path, mode_t _mode, dev_t _dev) {
+    unique_lock tree(static_tree_mutex);
+    auto node = new_inode(S_IFMT & _mode ? _mode : S_IFREG | _mode);
+    node->rdev = _dev;
+    return add_node(_path, node);
+} // memfs_mknod
+
+int memfs_mkdir(const char* _path, mode_t _mode) {
+    unique_lock tree(static_tree_mutex);
+    return add_node(_path, new_inode(S_IFDIR | (_mode & 07777)));
+} // memfs_mkdir
+
+int memfs_unlink(const char* _path) {
+    unique_lock tree(static_tree_mutex);
+    memfs_inode_ptr parent;
+    std::string name;
+    int ret = lookup_parent(_path, parent, name);
+    if (ret) {
+        return ret;
+    }
+
+    const memfs_inode_ptr* child = parent->entries.find(name);
+    if (!child) {
+        return -ENOENT;
+    }
+
+    if (S_ISDIR((*child)->mode)) {
+        return -EISDIR;
+    }
+
+    // open handles keep the inode and its data alive
+    memfs_inode_ptr node = *child;
+    parent->entries.erase(name);
+    drop_link(*node);
+    touch_directory(*parent, 0);
+    return 0;
+} // memfs_unlink
+
+int memfs_rmdir(const char* _path) {
+    unique_lock tree(static_tree_mutex);
+    memfs_inode_ptr parent;
+    std::string name;
+    int ret = lookup_parent(_path, parent, name);
+    if (ret) {
+        return ret;
+    }
+
+    const memfs_inode_ptr* child = parent->entries.find(name);
+    if (!child) {
+        return -ENOENT;
+    }
+
+    if (!S_ISDIR((*child)->mode)) {
+        return -ENOTDIR;
+    }
+
+    if (!(*child)->entries.empty()) {
+        return -ENOTEMPTY;
+    }
+
+    memfs_inode_ptr node = *child;
+    parent->entries.erase(name);
+    drop_link(*node);
+    touch_directory(*parent, -1);
+    return 0;
+} // memfs_rmdir
+
+int memfs_symlink(const char* _target, const char* _linkpath) {
+    unique_lock tree(static_tree_mutex);
+    auto node = new_inode(S_IFLNK | 0777);
+    node->target = _target;
+    return add_node(_linkpath, node);
+} // memfs_symlink
+
+// true if _path is _dir or lies below it
+static bool is_within(const std::string& _path, const std::string& _dir) {
+    return 0 == _path.compare(0, _dir.size(), _dir) &&
+           (_path.size() == _dir.size() || '/' == _path[_dir.size()]);
+} // is_within
+
+int memfs_rename(const char* _oldpath, const char* _newpath, unsigned _flags) {
+    if (_flags & ~(RENAME_NOREPLACE | RENAME_EXCHANGE) ||
+        ((_flags & RENAME_NOREPLACE) && (_flags & RENAME_EXCHANGE))) {
+        return -EINVAL;
+    }
+
+    unique_lock tree(static_tree_mutex);
+    memfs_inode_ptr old_parent, new_parent;
+    std::string old_name, new_name;
+    int ret = lookup_parent(_oldpath, old_parent, old_name);
+    if (!ret) {
+        ret = lookup_parent(_newpath, new_parent, new_name);
+    }
+
+    if (ret) {
+        return ret;
+    }
+
+    const memfs_inode_ptr* src_entry = old_parent->entries.find(old_name);
+    if (!src_entry) {
+        return -ENOENT;
+    }
+
+    memfs_inode_ptr src = *src_entry;
+    const memfs_inode_ptr* dst_entry = new_parent->entries.find(new_name);
+    memfs_inode_ptr dst = dst_entry ? *dst_entry : memfs_inode_ptr();
+    if (src == dst) {
+        return 0;
+    }
+
+    // a directory cannot move below itself
+    if ((S_ISDIR(src->mode) && is_within(_newpath, _oldpath)) ||
+        (dst && S_ISDIR(dst->mode) && is_within(_oldpath, _newpath))) {
+        return -EINVAL;
+    }
+
+    const int src_dir = S_ISDIR(src->mode) ? 1 : 0;
+    if (_flags & RENAME_EXCHANGE) {
+        if (!dst) {
+            return -ENOENT;
+        }
+
+        const int dst_dir = S_ISDIR(dst->mode) ? 1 : 0;
+        *old_parent->entries.find(old_name) = dst;
+        *new_parent->entries.find(new_name) = src;
+        touch_directory(*old_parent, old_parent == new_parent ? 0 : dst_dir - src_dir);
+        if (old_parent != new_parent) {
+            touch_directory(*new_parent, src_dir - dst_dir);
+        }
+
+        return 0;
+    }
+
+    int new_parent_links = src_dir;
+    if (dst) {
+        if (_flags & RENAME_NOREPLACE) {
+            return -EEXIST;
+        }
+
+        if (src_dir && !S_ISDIR(dst->mode)) {
+            return -ENOTDIR;
+        }
+
+        if (!src_dir && S_ISDIR(dst->mode)) {
+            return -EISDIR;
+        }
+
+        if (!dst->entries.empty()) {
+            return -ENOTEMPTY;
+        }
+
+        // the replaced directory's link from its parent goes with it
+        new_parent_links -= S_ISDIR(dst->mode) ? 1 : 0;
+        drop_link(*dst);
+        *new_parent->entries.find(new_name) = src;
+    }
+    else {
+        new_parent->entries.insert(new_name, src);
+    }
+
+    old_parent->entries.erase(old_name);
+    if (old_parent == new_parent) {
+        touch_directory(*old_parent, new_parent_links - src_dir);
+    }
+    else {
+        touch_directory(*old_parent, -src_dir);
+        touch_directory(*new_parent, new_parent_links);
+    }
+
+    unique_lock lk(src->mutex);
+    src->ctime = now();
+    return 0;
+} // memfs_rename
+
+int memfs_link(const char* _oldpath, const char* _newpath) {
+    unique_lock tree(static_tree_mutex);
+    memfs_inode_ptr node;
+    int ret = lookup(_oldpath, node);
+    if (ret) {
+        return ret;
+    }
+
+    if (S_ISDIR(node->mode)) {
+        return -EPERM;
+    }
+
+    ret = add_node(_newpath, node);
+    if (ret) {
+        return ret;
+    }
+
+    unique_lock lk(node->mutex);
+    ++node->nlink;
+    node->ctime = now();
+    return 0;
+} // memfs_link
+
+// find _path and run _change on it with the inode locked exclusively
+template <typename F>
+static int change_inode(const char* _path, F _change) {
+    shared_lock tree(static_tree_mutex);
+    memfs_inode_ptr node;
+    int ret = lookup(_path, node);
+    if (ret) {
+        return ret;
+    }
+
+    unique_lock lk(node->mutex);
+    return _change(*node);
+} // change_inode
+
+int memfs_chmod(const char* _path, mode_t _mode) {
+    return change_inode(_path, [_mode](memfs_inode& _node) {
+        _node.mode = (_node.mode & S_IFMT) | (_mode & 07777);
+        _node.ctime = now();
+        return 0;
+    });
+} // memfs_chmod
+
+int memfs_chown(const char* _path, uid_t _uid, gid_t _gid) {
+    return change_inode(_path, [_uid, _gid](memfs_inode& _node) {
+        if (static_cast<uid_t>(-1) != _uid) {
+            _node.uid = _uid;
+        }
+
+        if (static_cast<gid_t>(-1) != _gid) {
+            _node.gid = _gid;
+        }
+
+        _node.ctime = now();
+        return 0;
+    });
+} // memfs_chown
+
+int memfs_truncate(const char* _path, off_t _length) {
+    if (_length < 0) {
+        return -EINVAL;
+    }
+
+    return change_inode(_path, [_length](memfs_inode& _node) {
+        if (S_ISDIR(_node.mode)) {
+            return -EISDIR;
+        }
+
+        resize_locked(_node, _length);
+        return 0;
+    });
+} // memfs_truncate
+
+int memfs_utimens(const char* _path, const struct timespec _tv[2]) {
+    return change_inode(_path, [_tv](memfs_inode& _node) {
+        const struct timespec t = now();
+        auto pick = [&t](const struct timespec& _ts, struct timespec& _field) {
+            if (UTIME_NOW == _ts.tv_nsec) {
+                _field = t;
+            }
+            else if (UTIME_OMIT != _ts.tv_nsec) {
+                _field = _ts;
+            }
+        };
+
+        if (_tv) {
+            pick(_tv[0], _node.atime);
+            pick(_tv[1], _node.mtime);
+        }
+        else {
+            _node.atime = _node.mtime = t;
+        }
+
+        _node.ctime = t;
+        return 0;
+    });
+} // memfs_utimens
+
+int memfs_access(const char* _path, int _mode) {
+    shared_lock tree(static_tree_mutex);
+    memfs_inode_ptr node;
+    int ret = lookup(_path, node);
+    if (ret || F_OK == _mode) {
+        return ret;
+    }
+
+    struct fuse_context* ctx = fuse_get_context();
+    shared_lock lk(node->mutex);
+    const mode_t any_x = S_IXUSR | S_IXGRP | S_IXOTH;
+    if (!ctx || 0 == ctx->uid) {
+        return (_mode & X_OK) && !S_ISDIR(node->mode) && !(node->mode & any_x) ? -EACCES : 0;
+    }
+
+    // rwx of the class the caller falls in, lined up with R_OK, W_OK, X_OK
+    const int shift = ctx->uid == node->uid ? 6 : ctx->gid == node->gid ? 3 : 0;
+    const int granted = (node->mode >> shift) & 7;
+    return (_mode & granted) == _mode ? 0 : -EACCES;
+} // memfs_access
+
+int memfs_statfs(struct statvfs* _st) {
+    memset(_st, 0, sizeof(*_st));
+    const uint64_t used = static_pages_used.load(std::memory_order_relaxed);
+    _st->f_bsize = page_size;
+    _st->f_frsize = page_size;
+    _st->f_blocks = static_page_limit;
+    _st->f_bfree = used < static_page_limit ? static_page_limit - used : 0;
+    _st->f_bavail = _st->f_bfree;
+    _st->f_files = static_inodes.load(std::memory_order_relaxed) + UINT32_MAX;
+    _st->f_ffree = UINT32_MAX;
+    _st->f_favail = UINT32_MAX;
+    _st->f_namemax = NAME_MAX;
+    return 0;
+} // memfs_statfs
+
+int memfs_setxattr(const char* _path, const char* _name, const char* _value, size_t _size, int _flags) {
+    return change_inode(_path, [=](memfs_inode& _node) {
+        std::string* value = _node.xattrs.find(_name);
+        if (value && (_flags & XATTR_CREATE)) {
+            return -EEXIST;
+        }
+
+        if (!value && (_flags & XATTR_REPLACE)) {
+            return -ENODATA;
+        }
+
+        if (value) {
+            value->assign(_value, _size);
+        }
+        else {
+            _node.xattrs.insert(_name, std::string(_value, _size));
+        }
+
+        _node.ctime = now();
+        return 0;
+    });
+} // memfs_setxattr
+
+// copy _data out the way the xattr calls do: the size when asked for
+// none, ERANGE when it does not fit
+static int copy_xattr_out(const std::string& _data, char* _out, size_t _size) {
+    if (!_size) {
+        return _data.size();
+    }
+
+    if (_size < _data.size()) {
+        return -ERANGE;
+    }
+
+    memcpy(_out, _data.data(), _data.size());
+    return _data.size();
+} // copy_xattr_out
+
+int memfs_getxattr(const char* _path, const char* _name, char* _value, size_t _size) {
+    shared_lock tree(static_tree_mutex);
+    memfs_inode_ptr node;
+    int ret = lookup(_path, node);
+    if (ret) {
+        return ret;
+    }
+
+    shared_lock lk(node->mutex);
+    const std::string* value = node->xattrs.find(_name);
+    return value ? copy_xattr_out(*value, _value, _size) : -ENODATA;
+} // memfs_getxattr
+
+int memfs_listxattr(const char* _path, char* _list, size_t _size) {
+    shared_lock tree(static_tree_mutex);
+    memfs_inode_ptr node;
+    int ret = lookup(_path, node);
+    if (ret) {
+        return ret;
+    }
+
+    shared_lock lk(node->mutex);
+    std::string names;
+    node->xattrs.for_each([&names](const std::string& _name, const std::string&) {
+        names.append(_name);
+        names.push_back('\0');
+    });
+    return copy_xattr_out(names, _list, _size);
+} // memfs_listxattr
+
+int memfs_removexattr(const char* _path, const char* _name) {
+    return change_inode(_path, [_name](memfs_inode& _node) {
+        if (!_node.xattrs.erase(_name)) {
+            return -ENODATA;
+        }
+
+        _node.ctime = now();
+        return 0;
+    });
+} // memfs_removexattr
+
+int memfs_open(const char* _path, int _flags, mode_t _mode, memfs_inode_ptr& _inode) {
+    memfs_inode_ptr node;
+    int ret = 0;
+    if (_flags & O_CREAT) {
+        unique_lock tree(static_tree_mutex);
+        ret = lookup(_path, node);
+        if (!ret && (_flags & O_EXCL)) {
+            return -EEXIST;
+        }
+
+        if (-ENOENT == ret) {
+            node = new_inode(S_IFREG | (_mode & 07777));
+            ret = add_node(_path, node);
+        }
+    }
+    else {
+        shared_lock tree(static_tree_mutex);
+        ret = lookup(_path, node);
+    }
+
+    if (ret) {
+        return ret;
+    }
+
+    const bool writing = O_RDONLY != (_flags & O_ACCMODE);
+    if (S_ISDIR(node->mode) && writing) {
+        return -EISDIR;
+    }
+
+    if ((_flags & O_TRUNC) && writing && S_ISREG(node->mode)) {
+        unique_lock lk(node->mutex);
+        resize_locked(*node, 0);
+    }
+
+    _inode = node;
+    return 0;
+} // memfs_open
+
+int memfs_opendir(const char* _path, memfs_inode_ptr& _inode) {
+    shared_lock tree(static_tree_mutex);
+    int ret = lookup(_path, _inode);
+    if (ret) {
+        return ret;
+    }
+
+    return S_ISDIR(_inode->mode) ? 0 : -ENOTDIR;
+} // memfs_opendir
+
+int memfs_readdir(
+    const memfs_inode_ptr&                                       _dir,
+    const std::function<bool(const char*, const struct stat&)>& _fill) {
+    shared_lock tree(static_tree_mutex);
+    struct stat st;
+    fill_stat(*_dir, &st);
+    if (_fill(".", st) || _fill("..", st)) {
+        return 0;
+    }
+
+    bool full = false;
+    _dir->entries.for_each([&](const std::string& _name, const memfs_inode_ptr& _node) {
+        if (!full) {
+            fill_stat(*_node, &st);
+            full = _fill(_name.c_str(), st);
+        }
+    });
+    return 0;
+} // memfs_readdir
+
+int memfs_fstat(const memfs_inode_ptr& _inode, struct stat* _st) {
+    fill_stat(*_inode, _st);
+    return 0;
+} // memfs_fstat
+
+ssize_t memfs_pread(const memfs_inode_ptr& _inode, char* _buf, size_t _size, off_t _offset) {
+    shared_lock lk(_inode->mutex);
+    if (S_ISDIR(_inode->mode)) {
+        return -EISDIR;
+    }
+
+    if (_offset < 0) {
+        return -EINVAL;
+    }
+
+    if (_offset >= _inode->size) {
+        return 0;
+    }
+
+    const size_t size = std::min<uint64_t>(_size, _inode->size - _offset);
+    for (size_t done = 0; done < size;) {
+        const size_t index = (_offset + done) / page_size;
+        const size_t in_page = (_offset + done) % page_size;
+        const size_t chunk = std::min(size - done, page_size - in_page);
+        memfs_page* page = index < _inode->pages.size() ? _inode->pages[index] : nullptr;
+        if (page) {
+            memcpy(_buf + done, page->data + in_page, chunk);
+        }
+        else {
+            memset(_buf + done, 0, chunk);
+        }
+
+        done += chunk;
+    }
+
+    return size;
+} // memfs_pread
+
+ssize_t memfs_pwrite(
+    const memfs_inode_ptr& _inode,
+    const char*            _buf,
+    size_t                 _size,
+    off_t                  _offset,
+    bool                   _append) {
+    unique_lock lk(_inode->mutex);
+    memfs_inode& node = *_inode;
+    if (_append) {
+        _offset = node.size;
+    }
+
+    if (_offset < 0) {
+        return -EINVAL;
+    }
+
+    if (static_cast<uint64_t>(_offset) + _size > static_cast<uint64_t>(std::numeric_limits<off_t>::max())) {
+        return -EFBIG;
+    }
+
+    const size_t pages = (_offset + _size + page_size - 1) / page_size;
+    if (node.pages.size() < pages) {
+        node.pages.resize(pages, nullptr);
+    }
+
+    size_t done = 0;
+    while (done < _size) {
+        const size_t index = (_offset + done) / page_size;
+        const size_t in_page = (_offset + done) % page_size;
+        const size_t chunk = std::min(_size - done, page_size - in_page);
+        if (!node.pages[index]) {
+            node.pages[index] = allocate_page();
+            if (!node.pages[index]) {
+                break;
+            }
+
+            ++node.allocated;
+        }
+
+        memcpy(node.pages[index]->data + in_page, _buf + done, chunk);
+        done += chunk;
+    }
+
+    if (!done && _size) {
+        return -ENOSPC;
+    }
+
+    if (_offset + static_cast<off_t>(done) > node.size) {
+        node.size = _offset + done;
+    }
+
+    node.mtime = node.ctime = now();
+    return done;
+} // memfs_pwrite
+
+int memfs_ftruncate(const memfs_inode_ptr& _inode, off_t _length) {
+    if (_length < 0) {
+        return -EINVAL;
+    }
+
+    unique_lock lk(_inode->mutex);
+    resize_locked(*_inode, _length);
+    return 0;
+} // memfs_ftruncate
+
+int memfs_fallocate(const memfs_inode_ptr& _inode, int _mode, off_t _offset, off_t _length) {
+    if (_mode & ~(FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE) ||
+        ((_mode & FALLOC_FL_PUNCH_HOLE) && !(_mode & FALLOC_FL_KEEP_SIZE))) {
+        return -EOPNOTSUPP;
+    }
+
+    if (_offset < 0 || _length <= 0) {
+        return -EINVAL;
+    }
+
+    unique_lock lk(_inode->mutex);
+    memfs_inode& node = *_inode;
+    const uint64_t end = static_cast<uint64_t>(_offset) + _length;
+
+    // whole pages in the range are freed, the edges cleared in place
+    if (_mode & FALLOC_FL_PUNCH_HOLE) {
+        for (uint64_t pos = _offset; pos < end;) {
+            const size_t index = pos / page_size;
+            const size_t in_page = pos % page_size;
+            const size_t chunk = std::min<uint64_t>(end - pos, page_size - in_page);
+            if (index >= node.pages.size()) {
+                break;
+            }
+
+            if (chunk == page_size) {
+                free_page(node, index);
+            }
+            else if (node.pages[index]) {
+                memset(node.pages[index]->data + in_page, 0, chunk);
+            }
+
+            pos += chunk;
+        }
+
+        node.mtime = node.ctime = now();
+        return 0;
+    }
+
+    const size_t pages = (end + page_size - 1) / page_size;
+    if (node.pages.size() < pages) {
+        node.pages.resize(pages, nullptr);
+    }
+
+    for (size_t index = _offset / page_size; index < pages; ++index) {
+        if (!node.pages[index]) {
+            node.pages[index] = allocate_page();
+            if (!node.pages[index]) {
+                return -ENOSPC;
+            }
+
+            ++node.allocated;
+        }
+    }
+
+    if (!(_mode & FALLOC_FL_KEEP_SIZE) && static_cast<off_t>(end) > node.size) {
+        node.size = end;
+    }
+
+    node.ctime = now();
+    return 0;
+} // memfs_fallocate
+
+off_t memfs_lseek(const memfs_inode_ptr& _inode, off_t _offset, int _whence) {
+    shared_lock lk(_inode->mutex);
+    const memfs_inode& node = *_inode;
+    if (SEEK_SET == _whence) {
+        return _offset;
+    }
+
+    if (SEEK_END == _whence) {
+        return node.size + _offset;
+    }
+
+    if (SEEK_DATA != _whence && SEEK_HOLE != _whence) {
+        return -EINVAL;
+    }
+
+    if (_offset < 0 || _offset >= node.size) {
+        return -ENXIO;
+    }
+
+    // the end of the file counts as a hole
+    const bool want_data = SEEK_DATA == _whence;
+    for (size_t index = _offset / page_size; static_cast<off_t>(index * page_size) < node.size; ++index) {
+        const bool data = index < node.pages.size() && node.pages[index];
+        if (data == want_data) {
+            return std::max<off_t>(_offset, index * page_size);
+        }
+    }
+
+    return want_data ? -ENXIO : node.size;
+} // memfs_lseek
+
+ssize_t memfs_copy_file_range(
+    const memfs_inode_ptr& _in,
+    off_t                  _offset_in,
+    const memfs_inode_ptr& _out,
+    off_t                  _offset_out,
+    size_t                 _size) {
+    char buf[64 * 1024];
+    size_t done = 0;
+    while (done < _size) {
+        ssize_t n = memfs_pread(_in, buf, std::min(sizeof(buf), _size - done), _offset_in + done);
+        if (n <= 0) {
+            return done ? static_cast<ssize_t>(done) : n;
+        }
+
+        ssize_t w = memfs_pwrite(_out, buf, n, _offset_out + done, false);
+        if (w <= 0) {
+            return done ? static_cast<ssize_t>(done) : w;
+        }
+
+        done += w;
+        if (w < n) {
+            break;
+        }
+    }
+
+    return done;
+} // memfs_copy_file_range
+
@@ -0,0 +1,87 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_MEMFS_HPP
+#define MUNGEFS_MEMFS_HPP
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/types.h>
+#include <time.h>
+
+// with -o mungefs_memfs the namespace lives in memory instead of a backing
+// directory. file data is kept in page sized chunks from a slab pool and
+// directories and extended attributes in compact hash maps. the functions
+// below stand in for the system calls the operations make on the backing
+// directory, taking the path fuse passes and returning 0, a count or
+// -errno. fault rules are evaluated by the operations before they get here.
+struct memfs_inode;
+typedef std::shared_ptr<memfs_inode> memfs_inode_ptr;
+
+bool memfs_enabled();
+
+// build the root, copying the tree at _seed_dir into it when given.
+// _limit_mb bounds the memory file data may take, 0 for the pool's limit.
+int start_memfs(const char* _seed_dir, unsigned _limit_mb);
+
+int memfs_getattr(const char* _path, struct stat* _st);
+int memfs_readlink(const char* _path, char* _buf, size_t _size);
+int memfs_mknod(const char* _path, mode_t _mode, dev_t _dev);
+int memfs_mkdir(const char* _path, mode_t _mode);
+int memfs_unlink(const char* _path);
+int memfs_rmdir(const char* _path);
+int memfs_symlink(const char* _target, const char* _linkpath);
+int memfs_rename(const char* _oldpath, const char* _newpath, unsigned _flags);
+int memfs_link(const char* _oldpath, const char* _newpath);
+int memfs_chmod(const char* _path, mode_t _mode);
+int memfs_chown(const char* _path, uid_t _uid, gid_t _gid);
+int memfs_truncate(const char* _path, off_t _length);
+int memfs_utimens(const char* _path, const struct timespec _tv[2]);
+int memfs_access(const char* _path, int _mode);
+int memfs_statfs(struct statvfs* _st);
+
+int memfs_setxattr(const char* _path, const char* _name, const char* _value, size_t _size, int _flags);
+int memfs_getxattr(const char* _path, const char* _name, char* _value, size_t _size);
+int memfs_listxattr(const char* _path, char* _list, size_t _size);
+int memfs_removexattr(const char* _path, const char* _name);
+
+// open, or create with O_CREAT, the file at _path
+int memfs_open(const char* _path, int _flags, mode_t _mode, memfs_inode_ptr& _inode);
+int memfs_opendir(const char* _path, memfs_inode_ptr& _inode);
+
+// calls _fill with each name in the directory and its attributes, stopping
+// when it returns true
+int memfs_readdir(
+    const memfs_inode_ptr&                                       _dir,
+    const std::function<bool(const char*, const struct stat&)>& _fill);
+
+// the calls made through an open handle
+int memfs_fstat(const memfs_inode_ptr& _inode, struct stat* _st);
+ssize_t memfs_pread(const memfs_inode_ptr& _inode, char* _buf, size_t _size, off_t _offset);
+ssize_t memfs_pwrite(const memfs_inode_ptr& _inode, const char* _buf, size_t _size, off_t _offset, bool _append);
+int memfs_ftruncate(const memfs_inode_ptr& _inode, off_t _length);
+int memfs_fallocate(const memfs_inode_ptr& _inode, int _mode, off_t _offset, off_t _length);
+off_t memfs_lseek(const memfs_inode_ptr& _inode, off_t _offset, int _whence);
+ssize_t memfs_copy_file_range(
+    const memfs_inode_ptr& _in,
+    off_t                  _offset_in,
+    const memfs_inode_ptr& _out,
+    off_t                  _offset_out,
+    size_t                 _size);
+
+#endif // MUNGEFS_MEMFS_HPP
+
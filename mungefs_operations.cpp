@@ -11,8 +11,11 @@
  */
 
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <vector>
 
 #include <stdio.h>
 #include <sys/types.h>
@@ -28,12 +31,177 @@
 
 #include <string.h>
 
+#include "mungefs_crc32c.hpp"
+#include "mungefs_decision.hpp"
+#include "mungefs_direct.hpp"
+#include "mungefs_fsync.hpp"
+#include "mungefs_handle.hpp"
+#include "mungefs_integrity.hpp"
+#include "mungefs_io.hpp"
+#include "mungefs_log.hpp"
+#include "mungefs_memfs.hpp"
 #include "mungefs_operations.hpp"
+#include "mungefs_options.hpp"
+#include "mungefs_pool.hpp"
+#include "mungefs_powerloss.hpp"
+#include "mungefs_queue.hpp"
+#include "mungefs_scenario.hpp"
 #include "mungefs_server.hpp"
+#include "mungefs_snapshot.hpp"
 
-static std::ofstream err_log;
 
-#define ERR_LOG err_log << __FUNCTION__ << ":" << __LINE__ << " - "
+
+// open and close are frequent enough that handles are recycled rather
+// than going through the global allocator each time
+static object_pool<mungefs_file_handle> static_handle_pool;
+
+// wrap a freshly opened backing descriptor in a handle for fi->fh
+static int open_file_handle(int _fd, struct fuse_file_info* _fi) {
+    auto handle = static_handle_pool.create(_fd);
+    if (!handle) {
+        close(_fd);
+        return -ENFILE;
+    }
+
+    handle->direct = is_direct_descriptor(_fd);
+    if (handle->direct || prefetch_enabled() || powerloss_enabled() || integrity_enabled() ||
+        write_coalescing_enabled()) {
+        struct stat st;
+        if (fstat(_fd, &st) == 0) {
+            handle->dev = st.st_dev;
+            handle->ino = st.st_ino;
+            if (integrity_enabled() && S_ISREG(st.st_mode)) {
+                handle->crc = open_integrity(_fd, st.st_dev, st.st_ino);
+            }
+        }
+    }
+
+    if (powerloss_enabled() && (_fi->flags & O_ACCMODE) != O_RDONLY) {
+        handle->unsynced = track_unsynced(_fd, handle->dev, handle->ino);
+        handle->sync_writes = (_fi->flags & (O_SYNC | O_DSYNC)) != 0;
+    }
+
+    // the kernel then passes reads and writes through without caching them
+    if (get_mungefs_options().direct_io) {
+        _fi->direct_io = 1;
+    }
+
+    init_write_buffer(*handle, handle->direct ? _fi->flags | O_DIRECT : _fi->flags);
+    _fi->fh = reinterpret_cast<uint64_t>(handle);
+    return 0;
+}
+
+// memfs handles hold the inode instead of a descriptor and skip the
+// prefetch cache and write buffer, both only help a backing file
+static int open_memfs_handle(
+    const char*            _path,
+    int                    _flags,
+    mode_t                 _mode,
+    struct fuse_file_info* _fi) {
+    memfs_inode_ptr inode;
+    int ret = memfs_open(_path, _flags, _mode, inode);
+    if (ret) {
+        return ret;
+    }
+
+    auto handle = static_handle_pool.create(inode);
+    if (!handle) {
+        return -ENFILE;
+    }
+
+    if (get_mungefs_options().direct_io) {
+        _fi->direct_io = 1;
+    }
+
+    _fi->fh = reinterpret_cast<uint64_t>(handle);
+    return 0;
+}
+
+static int close_file_handle(struct fuse_file_info* _fi) {
+    auto handle = get_file_handle(_fi);
+    if (handle->mem) {
+        static_handle_pool.destroy(handle);
+        _fi->fh = 0;
+        return 0;
+    }
+
+    // the last buffered writes land before any snapshot after this
+    snapshot_guard guard(snapshot_mutex());
+    forget_write_buffer(*handle);
+    int ret = flush_write_buffer(*handle);
+    release_unsynced(handle->unsynced);
+    release_integrity(handle->crc);
+    prefetch_forget(*handle);
+    close(handle->fd);
+    static_handle_pool.destroy(handle);
+    _fi->fh = 0;
+    return ret;
+}
+
+// evaluate the fault resolved for this handle, matching the path against
+// the rules again only after they have changed
+static int evaluate_cached_fault(
+    std::shared_ptr<const resolved_fault>& _cache,
+    const char*                            _path,
+    const std::string&                     _operation,
+    bool&                                  _corrupt_flag,
+    queue_slot&                            _slot) {
+    auto resolved = std::atomic_load(&_cache);
+    if (!resolved || resolved->epoch != resolved_fault_epoch()) {
+        resolved = resolve_fault(_path, _operation);
+        std::atomic_store(&_cache, resolved);
+    }
+
+    return evaluate_resolved_fault(*resolved, _operation, _corrupt_flag, &_slot);
+}
+
+// a handle opened before a reset fails with ESTALE, and one opened before
+// a snapshot has its file kept before it changes it. a caller that
+// modifies holds a snapshot_guard from here until the change is written.
+static int check_snapshot_epoch(
+    const char*          _path,
+    mungefs_file_handle& _handle,
+    bool                 _modifies) {
+    if (_handle.epoch.load(std::memory_order_relaxed) == snapshot_epoch()) {
+        return 0;
+    }
+
+    return snapshot_catch_up(_path, _handle.fd, _handle.epoch, _modifies);
+}
+
+// a handle opened before a power cut lost what it would write with it
+static int check_power_cycle(const mungefs_file_handle& _handle) {
+    return powered_off_since(_handle.power_cycle) ? -EIO : 0;
+}
+
+// set once the kernel granted the writeback cache
+static bool static_writeback_cache = false;
+
+// with the writeback cache the kernel reads around partial page writes,
+// also through handles opened write-only, and places appends itself
+static int writeback_cache_flags(int _flags) {
+    if (!static_writeback_cache) {
+        return _flags;
+    }
+
+    if ((_flags & O_ACCMODE) == O_WRONLY) {
+        _flags = (_flags & ~O_ACCMODE) | O_RDWR;
+    }
+
+    return _flags & ~O_APPEND;
+}
+
+// cached reads of a file must not outlive a change made through mungefs
+static void invalidate_cached_data(const char* _path) {
+    if (!prefetch_enabled() || memfs_enabled()) {
+        return;
+    }
+
+    struct stat st;
+    if (stat(_path, &st) == 0) {
+        prefetch_invalidate(st.st_dev, st.st_ino, 0, 0);
+    }
+}
 
 int mungefs_getattr(const char *path, struct stat *buf) {
     bool corrupt_flag = false;
@@ -45,8 +213,16 @@ int mungefs_getattr(const char *path, struct stat *buf) {
         return ret;
     }
 
-    ret = stat(path, buf);
-    if (ret < 0) {
+    ret = memfs_enabled() ? memfs_getattr(path, buf) :
+          stat(path, buf) < 0 ? -errno : 0;
+    if (ret) {
+        return ret;
+    }
+
+    // the size must count writes still sitting in a handle's buffer
+    if (!memfs_enabled() && S_ISREG(buf->st_mode) &&
+        flush_write_buffers(buf->st_dev, buf->st_ino) &&
+        stat(path, buf) < 0) {
         return -errno;
     }
    
@@ -63,6 +239,10 @@ int mungefs_readlink(const char *path, char *buf, size_t bufsiz) {
         return ret;
     }
 
+    if (memfs_enabled()) {
+        return memfs_readlink(path, buf, bufsiz);
+    }
+
     ret = readlink(path, buf, bufsiz);
     if (ret < 0) {
         return -errno;
@@ -77,6 +257,13 @@ int mungefs_mknod(const char *path, mode_t mode, dev_t dev) {
         return ret;
     }
 
+    if (memfs_enabled()) {
+        return memfs_mknod(path, mode, dev);
+    }
+
+    snapshot_guard guard(snapshot_mutex());
+    note_snapshot_change(path, 0);
+
     ret = mknod(path, mode, dev);    
     if (ret < 0) {
         return -errno;
@@ -91,6 +278,13 @@ int mungefs_mkdir(const char *path, mode_t mode) {
         return ret;
     }
 
+    if (memfs_enabled()) {
+        return memfs_mkdir(path, mode);
+    }
+
+    snapshot_guard guard(snapshot_mutex());
+    note_snapshot_change(path, 0);
+
     ret = mkdir(path, mode);
     if (ret < 0) {
         return -errno;
@@ -105,11 +299,22 @@ int mungefs_unlink(const char *path) {
         return ret;
     }
 
+    if (memfs_enabled()) {
+        return memfs_unlink(path);
+    }
+
+    snapshot_guard guard(snapshot_mutex());
+    note_snapshot_change(path, SNAPSHOT_CONTENT);
+
+    // the inode number may be reused by the next file created
+    invalidate_cached_data(path);
+    const integrity_name name = integrity_name_going(path);
     ret = unlink(path); 
     if (ret < 0) {
         return -errno;
     }
 
+    integrity_name_gone(name);
     return 0;
 }
 
@@ -119,6 +324,13 @@ int mungefs_rmdir(const char *path) {
         return ret;
     }
 
+    if (memfs_enabled()) {
+        return memfs_rmdir(path);
+    }
+
+    snapshot_guard guard(snapshot_mutex());
+    note_snapshot_change(path, 0);
+
     ret = rmdir(path); 
     if (ret < 0) {
         return -errno;
@@ -138,6 +350,13 @@ int mungefs_symlink(const char *target, const char *linkpath) {
         return ret;
     }
 
+    if (memfs_enabled()) {
+        return memfs_symlink(target, linkpath);
+    }
+
+    snapshot_guard guard(snapshot_mutex());
+    note_snapshot_change(linkpath, 0);
+
     ret = symlink(target, linkpath);
     if (ret < 0) {
         return -errno;
@@ -157,11 +376,25 @@ int mungefs_rename(const char *oldpath, const char *newpath) {
         return ret;
     }
 
-    ret = rename(oldpath, newpath);
-    if (ret < 0) {
-        return -errno;
+    // a directory that moves takes its subtree along
+    snapshot_guard guard(snapshot_mutex());
+    if (!memfs_enabled()) {
+        note_snapshot_change(oldpath, SNAPSHOT_CONTENT | SNAPSHOT_SUBTREE);
+        note_snapshot_change(newpath, SNAPSHOT_CONTENT | SNAPSHOT_SUBTREE);
     }
 
+    invalidate_cached_data(newpath);
+    const integrity_name replaced = integrity_name_going(newpath);
+    ret = memfs_enabled() ? memfs_rename(oldpath, newpath, 0) :
+          rename(oldpath, newpath) < 0 ? -errno : 0;
+    if (ret) {
+        return ret;
+    }
+
+    integrity_name_gone(replaced);
+
+    // handles open below either path now match the rules under a new name
+    invalidate_resolved_faults();
     return 0;
 }
 
@@ -176,6 +409,13 @@ int mungefs_link(const char *oldpath, const char *newpath) {
         return ret;
     }
     
+    if (memfs_enabled()) {
+        return memfs_link(oldpath, newpath);
+    }
+
+    snapshot_guard guard(snapshot_mutex());
+    note_snapshot_change(newpath, 0);
+
     ret = link(oldpath, newpath);
     if (ret < 0) {
         return -errno;
@@ -190,6 +430,13 @@ int mungefs_chmod(const char *path, mode_t mode) {
         return ret;
     }
     
+    if (memfs_enabled()) {
+        return memfs_chmod(path, mode);
+    }
+
+    snapshot_guard guard(snapshot_mutex());
+    note_snapshot_change(path, 0);
+
     ret = chmod(path, mode);
     if (ret < 0) {
         return -errno;
@@ -207,6 +454,13 @@ int mungefs_chown(
         return ret;
     }
 
+    if (memfs_enabled()) {
+        return memfs_chown(path, owner, group);
+    }
+
+    snapshot_guard guard(snapshot_mutex());
+    note_snapshot_change(path, 0);
+
     ret = chown(path, owner, group);
     if (ret < 0) {
         return -errno;
@@ -223,11 +477,21 @@ int mungefs_truncate(
         return ret;
     }
 
+    if (memfs_enabled()) {
+        return memfs_truncate(path, length);
+    }
+
+    snapshot_guard guard(snapshot_mutex());
+    note_snapshot_change(path, SNAPSHOT_CONTENT);
+
     ret = truncate(path, length); 
     if (ret < 0) {
         return -errno;
     }
 
+    integrity_truncated(path, length);
+    invalidate_cached_data(path);
+
     return 0;
 }
 
@@ -239,13 +503,31 @@ int mungefs_open(
         return ret;
     }
 
-    ret = open(path, fi->flags);
+    fi->flags = writeback_cache_flags(fi->flags);
+    if (memfs_enabled()) {
+        return open_memfs_handle(path, fi->flags, 0, fi);
+    }
+
+    // held until the handle records the epoch of the file it opened
+    snapshot_guard guard(snapshot_mutex());
+    if ((fi->flags & O_ACCMODE) != O_RDONLY || (fi->flags & O_TRUNC)) {
+        note_snapshot_change(path, SNAPSHOT_CONTENT);
+    }
+
+    ret = open_backing_file(path, fi->flags, 0);
     if (ret < 0) {
-        return -errno;
+        return ret;
     }
 
-    fi->fh = ret;
-    return 0;
+    ret = open_file_handle(ret, fi);
+    if (!ret && (fi->flags & O_TRUNC)) {
+        auto handle = get_file_handle(fi);
+        integrity_guard guard(handle->crc);
+        integrity_truncated(*handle, 0);
+        prefetch_invalidate(handle->dev, handle->ino, 0, 0);
+    }
+
+    return ret;
 }
 
 int mungefs_read(
@@ -254,18 +536,49 @@ int mungefs_read(
     size_t                 size,
     off_t                  offset,
     struct fuse_file_info* fi) {
+    static const std::string operation("read");
+    auto handle = get_file_handle(fi);
     bool corrupt_flag = false;
-    int ret = evaluate_fault_for_operation(
+    queue_slot slot;
+    int ret = evaluate_cached_fault(
+                  handle->read_fault,
                   path,
-                  "read",
-                  corrupt_flag);
+                  operation,
+                  corrupt_flag,
+                  slot);
+    if (ret) {
+        return ret;
+    }
+
+    ret = check_snapshot_epoch(path, *handle, false);
     if (ret) {
         return ret;
     }
 
-    ret = pread(fi->fh, buf, size, offset);
-    if (ret == -1) {
-        ret = -errno;
+    // what any handle on the file has buffered reads back as written
+    flush_write_buffers(handle->dev, handle->ino);
+
+    // direct handles are kept out of the prefetch cache, the point of
+    // them is to see the device on every read
+    if (handle->mem) {
+        ret = memfs_pread(handle->mem, buf, size, offset);
+    }
+    else if (handle->direct) {
+        ret = direct_pread(*handle, buf, size, offset);
+    }
+    else {
+        prefetch_note_read(*handle, size, offset);
+        ret = prefetch_serve(*handle, buf, size, offset);
+        if (ret < 0) {
+            ret = backing_pread(handle->fd, buf, size, offset);
+        }
+    }
+
+    if (ret > 0) {
+        int err = integrity_verify(*handle, buf, ret, size, offset, path);
+        if (err) {
+            return err;
+        }
     }
 
     if(corrupt_flag) {
@@ -282,26 +595,51 @@ int mungefs_write(
     off_t                  offset,
     struct fuse_file_info* fi) {
 
+    static const std::string operation("write");
+    auto handle = get_file_handle(fi);
     bool corrupt_flag = false;
-    int ret = evaluate_fault_for_operation(
+    queue_slot slot;
+    int ret = evaluate_cached_fault(
+                  handle->write_fault,
                   path,
-                  "write",
-                  corrupt_flag);
+                  operation,
+                  corrupt_flag,
+                  slot);
     if(ret) {
         return ret;
     }
 
+    snapshot_guard snapshot(snapshot_mutex());
+    ret = check_snapshot_epoch(path, *handle, true);
+    if (ret) {
+        return ret;
+    }
+
+    // faults apply to the write as the application issued it, buffering
+    // only changes when the (possibly corrupted) bytes reach the backing file
+    integrity_guard guard(handle->crc);
     if(corrupt_flag) {
         char bad_buf[size];
         memset(bad_buf, 'x', size);
-        ret = pwrite(fi->fh, bad_buf, size, offset);
+        ret = handle->mem ?
+              memfs_pwrite(handle->mem, bad_buf, size, offset, fi->flags & O_APPEND) :
+              coalesce_write(*handle, bad_buf, size, offset);
+        if (ret > 0) {
+            integrity_update(*handle, bad_buf, ret, offset);
+        }
+    }
+    else if (handle->mem) {
+        ret = memfs_pwrite(handle->mem, buf, size, offset, fi->flags & O_APPEND);
     }
     else {
-        ret = pwrite(fi->fh, buf, size, offset);
+        ret = coalesce_write(*handle, buf, size, offset);
+        if (ret > 0) {
+            integrity_update(*handle, buf, ret, offset);
+        }
     }
 
-    if(-1 == ret) {
-        ret = -errno;
+    if (ret > 0) {
+        handle->dirty_bytes.fetch_add(ret, std::memory_order_relaxed);
     }
 
     return ret;
@@ -317,6 +655,10 @@ int mungefs_statfs(
         return ret;
     }
 
+    if (memfs_enabled()) {
+        return memfs_statfs(buf);
+    }
+
     ret = statvfs(path, buf);
     if(ret < 0) {
         return -errno;
@@ -333,8 +675,19 @@ int mungefs_flush(
         return ret;
     }
 
+    auto handle = get_file_handle(fi);
+    ret = check_snapshot_epoch(path, *handle, false);
+    if (ret) {
+        return ret;
+    }
+
+    ret = flush_write_buffer(*handle);
+    if (ret || handle->mem) {
+        return ret;
+    }
+
     /* Took from fuse examples */
-    ret = close(dup(fi->fh));
+    ret = close(dup(handle->fd));
     if (ret < 0) {
         return -errno;
     }
@@ -350,7 +703,11 @@ int mungefs_release(
         return ret;
     }
 
-    close(fi->fh);
+    ret = close_file_handle(fi);
+    if (ret) {
+        MUNGEFS_LOG(log_level::error, "buffered writes lost on release of %s [%s]",
+                    path, strerror(-ret));
+    }
 
     return 0;    
 }
@@ -359,23 +716,32 @@ int mungefs_fsync(
     const char *path,
     int datasync,
     struct fuse_file_info *fi) {
-    int ret = evaluate_fault_for_operation(path, "fsync");
+    queue_slot slot;
+    int ret = evaluate_fault_for_operation(path, "fsync", &slot);
     if (ret) {
         return ret;
     }
 
-    if (datasync) {
-        ret = fdatasync(fi->fh);
-        if (ret < 0) {
-            return -errno;
+    auto handle = get_file_handle(fi);
+    if (fsync_is_noop()) {
+        handle->dirty_bytes.store(0, std::memory_order_relaxed);
+        return handle->mem ? 0 : flush_write_buffer(*handle);
+    }
+
+    // memory is as durable as memfs gets, only the modeled latency is left
+    if (!handle->mem) {
+        ret = check_snapshot_epoch(path, *handle, false);
+        if (ret) {
+            return ret;
         }
-    } else {
-        ret = fsync(fi->fh);
-        if (ret < 0) {
-            return -errno;
+
+        ret = flush_write_buffer_and_sync(*handle, datasync);
+        if (ret) {
+            return ret;
         }
     }
 
+    charge_fsync(handle->dirty_bytes.exchange(0, std::memory_order_relaxed));
     return 0;
 }
 
@@ -390,6 +756,13 @@ int mungefs_setxattr(
         return ret;
     }
 
+    if (memfs_enabled()) {
+        return memfs_setxattr(path, name, value, size, flags);
+    }
+
+    snapshot_guard guard(snapshot_mutex());
+    note_snapshot_change(path, 0);
+
     ret = setxattr(path, name, value, size, flags);
     if (ret < 0) {
         return -errno;
@@ -408,6 +781,10 @@ int mungefs_getxattr(
         return ret;
     }
 
+    if (memfs_enabled()) {
+        return memfs_getxattr(path, name, value, size);
+    }
+
     ret = getxattr(path, name, value, size);
     if (ret < 0) {
         return -errno;
@@ -425,6 +802,10 @@ int mungefs_listxattr(
         return ret;
     }
 
+    if (memfs_enabled()) {
+        return memfs_listxattr(path, list, size);
+    }
+
     ret = listxattr(path, list, size);
     if (ret < 0) {
         return -errno;
@@ -442,6 +823,13 @@ int mungefs_removexattr(
     }
 
 
+    if (memfs_enabled()) {
+        return memfs_removexattr(path, name);
+    }
+
+    snapshot_guard guard(snapshot_mutex());
+    note_snapshot_change(path, 0);
+
     ret = removexattr(path, name);
     if (ret < 0) {
         return -errno;
@@ -458,28 +846,80 @@ int mungefs_opendir(
         return ret;
     }
 
+    if (memfs_enabled()) {
+        memfs_inode_ptr inode;
+        ret = memfs_opendir(path, inode);
+        if (ret) {
+            return ret;
+        }
+
+        auto handle = static_handle_pool.create(inode);
+        if (!handle) {
+            return -ENFILE;
+        }
+
+        fi->fh = reinterpret_cast<uint64_t>(handle);
+        return 0;
+    }
+
+    snapshot_guard guard(snapshot_mutex());
     auto dir = opendir(path);
 
     if (!dir) {
         return -errno;
     }
     
-    fi->fh = (int64_t) dir;
+    auto handle = static_handle_pool.create(dir);
+    if (!handle) {
+        closedir(dir);
+        return -ENFILE;
+    }
+
+    fi->fh = reinterpret_cast<uint64_t>(handle);
     return 0;    
 }
 
+#if FUSE_MAJOR_VERSION >= 3
+int mungefs_readdir(
+    const char *path,
+    void *buf,
+    fuse_fill_dir_t filler,
+    off_t offset,
+    struct fuse_file_info *fi,
+    enum fuse_readdir_flags flags) {
+#else
 int mungefs_readdir(
     const char *path,
     void *buf,
     fuse_fill_dir_t filler,
     off_t offset,
     struct fuse_file_info *fi) {
+#endif
     int ret = evaluate_fault_for_operation(path, "readdir");
     if (ret) {
         return ret;
     }
 
-    DIR *dp = (DIR *) fi->fh;
+    auto handle = get_file_handle(fi);
+    ret = check_snapshot_epoch(path, *handle, false);
+    if (ret) {
+        return ret;
+    }
+
+    if (handle->mem) {
+        return memfs_readdir(handle->mem, [&](const char* _name, const struct stat& _st) {
+#if FUSE_MAJOR_VERSION >= 3
+            auto fill_flags = (flags & FUSE_READDIR_PLUS) ?
+                              FUSE_FILL_DIR_PLUS :
+                              static_cast<enum fuse_fill_dir_flags>(0);
+            return 0 != filler(buf, _name, &_st, 0, fill_flags);
+#else
+            return 0 != filler(buf, _name, &_st, 0);
+#endif
+        });
+    }
+
+    DIR *dp = handle->dir;
     struct dirent *de;
 
     while ((de = readdir(dp)) != NULL) {
@@ -487,8 +927,21 @@ int mungefs_readdir(
         memset(&st, 0, sizeof(st));
         st.st_ino = de->d_ino;
         st.st_mode = de->d_type << 12;
+#if FUSE_MAJOR_VERSION >= 3
+        // readdirplus hands the attributes to the kernel with the names,
+        // saving a getattr round trip per entry
+        auto fill_flags = static_cast<enum fuse_fill_dir_flags>(0);
+        if ((flags & FUSE_READDIR_PLUS) &&
+            0 == fstatat(dirfd(dp), de->d_name, &st, AT_SYMLINK_NOFOLLOW)) {
+            fill_flags = FUSE_FILL_DIR_PLUS;
+        }
+
+        if (filler(buf, de->d_name, &st, 0, fill_flags))
+            break;
+#else
         if (filler(buf, de->d_name, &st, 0))
             break;
+#endif
     }
     
     return 0;    
@@ -503,9 +956,10 @@ int mungefs_releasedir(
         return ret;
     }
 
-    DIR *dir = (DIR *) fi->fh;
-
-    ret = closedir(dir);
+    auto handle = get_file_handle(fi);
+    ret = handle->dir ? closedir(handle->dir) : 0;
+    static_handle_pool.destroy(handle);
+    fi->fh = 0;
     if (ret < 0) {
         return -errno;
     }
@@ -521,37 +975,172 @@ int mungefs_fsyncdir(
         return ret;
     }
 
-    auto dir = opendir(path);
-    if (!dir) {
-        return -errno;
+    if (fsync_is_noop()) {
+        return 0;
     }
 
-    if (datasync) {
-        ret = fdatasync(dirfd(dir));
-        if (ret < 0) {
-            return -errno;
-        }
-    } else {
-        ret = fsync(dirfd(dir));
+    // the directory opened by opendir, memfs has nothing to sync
+    auto handle = get_file_handle(fi);
+    if (handle->dir) {
+        ret = datasync ? fdatasync(dirfd(handle->dir)) : fsync(dirfd(handle->dir));
         if (ret < 0) {
             return -errno;
         }
     }
 
-    closedir(dir);
-
+    charge_fsync(0);
     return 0;
 }
 
+// request a capability if the kernel offers it, noting the outcome
+static void want_capability(
+    struct fuse_conn_info* _conn,
+    unsigned               _cap,
+    bool                   _requested,
+    const char*            _name,
+    std::ostream&          _report) {
+    if (!_requested) {
+        _conn->want &= ~_cap;
+        _report << " " << _name << "=disabled";
+        return;
+    }
+
+    if (_conn->capable & _cap) {
+        _conn->want |= _cap;
+        _report << " " << _name << "=granted";
+    }
+    else {
+        _report << " " << _name << "=unavailable";
+    }
+}
+
+static void negotiate_connection(struct fuse_conn_info* _conn) {
+    const auto& opts = get_mungefs_options();
+    std::stringstream report;
+
+    // libfuse calls init with max_write at UINT_MAX and only clamps it to
+    // its receive buffer once init returns, so all we can do is ask for
+    // less, and the size it settles on is not known yet. max_readahead
+    // already holds what the kernel offered, which we may only lower.
+    if (opts.max_write) {
+        _conn->max_write = std::min(_conn->max_write, opts.max_write);
+    }
+
+    if (opts.max_readahead) {
+        _conn->max_readahead = std::min(_conn->max_readahead, opts.max_readahead);
+    }
+
+    report << "fuse protocol " << _conn->proto_major << "." << _conn->proto_minor;
+    if (opts.max_write) {
+        report << " max_write<=" << _conn->max_write;
+    }
+
+    report << " max_readahead=" << _conn->max_readahead
+           << " capabilities:";
+
+#ifdef FUSE_CAP_BIG_WRITES
+    want_capability(_conn, FUSE_CAP_BIG_WRITES, !opts.no_big_writes, "big_writes", report);
+#endif
+    want_capability(_conn, FUSE_CAP_ASYNC_READ, !opts.no_async_read, "async_read", report);
+#if FUSE_MAJOR_VERSION < 3
+    if (opts.no_async_read) {
+        _conn->async_read = 0;
+    }
+#endif
+
+    want_capability(_conn, FUSE_CAP_SPLICE_READ,  !opts.no_splice, "splice_read",  report);
+    want_capability(_conn, FUSE_CAP_SPLICE_WRITE, !opts.no_splice, "splice_write", report);
+    want_capability(_conn, FUSE_CAP_SPLICE_MOVE,  !opts.no_splice, "splice_move",  report);
+
+#ifdef FUSE_CAP_WRITEBACK_CACHE
+    want_capability(_conn, FUSE_CAP_WRITEBACK_CACHE, opts.writeback_cache, "writeback_cache", report);
+    static_writeback_cache = (_conn->want & FUSE_CAP_WRITEBACK_CACHE) != 0;
+#else
+    report << " writeback_cache=unsupported_by_libfuse";
+#endif
+
+#if FUSE_MAJOR_VERSION >= 3
+    want_capability(_conn, FUSE_CAP_READDIRPLUS,     true, "readdirplus",     report);
+    want_capability(_conn, FUSE_CAP_PARALLEL_DIROPS, true, "parallel_dirops", report);
+    want_capability(_conn, FUSE_CAP_ASYNC_DIO,       true, "async_dio",       report);
+#endif
+
+    log_message(report.str());
+} // negotiate_connection
+
+#if FUSE_MAJOR_VERSION >= 3
+void *mungefs_init(struct fuse_conn_info *conn, struct fuse_config *cfg) {
+#else
 void *mungefs_init(struct fuse_conn_info *conn) {
-    //err_log.open("/tmp/mungefs_operation_log.txt", std::fstream::in|std::fstream::out|std::fstream::app);
-    start_server_thread();
+#endif
+    const auto& opts = get_mungefs_options();
+    start_logger(opts.log ? opts.log : "/tmp/mungefs_log.txt");
+    if (fault_seeded()) {
+        MUNGEFS_LOG(log_level::info, "fault decisions seeded with %llu",
+                    static_cast<unsigned long long>(fault_seed()));
+    }
+
+    // only missing when no mountpoint was given, which fuse refuses anyway
+    const char* endpoint = opts.endpoint;
+    start_server_thread(endpoint ? endpoint : "tcp://*:9000");
+    negotiate_connection(conn);
+    if (opts.memfs) {
+        int err = start_memfs(opts.memfs_seed, opts.memfs_mb);
+        if (err) {
+            MUNGEFS_LOG(log_level::error, "memfs seed from %s incomplete [%s]",
+                        opts.memfs_seed, strerror(-err));
+        }
+
+        MUNGEFS_LOG(log_level::info, "serving from memory%s%s",
+                    opts.memfs_seed ? ", seeded from " : "",
+                    opts.memfs_seed ? opts.memfs_seed : "");
+    }
+
+    init_backing_io();
+    log_message(std::string("backing io: ") + backing_io_name());
+    start_prefetch();
+    start_write_coalescing();
+    start_fsync_model(fsync_model{
+        opts.fsync_base_us,
+        opts.fsync_us_per_mb,
+        opts.fsync_group_us,
+        opts.fsync_stall_pct,
+        opts.fsync_stall_ms,
+        0 != opts.fsync_noop});
+    if (opts.fsync_noop) {
+        MUNGEFS_LOG(log_level::info, "fsync and fsyncdir sync nothing");
+    }
+
+    if (opts.crc) {
+        int err = start_integrity(opts.crc, opts.crc_block_kb, opts.crc_log);
+        if (err) {
+            MUNGEFS_LOG(log_level::error, "no checksums kept, cannot use %s [%s]",
+                        opts.crc, strerror(-err));
+        }
+        else {
+            MUNGEFS_LOG(log_level::info, "keeping crc32c of every %u KiB in %s, computed with %s",
+                        opts.crc_block_kb, opts.crc, crc32c_kernel_name());
+        }
+    }
+
+    if (opts.powerloss) {
+        start_powerloss(opts.powerloss_mb);
+        MUNGEFS_LOG(log_level::info, "tracking unsynced writes for power cuts in %u MiB",
+                    opts.powerloss_mb);
+    }
+    if (opts.scenario) {
+        start_scenario_file(opts.scenario);
+    }
+
     return NULL;
 }
 
 void mungefs_destroy(void *) {
-    //err_log.close();
+    stop_scenario();
+    stop_write_coalescing();
+    stop_prefetch();
     stop_server_thread();
+    stop_logger();
 }
 
 int mungefs_access(
@@ -562,6 +1151,10 @@ int mungefs_access(
         return ret;
     }
 
+    if (memfs_enabled()) {
+        return memfs_access(path, mode);
+    }
+
     ret = access(path, mode); 
     if (ret < 0) {
         return -errno;
@@ -579,14 +1172,30 @@ int mungefs_create(
         return ret;
     }
 
-    ret = creat(path, mode);
+    fi->flags = writeback_cache_flags(fi->flags);
+    const int flags = writeback_cache_flags(O_CREAT | O_WRONLY | O_TRUNC);
+    if (memfs_enabled()) {
+        return open_memfs_handle(path, flags, mode, fi);
+    }
+
+    snapshot_guard guard(snapshot_mutex());
+    note_snapshot_change(path, SNAPSHOT_CONTENT);
+
+    ret = open_backing_file(path, flags, mode);
     if (ret < 0) {
-        return -errno;
+        return ret;
     }
 
-    fi->fh = ret;
+    // an existing file was emptied, and a new one may reuse an inode
+    ret = open_file_handle(ret, fi);
+    if (!ret) {
+        auto handle = get_file_handle(fi);
+        integrity_guard guard(handle->crc);
+        integrity_truncated(*handle, 0);
+        prefetch_invalidate(handle->dev, handle->ino, 0, 0);
+    }
 
-    return 0;    
+    return ret;
 }
 
 int mungefs_ftruncate(
@@ -598,11 +1207,37 @@ int mungefs_ftruncate(
         return ret;
     }
 
-    ret = truncate(path, length);
+    // buffered writes must land before the size changes under them
+    auto handle = get_file_handle(fi);
+    snapshot_guard snapshot(snapshot_mutex());
+    ret = check_snapshot_epoch(path, *handle, true);
+    if (!ret) {
+        ret = flush_write_buffer(*handle);
+    }
+
+    if (ret) {
+        return ret;
+    }
+
+    if (handle->mem) {
+        return memfs_ftruncate(handle->mem, length);
+    }
+
+    power_cycle_guard power(power_cycle_mutex());
+    ret = check_power_cycle(*handle);
+    if (ret) {
+        return ret;
+    }
+
+    integrity_guard guard(handle->crc);
+    ret = ftruncate(handle->fd, length);
     if (ret < 0) {
         return -errno;
     }
-    
+
+    integrity_truncated(*handle, length);
+
+    prefetch_invalidate(handle->dev, handle->ino, 0, 0);
     return 0;    
 }
 
@@ -620,9 +1255,21 @@ int mungefs_fgetattr(
         return ret;
     }
 
-    ret = fstat((int) fi->fh, buf);
-    if (ret < 0) {
-        return -errno;
+    auto handle = get_file_handle(fi);
+    ret = check_snapshot_epoch(path, *handle, false);
+    if (ret) {
+        return ret;
+    }
+
+    ret = flush_write_buffer(*handle);
+    if (ret) {
+        return ret;
+    }
+
+    ret = handle->mem ? memfs_fstat(handle->mem, buf) :
+          fstat(handle->fd, buf) < 0 ? -errno : 0;
+    if (ret) {
+        return ret;
     }
 
     if(corrupt_flag) {
@@ -642,7 +1289,7 @@ int mungefs_lock(
         return ret;
     }
 
-    std::cout << "mungefs_lock: unimplemented." << std::endl;
+    MUNGEFS_LOG(log_level::debug, "mungefs_lock: unimplemented.");
     
     return 0;    
 }
@@ -655,7 +1302,11 @@ int mungefs_utimens(
         return ret;
     }
     
-    std::cout << "mungefs_utimens: unimplemented." << std::endl;
+    if (memfs_enabled()) {
+        return memfs_utimens(path, tv);
+    }
+
+    MUNGEFS_LOG(log_level::debug, "mungefs_utimens: unimplemented.");
 
     return 0;    
 }
@@ -669,7 +1320,7 @@ int mungefs_bmap(
         return ret;
     }
 
-    std::cout << "mungefs_bmap: unimplemented." << std::endl;
+    MUNGEFS_LOG(log_level::debug, "mungefs_bmap: unimplemented.");
     
     return 0;    
 }
@@ -686,7 +1337,18 @@ int mungefs_ioctl(
         return ret;
     }
 
-    ret = ioctl(fi->fh, cmd, arg);
+    auto handle = get_file_handle(fi);
+    if (handle->mem) {
+        return -ENOTTY;
+    }
+
+    snapshot_guard snapshot(snapshot_mutex());
+    ret = check_snapshot_epoch(path, *handle, true);
+    if (ret) {
+        return ret;
+    }
+
+    ret = ioctl(handle->fd, cmd, arg);
     if (ret < 0) {
         return -errno;
     }
@@ -704,7 +1366,7 @@ int mungefs_poll(
         return ret;
     }
 
-    std::cout << "mungefs_poll: unimplemented." << std::endl;
+    MUNGEFS_LOG(log_level::debug, "mungefs_poll: unimplemented.");
     
     return 0;    
 }
@@ -715,7 +1377,18 @@ int mungefs_flock(const char *path, struct fuse_file_info *fi, int op) {
         return ret;
     }
 
-    ret = flock(((int) fi->fh), op);
+    // accepted without locking, as lock is
+    auto handle = get_file_handle(fi);
+    if (handle->mem) {
+        return 0;
+    }
+
+    ret = check_snapshot_epoch(path, *handle, false);
+    if (ret) {
+        return ret;
+    }
+
+    ret = flock(handle->fd, op);
     if (ret < 0) {
         return -errno;
     }
@@ -729,16 +1402,271 @@ int mungefs_fallocate(
     off_t offset,
     off_t len,
     struct fuse_file_info *fi) {
-    int ret = evaluate_fault_for_operation(path, "fallocate");
+    queue_slot slot;
+    int ret = evaluate_fault_for_operation(path, "fallocate", &slot);
+    if (ret) {
+        return ret;
+    }
+
+    auto handle = get_file_handle(fi);
+    snapshot_guard snapshot(snapshot_mutex());
+    ret = check_snapshot_epoch(path, *handle, true);
+    if (!ret) {
+        ret = flush_write_buffer(*handle);
+    }
+
     if (ret) {
         return ret;
     }
 
-    ret = fallocate((int) fi->fh, mode, offset, len);
+    if (handle->mem) {
+        return memfs_fallocate(handle->mem, mode, offset, len);
+    }
+
+    power_cycle_guard power(power_cycle_mutex());
+    ret = check_power_cycle(*handle);
+    if (ret) {
+        return ret;
+    }
+
+    integrity_guard guard(handle->crc);
+    ret = fallocate(handle->fd, mode, offset, len);
     if (ret < 0) {
         return -errno;
     }
+
+    // collapsing or inserting a range moves everything after it
+    integrity_refresh(*handle, offset,
+                      (mode & (FALLOC_FL_COLLAPSE_RANGE | FALLOC_FL_INSERT_RANGE)) ? 0 : len);
+
+    prefetch_invalidate(handle->dev, handle->ino, offset, len);
+    note_written(handle->unsynced, offset, len, false);
     
     return 0;    
 }
 
+#if FUSE_MAJOR_VERSION >= 3
+int mungefs_getattr(
+    const char *path,
+    struct stat *buf,
+    struct fuse_file_info *fi) {
+    if (fi) {
+        return mungefs_fgetattr(path, buf, fi);
+    }
+
+    return mungefs_getattr(path, buf);
+}
+
+int mungefs_rename(
+    const char *oldpath,
+    const char *newpath,
+    unsigned int flags) {
+    if (!flags) {
+        return mungefs_rename(oldpath, newpath);
+    }
+
+    int ret = evaluate_fault_for_operation(oldpath, "rename");
+    if (ret) {
+        return ret;
+    }
+
+    ret = evaluate_fault_for_operation(newpath, "rename");
+    if (ret) {
+        return ret;
+    }
+
+    snapshot_guard guard(snapshot_mutex());
+    if (!memfs_enabled()) {
+        note_snapshot_change(oldpath, SNAPSHOT_CONTENT | SNAPSHOT_SUBTREE);
+        note_snapshot_change(newpath, SNAPSHOT_CONTENT | SNAPSHOT_SUBTREE);
+    }
+
+    // an exchange keeps both files
+    if (!(flags & RENAME_EXCHANGE)) {
+        invalidate_cached_data(newpath);
+    }
+
+    const integrity_name replaced = (flags & RENAME_EXCHANGE) ?
+                                    integrity_name{false, 0, 0} :
+                                    integrity_name_going(newpath);
+    ret = memfs_enabled() ? memfs_rename(oldpath, newpath, flags) :
+          renameat2(AT_FDCWD, oldpath, AT_FDCWD, newpath, flags) < 0 ? -errno : 0;
+    if (ret) {
+        return ret;
+    }
+
+    integrity_name_gone(replaced);
+
+    invalidate_resolved_faults();
+    return 0;
+}
+
+int mungefs_chmod(
+    const char *path,
+    mode_t mode,
+    struct fuse_file_info *) {
+    return mungefs_chmod(path, mode);
+}
+
+int mungefs_chown(
+    const char *path,
+    uid_t owner,
+    gid_t group,
+    struct fuse_file_info *) {
+    return mungefs_chown(path, owner, group);
+}
+
+int mungefs_truncate(
+    const char *path,
+    off_t length,
+    struct fuse_file_info *fi) {
+    if (fi) {
+        return mungefs_ftruncate(path, length, fi);
+    }
+
+    return mungefs_truncate(path, length);
+}
+
+int mungefs_utimens(
+    const char *path,
+    const struct timespec tv[2],
+    struct fuse_file_info *) {
+    return mungefs_utimens(path, tv);
+}
+
+ssize_t mungefs_copy_file_range(
+    const char *path_in,
+    struct fuse_file_info *fi_in,
+    off_t offset_in,
+    const char *path_out,
+    struct fuse_file_info *fi_out,
+    off_t offset_out,
+    size_t size,
+    int flags) {
+    queue_slot slot;
+    int ret = evaluate_fault_for_operation(path_in, "copy_file_range", &slot);
+    if (ret) {
+        return ret;
+    }
+
+    bool corrupt_flag = false;
+    ret = evaluate_fault_for_operation(
+              path_out,
+              "copy_file_range",
+              corrupt_flag,
+              &slot);
+    if (ret) {
+        return ret;
+    }
+
+    auto in  = get_file_handle(fi_in);
+    auto out = get_file_handle(fi_out);
+    snapshot_guard snapshot(snapshot_mutex());
+    ret = check_snapshot_epoch(path_in, *in, false);
+    if (!ret) {
+        ret = check_snapshot_epoch(path_out, *out, true);
+    }
+
+    if (ret) {
+        return ret;
+    }
+
+    ret = flush_write_buffer(*in);
+    if (!ret) {
+        ret = flush_write_buffer(*out);
+    }
+
+    if (ret) {
+        return ret;
+    }
+
+    if (in->mem && out->mem) {
+        ssize_t copied = memfs_copy_file_range(in->mem, offset_in, out->mem, offset_out, size);
+        if (corrupt_flag && copied > 0) {
+            std::vector<char> bad_buf(copied, 'x');
+            memfs_pwrite(out->mem, bad_buf.data(), copied, offset_out, false);
+        }
+
+        if (copied > 0) {
+            out->dirty_bytes.fetch_add(copied, std::memory_order_relaxed);
+        }
+
+        return copied;
+    }
+
+    power_cycle_guard power(power_cycle_mutex());
+    ret = check_power_cycle(*out);
+    if (ret) {
+        return ret;
+    }
+
+    const off_t out_start = offset_out;
+    integrity_guard guard(out->crc);
+    ssize_t copied = copy_file_range(
+                         in->fd,
+                         &offset_in,
+                         out->fd,
+                         &offset_out,
+                         size,
+                         flags);
+    if (copied < 0) {
+        return -errno;
+    }
+
+    prefetch_invalidate(out->dev, out->ino, out_start, size);
+    note_written(out->unsynced, out_start, copied, out->sync_writes);
+    out->dirty_bytes.fetch_add(copied, std::memory_order_relaxed);
+
+    // the kernel copied the real data, overwrite the destination range
+    // just as a corrupted write would have
+    if (corrupt_flag && copied > 0) {
+        char bad_buf[64 * 1024];
+        memset(bad_buf, 'x', sizeof(bad_buf));
+        for (ssize_t done = 0; done < copied;) {
+            size_t chunk = std::min<size_t>(sizeof(bad_buf), copied - done);
+            ssize_t wr = write_through(*out, bad_buf, chunk, out_start + done);
+            if (wr <= 0) {
+                return wr < 0 ? wr : -EIO;
+            }
+
+            done += wr;
+        }
+    }
+
+    integrity_refresh(*out, out_start, copied);
+    return copied;
+}
+
+off_t mungefs_lseek(
+    const char *path,
+    off_t off,
+    int whence,
+    struct fuse_file_info *fi) {
+    int ret = evaluate_fault_for_operation(path, "lseek");
+    if (ret) {
+        return ret;
+    }
+
+    auto handle = get_file_handle(fi);
+    ret = check_snapshot_epoch(path, *handle, false);
+    if (ret) {
+        return ret;
+    }
+
+    ret = flush_write_buffer(*handle);
+    if (ret) {
+        return ret;
+    }
+
+    if (handle->mem) {
+        return memfs_lseek(handle->mem, off, whence);
+    }
+
+    off_t res = lseek(handle->fd, off, whence);
+    if (res < 0) {
+        return -errno;
+    }
+
+    return res;
+}
+#endif
@@ -44,12 +44,22 @@ int mungefs_getxattr(const char *, const char *, char *, size_t);
 int mungefs_listxattr(const char *, char *, size_t);
 int mungefs_removexattr(const char *, const char *);
 int mungefs_opendir(const char *, struct fuse_file_info *);
+#if FUSE_MAJOR_VERSION >= 3
+int mungefs_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
+                    off_t offset, struct fuse_file_info *fi,
+                    enum fuse_readdir_flags flags);
+#else
 int mungefs_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
                     off_t offset, struct fuse_file_info *fi);
+#endif
 int mungefs_releasedir(const char *, struct fuse_file_info *);
 int mungefs_fsyncdir(const char *, int, struct fuse_file_info *);
 
+#if FUSE_MAJOR_VERSION >= 3
+void *mungefs_init(struct fuse_conn_info *conn, struct fuse_config *cfg);
+#else
 void *mungefs_init(struct fuse_conn_info *conn);
+#endif
 void mungefs_destroy(void *);
 
 int mungefs_access(const char *, int);
@@ -68,6 +78,22 @@ int mungefs_flock(const char *, struct fuse_file_info *, int op);
 int mungefs_fallocate(const char *, int, off_t, off_t,
                       struct fuse_file_info *);
 
+#if FUSE_MAJOR_VERSION >= 3
+// libfuse 3 folds the handle based variants into the path based ones and
+// adds a few arguments, these forward to the implementations above
+int mungefs_getattr(const char *, struct stat *, struct fuse_file_info *);
+int mungefs_rename(const char *, const char *, unsigned int);
+int mungefs_chmod(const char *, mode_t, struct fuse_file_info *);
+int mungefs_chown(const char *, uid_t, gid_t, struct fuse_file_info *);
+int mungefs_truncate(const char *, off_t, struct fuse_file_info *);
+int mungefs_utimens(const char *, const struct timespec tv[2],
+                    struct fuse_file_info *);
+ssize_t mungefs_copy_file_range(const char *, struct fuse_file_info *, off_t,
+                                const char *, struct fuse_file_info *, off_t,
+                                size_t, int);
+off_t mungefs_lseek(const char *, off_t, int, struct fuse_file_info *);
+#endif
+
 #endif // MUNGEFS_OPERATIONS_HPP
 
 
@@ -0,0 +1,250 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "mungefs_decision.hpp"
+#include "mungefs_endpoint.hpp"
+#include "mungefs_log.hpp"
+#include "mungefs_options.hpp"
+
+static mungefs_options static_options = {
+    .max_write          = 0,
+    .max_readahead      = 0,
+    .no_big_writes      = 0,
+    .no_async_read      = 0,
+    .no_splice          = 0,
+    .writeback_cache    = 0,
+    .io_uring           = 0,
+    .io_uring_depth     = 64,
+    .readahead_cache_mb = 0,
+    .readahead_max_kb   = 2048,
+    .write_buffer_kb    = 0,
+    .write_buffer_ms    = 100,
+    .direct_io          = 0,
+    .direct_io_align    = 4096,
+    .scenario           = NULL,
+    .endpoint           = NULL,
+    .log                = NULL,
+    .log_level          = NULL,
+    .seed               = NULL,
+    .memfs              = 0,
+    .memfs_seed         = NULL,
+    .memfs_mb           = 0,
+    .powerloss          = 0,
+    .powerloss_mb       = 64,
+    .crc                = NULL,
+    .crc_block_kb       = 4,
+    .crc_log            = 0,
+    .fsync_base_us      = 0,
+    .fsync_us_per_mb    = 0,
+    .fsync_group_us     = 0,
+    .fsync_stall_pct    = 0,
+    .fsync_stall_ms     = 100,
+    .fsync_noop         = 0,
+};
+
+#define MUNGEFS_OPT(t, p, v) { t, offsetof(struct mungefs_options, p), v }
+
+static const struct fuse_opt mungefs_opts[] = {
+    MUNGEFS_OPT("mungefs_max_write=%u",       max_write,          0),
+    MUNGEFS_OPT("mungefs_max_readahead=%u",   max_readahead,      0),
+    MUNGEFS_OPT("mungefs_no_big_writes",      no_big_writes,      1),
+    MUNGEFS_OPT("mungefs_no_async_read",      no_async_read,      1),
+    MUNGEFS_OPT("mungefs_no_splice",          no_splice,          1),
+    MUNGEFS_OPT("mungefs_writeback_cache",    writeback_cache,    1),
+    MUNGEFS_OPT("mungefs_io_uring",           io_uring,           1),
+    MUNGEFS_OPT("mungefs_io_uring_depth=%u",  io_uring_depth,     0),
+    MUNGEFS_OPT("mungefs_readahead_cache_mb=%u", readahead_cache_mb, 0),
+    MUNGEFS_OPT("mungefs_readahead_max_kb=%u",   readahead_max_kb,   0),
+    MUNGEFS_OPT("mungefs_write_buffer_kb=%u",    write_buffer_kb,    0),
+    MUNGEFS_OPT("mungefs_write_buffer_ms=%u",    write_buffer_ms,    0),
+    MUNGEFS_OPT("mungefs_direct_io",             direct_io,          1),
+    MUNGEFS_OPT("mungefs_direct_io_align=%u",    direct_io_align,    0),
+    MUNGEFS_OPT("mungefs_scenario=%s",           scenario,           0),
+    MUNGEFS_OPT("mungefs_endpoint=%s",           endpoint,           0),
+    MUNGEFS_OPT("mungefs_log=%s",                log,                0),
+    MUNGEFS_OPT("mungefs_log_level=%s",          log_level,          0),
+    MUNGEFS_OPT("mungefs_seed=%s",               seed,               0),
+    MUNGEFS_OPT("mungefs_memfs",                 memfs,              1),
+    MUNGEFS_OPT("mungefs_memfs_seed=%s",         memfs_seed,         0),
+    MUNGEFS_OPT("mungefs_memfs_mb=%u",           memfs_mb,           0),
+    MUNGEFS_OPT("mungefs_powerloss",             powerloss,          1),
+    MUNGEFS_OPT("mungefs_powerloss_mb=%u",       powerloss_mb,       0),
+    MUNGEFS_OPT("mungefs_crc=%s",                crc,                0),
+    MUNGEFS_OPT("mungefs_crc_block_kb=%u",       crc_block_kb,       0),
+    MUNGEFS_OPT("mungefs_crc_log",               crc_log,            1),
+    MUNGEFS_OPT("mungefs_fsync_base_us=%u",      fsync_base_us,      0),
+    MUNGEFS_OPT("mungefs_fsync_us_per_mb=%u",    fsync_us_per_mb,    0),
+    MUNGEFS_OPT("mungefs_fsync_group_us=%u",     fsync_group_us,     0),
+    MUNGEFS_OPT("mungefs_fsync_stall_pct=%u",    fsync_stall_pct,    0),
+    MUNGEFS_OPT("mungefs_fsync_stall_ms=%u",     fsync_stall_ms,     0),
+    MUNGEFS_OPT("mungefs_fsync_noop",            fsync_noop,         1),
+    FUSE_OPT_END
+};
+
+static std::string static_mountpoint;
+
+// fuse takes the first argument that is not an option as the mountpoint
+static int note_mountpoint(
+    void*             _data,
+    const char*       _arg,
+    int               _key,
+    struct fuse_args* _args) {
+    if(FUSE_OPT_KEY_NONOPT == _key && static_mountpoint.empty()) {
+        static_mountpoint = _arg;
+    }
+
+    // keep everything for fuse_main
+    return 1;
+} // note_mountpoint
+
+// made absolute against the current directory, which fuse_main leaves for
+// / once it daemonizes. unlike realpath the path need not exist yet.
+static void make_absolute(char*& _path) {
+    if('/' == _path[0]) {
+        return;
+    }
+
+    char* cwd = getcwd(NULL, 0);
+    if(cwd) {
+        std::string path = std::string(cwd) + "/" + _path;
+        free(cwd);
+        free(_path);
+        _path = strdup(path.c_str());
+    }
+} // make_absolute
+
+int parse_mungefs_options(struct fuse_args* _args) {
+    if(fuse_opt_parse(_args, &static_options, mungefs_opts, note_mountpoint) == -1) {
+        fprintf(stderr, "failed to parse mungefs options\n");
+        return -1;
+    }
+
+    if(static_options.log_level) {
+        log_level level;
+        if(!parse_log_level(static_options.log_level, level)) {
+            fprintf(stderr, "unknown mungefs_log_level [%s]\n", static_options.log_level);
+            return -1;
+        }
+
+        set_log_level(level);
+    }
+
+    if(static_options.seed) {
+        char* end = NULL;
+        errno = 0;
+        unsigned long long seed = strtoull(static_options.seed, &end, 0);
+        if(errno || end == static_options.seed || *end) {
+            fprintf(stderr, "invalid mungefs_seed [%s]\n", static_options.seed);
+            return -1;
+        }
+
+        set_fault_seed(seed);
+    }
+
+    // opened once here so a bad path is reported while stderr still shows
+    if(static_options.log) {
+        make_absolute(static_options.log);
+        int fd = open(static_options.log, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if(fd < 0) {
+            fprintf(stderr, "cannot open mungefs_log [%s] [%s]\n", static_options.log, strerror(errno));
+            return -1;
+        }
+
+        close(fd);
+    }
+
+    // resolved now like the endpoint
+    if(static_options.scenario) {
+        char* scenario = realpath(static_options.scenario, NULL);
+        if(!scenario) {
+            fprintf(stderr, "invalid mungefs_scenario [%s] [%s]\n", static_options.scenario, strerror(errno));
+            return -1;
+        }
+
+        free(static_options.scenario);
+        static_options.scenario = scenario;
+    }
+
+    // resolved now like the endpoint, and a seed implies memfs
+    if(static_options.memfs_seed) {
+        char* seed_dir = realpath(static_options.memfs_seed, NULL);
+        if(!seed_dir) {
+            fprintf(stderr, "invalid mungefs_memfs_seed [%s] [%s]\n", static_options.memfs_seed, strerror(errno));
+            return -1;
+        }
+
+        free(static_options.memfs_seed);
+        static_options.memfs_seed = seed_dir;
+        static_options.memfs = 1;
+    }
+
+    // memory never loses power
+    if(static_options.powerloss && static_options.memfs) {
+        fprintf(stderr, "mungefs_powerloss needs a backing directory, not mungefs_memfs\n");
+        return -1;
+    }
+
+    if(static_options.fsync_stall_pct > 100) {
+        fprintf(stderr, "mungefs_fsync_stall_pct must be at most 100\n");
+        return -1;
+    }
+
+    if(static_options.fsync_noop &&
+       (static_options.fsync_base_us || static_options.fsync_us_per_mb ||
+        static_options.fsync_group_us || static_options.fsync_stall_pct)) {
+        fprintf(stderr, "mungefs_fsync_noop cannot be combined with a modeled fsync latency\n");
+        return -1;
+    }
+
+    if(static_options.crc) {
+        const unsigned kb = static_options.crc_block_kb;
+        if(!kb || kb > 1024 || (kb & (kb - 1))) {
+            fprintf(stderr, "mungefs_crc_block_kb must be a power of two up to 1024\n");
+            return -1;
+        }
+
+        if(static_options.memfs) {
+            fprintf(stderr, "mungefs_crc needs a backing directory, not mungefs_memfs\n");
+            return -1;
+        }
+
+        // a power cut rewrites data behind the sums
+        if(static_options.powerloss) {
+            fprintf(stderr, "mungefs_crc cannot be combined with mungefs_powerloss\n");
+            return -1;
+        }
+
+        make_absolute(static_options.crc);
+    }
+
+    // resolved now, fuse_main changes directory once it daemonizes
+    if(!static_options.endpoint && !static_mountpoint.empty()) {
+        static_options.endpoint = strdup(default_endpoint(static_mountpoint).c_str());
+    }
+
+    return 0;
+} // parse_mungefs_options
+
+const mungefs_options& get_mungefs_options() {
+    return static_options;
+} // get_mungefs_options
+
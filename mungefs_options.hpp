@@ -0,0 +1,63 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_OPTIONS_HPP
+#define MUNGEFS_OPTIONS_HPP
+
+#include <fuse_opt.h>
+
+// mount options understood by mungefs itself, given as -o mungefs_<name>
+// alongside the regular fuse options
+struct mungefs_options {
+    unsigned max_write;           // upper bound on the size of a write request, 0 for none
+    unsigned max_readahead;       // upper bound on kernel readahead, 0 for none
+    int      no_big_writes;       // do not request FUSE_CAP_BIG_WRITES
+    int      no_async_read;       // do not request FUSE_CAP_ASYNC_READ
+    int      no_splice;           // do not request the splice capabilities
+    int      writeback_cache;     // request FUSE_CAP_WRITEBACK_CACHE
+    int      io_uring;            // submit backing io through per-thread io_urings
+    unsigned io_uring_depth;      // submission queue entries per ring
+    unsigned readahead_cache_mb;  // memory for prefetched reads, 0 disables
+    unsigned readahead_max_kb;    // largest window prefetched ahead of a reader
+    unsigned write_buffer_kb;     // per-handle write coalescing buffer, 0 disables
+    unsigned write_buffer_ms;     // flush buffered writes at least this often
+    int      direct_io;           // bypass the page cache on both sides of mungefs
+    unsigned direct_io_align;     // block size O_DIRECT transfers are aligned to
+    char*    scenario;            // scenario file started at mount time
+    char*    endpoint;            // control socket, derived from the mountpoint if unset
+    char*    log;                 // log file, /tmp/mungefs_log.txt if unset
+    char*    log_level;           // error, warning, info or debug
+    char*    seed;                // makes fault decisions reproducible, unset for random
+    int      memfs;               // serve the namespace from memory
+    char*    memfs_seed;          // directory copied into memory at mount time
+    unsigned memfs_mb;            // memory file data may take, 0 for the pool's limit
+    int      powerloss;           // track unsynced writes so a power cut can lose them
+    unsigned powerloss_mb;        // memory the unsynced ranges may take
+    char*    crc;                 // directory of the block checksums, unset to keep none
+    unsigned crc_block_kb;        // bytes each checksum covers
+    int      crc_log;             // log checksum mismatches instead of failing the read
+    unsigned fsync_base_us;       // modeled cost of every sync
+    unsigned fsync_us_per_mb;     // modeled cost of each MiB a sync covers
+    unsigned fsync_group_us;      // window gathering syncs into one commit, 0 for none
+    unsigned fsync_stall_pct;     // syncs stalling on top, in percent
+    unsigned fsync_stall_ms;      // how long a stalling sync stalls
+    int      fsync_noop;          // syncs succeed without syncing
+};
+
+// strip the mungefs options from _args, leaving the rest for fuse_main.
+// the mountpoint is left in place but noted to name the control socket.
+int parse_mungefs_options(struct fuse_args* _args);
+
+const mungefs_options& get_mungefs_options();
+
+#endif // MUNGEFS_OPTIONS_HPP
+
@@ -0,0 +1,154 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_POOL_HPP
+#define MUNGEFS_POOL_HPP
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <stdint.h>
+
+// fixed size objects carved out of slabs that are only released with the
+// pool. free slots form a lock-free stack, the head packs a change count
+// next to the slot index so a pop cannot be fooled by a slot that was
+// taken and returned in between (ABA). only growing takes a lock.
+template <typename T, uint32_t SlabSlots = 256, uint32_t MaxSlabs = 4096>
+class object_pool {
+public:
+    object_pool() : head_{0}, slab_count_{0} {
+        for (auto& s : slabs_) {
+            s.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    // objects still alive here are leaked, not destroyed
+    ~object_pool() {
+        for (auto& s : slabs_) {
+            delete[] s.load(std::memory_order_relaxed);
+        }
+    }
+
+    object_pool(const object_pool&) = delete;
+    object_pool& operator=(const object_pool&) = delete;
+
+    // returns nullptr once every slab is in use
+    template <typename... Args>
+    T* create(Args&&... _args) {
+        slot* s = pop();
+        while (!s) {
+            if (!grow()) {
+                return nullptr;
+            }
+
+            s = pop();
+        }
+
+        try {
+            return new (&s->storage) T(std::forward<Args>(_args)...);
+        }
+        catch (...) {
+            push(s);
+            throw;
+        }
+    }
+
+    void destroy(T* _obj) {
+        if (!_obj) {
+            return;
+        }
+
+        _obj->~T();
+        push(reinterpret_cast<slot*>(_obj));
+    }
+
+private:
+    // storage comes first so an object's address is its slot's address
+    struct slot {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+        std::atomic<uint32_t> next;   // index + 1 of the next free slot
+        uint32_t              index;
+    };
+
+    static const uint64_t index_mask = 0xffffffffULL;
+
+    slot* slot_at(uint32_t _index) const {
+        return slabs_[_index / SlabSlots].load(std::memory_order_acquire) + _index % SlabSlots;
+    }
+
+    // slots are never unmapped, so reading next of a slot another thread
+    // has just popped is harmless, the compare exchange then fails
+    slot* pop() {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        while (head & index_mask) {
+            slot* s = slot_at(static_cast<uint32_t>(head & index_mask) - 1);
+            uint64_t next = ((head >> 32) + 1) << 32 | s->next.load(std::memory_order_relaxed);
+            if (head_.compare_exchange_weak(head, next,
+                    std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return s;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // push the chain _first .. _last, already linked through next
+    void push(slot* _first, slot* _last) {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        uint64_t next;
+        do {
+            _last->next.store(static_cast<uint32_t>(head & index_mask), std::memory_order_relaxed);
+            next = ((head >> 32) + 1) << 32 | (_first->index + 1);
+        } while (!head_.compare_exchange_weak(head, next,
+                     std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    void push(slot* _s) {
+        push(_s, _s);
+    }
+
+    bool grow() {
+        std::lock_guard<std::mutex> lk(grow_mutex_);
+
+        // another thread may have grown the pool while we waited
+        if (head_.load(std::memory_order_acquire) & index_mask) {
+            return true;
+        }
+
+        uint32_t n = slab_count_.load(std::memory_order_relaxed);
+        if (n == MaxSlabs) {
+            return false;
+        }
+
+        slot* slab = new slot[SlabSlots];
+        for (uint32_t i = 0; i < SlabSlots; ++i) {
+            slab[i].index = n * SlabSlots + i;
+            slab[i].next.store(slab[i].index + 2, std::memory_order_relaxed);
+        }
+
+        slabs_[n].store(slab, std::memory_order_release);
+        slab_count_.store(n + 1, std::memory_order_release);
+        push(&slab[0], &slab[SlabSlots - 1]);
+        return true;
+    }
+
+    std::atomic<uint64_t> head_;
+    std::atomic<uint32_t> slab_count_;
+    std::atomic<slot*>    slabs_[MaxSlabs];
+    std::mutex            grow_mutex_;
+}; // class object_pool
+
+#endif // MUNGEFS_POOL_HPP
+
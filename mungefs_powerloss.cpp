@@ -0,0 +1,599 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mungefs_decision.hpp"
+#include "mungefs_log.hpp"
+#include "mungefs_powerloss.hpp"
+#include "mungefs_prefetch.hpp"
+
+std::atomic<uint64_t> power_cycle_counter(0);
+
+// start to end, disjoint and never touching
+typedef std::map<off_t, off_t> range_map;
+
+// what a map node and its allocation cost, to hold the ranges to the bound
+static const size_t range_node_bytes = 64;
+
+// widening starts at the page size, and tearing decides page by page
+static const unsigned first_wide_shift = 12;
+static const off_t    tear_page = 4096;
+
+// ranges set aside by a sync still in flight
+struct pending_sync {
+    uint64_t  token;
+    off_t     size;    // of the file when the sync started, -1 if unknown
+    range_map ranges;
+};
+
+struct unsynced_ranges {
+    int fd;     // reopened, so the file can be cut once it is closed
+    dev_t dev;
+    ino_t ino;
+
+    // guarded by the registry
+    unsigned handles;
+
+    std::mutex                mutex;
+    range_map                 ranges;
+    range_map::iterator       hint;         // the range last written
+    unsigned                  grain_shift;  // ranges are widened to 1 << this, 0 when exact
+    off_t                     synced_size;
+    uint64_t                  syncs;
+    std::vector<pending_sync> syncing;
+
+    unsynced_ranges(int _fd, dev_t _dev, ino_t _ino, off_t _size) :
+        fd{_fd},
+        dev{_dev},
+        ino{_ino},
+        handles{0},
+        hint{ranges.end()},
+        grain_shift{0},
+        synced_size{_size},
+        syncs{0} {
+    }
+
+    ~unsynced_ranges();
+};
+
+struct file_key {
+    dev_t dev;
+    ino_t ino;
+
+    bool operator==(const file_key& _rhs) const {
+        return ino == _rhs.ino && dev == _rhs.dev;
+    }
+};
+
+struct file_key_hash {
+    size_t operator()(const file_key& _k) const {
+        size_t h = std::hash<uint64_t>()(_k.ino);
+        h ^= std::hash<uint64_t>()(_k.dev) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        return h;
+    }
+};
+
+static bool                  static_enabled = false;
+static size_t                static_node_limit = 0;
+static std::atomic<size_t>   static_nodes(0);
+static std::atomic<uint64_t> static_widened(0);
+static uint64_t              static_tear_seed = 0;
+
+static std::shared_timed_mutex static_power_cycle_mutex;
+
+// the files tracked, and the outcome of the last cut
+static std::mutex static_registry_mutex;
+static std::unordered_map<file_key, unsynced_ranges_ptr, file_key_hash> static_registry;
+static powerloss_info static_last_cut = {};
+
+unsynced_ranges::~unsynced_ranges() {
+    size_t nodes = ranges.size();
+    for (const auto& p : syncing) {
+        nodes += p.ranges.size();
+    }
+
+    static_nodes.fetch_sub(nodes, std::memory_order_relaxed);
+    close(fd);
+} // unsynced_ranges::~unsynced_ranges
+
+std::shared_timed_mutex& power_cycle_mutex() {
+    return static_power_cycle_mutex;
+} // power_cycle_mutex
+
+bool powerloss_enabled() {
+    return static_enabled;
+} // powerloss_enabled
+
+void start_powerloss(unsigned _limit_mb) {
+    static_node_limit = std::max<size_t>(1, (static_cast<size_t>(_limit_mb) << 20) / range_node_bytes);
+    static_tear_seed = std::random_device()();
+    static_tear_seed = (static_tear_seed << 32) | std::random_device()();
+    static_enabled = true;
+} // start_powerloss
+
+// add [_start, _end) to _ranges, merging it with the ranges it touches.
+// returns the range now holding it and counts any node added or merged away.
+static range_map::iterator add_range(
+    range_map&          _ranges,
+    range_map::iterator _hint,
+    off_t               _start,
+    off_t               _end) {
+    // a sequential writer continues the range it wrote last
+    auto it = _hint;
+    if (it == _ranges.end() || _start < it->first || _start > it->second) {
+        it = _ranges.upper_bound(_start);
+        if (it != _ranges.begin() && std::prev(it)->second >= _start) {
+            --it;
+        }
+        else {
+            it = _ranges.emplace_hint(it, _start, _end);
+            static_nodes.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (_end > it->second) {
+        it->second = _end;
+    }
+
+    auto next = std::next(it);
+    while (next != _ranges.end() && next->first <= it->second) {
+        it->second = std::max(it->second, next->second);
+        next = _ranges.erase(next);
+        static_nodes.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    return it;
+} // add_range
+
+// widen the ranges of a file until there are at most half as many
+static void widen_locked(unsynced_ranges& _r) {
+    const size_t before = _r.ranges.size();
+    while (_r.ranges.size() > 1 && _r.ranges.size() > before / 2) {
+        _r.grain_shift = std::max(first_wide_shift, _r.grain_shift + 1);
+        const off_t grain = off_t(1) << _r.grain_shift;
+
+        range_map wide;
+        for (const auto& range : _r.ranges) {
+            const off_t start = range.first & ~(grain - 1);
+            const off_t end = (range.second + grain - 1) & ~(grain - 1);
+            if (!wide.empty() && wide.rbegin()->second >= start) {
+                wide.rbegin()->second = std::max(wide.rbegin()->second, end);
+            }
+            else {
+                wide.emplace_hint(wide.end(), start, end);
+            }
+        }
+
+        static_nodes.fetch_sub(_r.ranges.size() - wide.size(), std::memory_order_relaxed);
+        _r.ranges.swap(wide);
+    }
+
+    _r.hint = _r.ranges.end();
+    static_widened.fetch_add(1, std::memory_order_relaxed);
+} // widen_locked
+
+void note_unsynced_range(unsynced_ranges& _r, off_t _offset, size_t _size) {
+    off_t start = _offset;
+    off_t end = _offset + static_cast<off_t>(_size);
+
+    std::lock_guard<std::mutex> lk(_r.mutex);
+    if (_r.grain_shift) {
+        const off_t grain = off_t(1) << _r.grain_shift;
+        start &= ~(grain - 1);
+        end = (end + grain - 1) & ~(grain - 1);
+    }
+
+    _r.hint = add_range(_r.ranges, _r.hint, start, end);
+    if (static_nodes.load(std::memory_order_relaxed) > static_node_limit && _r.ranges.size() > 1) {
+        widen_locked(_r);
+    }
+} // note_unsynced_range
+
+void note_synced_range(unsynced_ranges& _r, off_t _offset, size_t _size) {
+    off_t start = _offset;
+    off_t end = _offset + static_cast<off_t>(_size);
+
+    std::lock_guard<std::mutex> lk(_r.mutex);
+    _r.hint = _r.ranges.end();
+
+    // a widened range only loses the grains the write covered entirely
+    if (_r.grain_shift) {
+        const off_t grain = off_t(1) << _r.grain_shift;
+        start = (start + grain - 1) & ~(grain - 1);
+        end &= ~(grain - 1);
+    }
+
+    if (start >= end) {
+        return;
+    }
+
+    auto it = _r.ranges.upper_bound(start);
+    if (it != _r.ranges.begin() && std::prev(it)->second > start) {
+        --it;
+    }
+
+    while (it != _r.ranges.end() && it->first < end) {
+        const off_t head = it->first;
+        const off_t tail = it->second;
+        it = _r.ranges.erase(it);
+        static_nodes.fetch_sub(1, std::memory_order_relaxed);
+
+        if (head < start) {
+            _r.ranges.emplace_hint(it, head, start);
+            static_nodes.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (tail > end) {
+            _r.ranges.emplace_hint(it, end, tail);
+            static_nodes.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+} // note_synced_range
+
+uint64_t start_sync(const unsynced_ranges_ptr& _ranges) {
+    if (!_ranges) {
+        return 0;
+    }
+
+    auto& r = *_ranges;
+    struct stat st;
+    const off_t size = fstat(r.fd, &st) == 0 ? st.st_size : -1;
+
+    std::lock_guard<std::mutex> lk(r.mutex);
+    pending_sync p;
+    p.token = ++r.syncs;
+    p.size = size;
+    p.ranges.swap(r.ranges);
+    r.hint = r.ranges.end();
+    r.syncing.push_back(std::move(p));
+    return r.syncs;
+} // start_sync
+
+void finish_sync(const unsynced_ranges_ptr& _ranges, uint64_t _token, bool _synced) {
+    if (!_ranges) {
+        return;
+    }
+
+    auto& r = *_ranges;
+    std::lock_guard<std::mutex> lk(r.mutex);
+    auto it = std::find_if(r.syncing.begin(), r.syncing.end(),
+                           [_token](const pending_sync& _p) { return _p.token == _token; });
+    if (it == r.syncing.end()) {
+        return;
+    }
+
+    // a failed sync leaves its ranges as unsynced as they were
+    if (!_synced) {
+        for (const auto& range : it->ranges) {
+            add_range(r.ranges, r.ranges.end(), range.first, range.second);
+        }
+
+        static_nodes.fetch_sub(it->ranges.size(), std::memory_order_relaxed);
+        r.syncing.erase(it);
+        r.hint = r.ranges.end();
+        return;
+    }
+
+    // and a sync that worked covers everything written before it started,
+    // including what earlier syncs still in flight set aside
+    if (it->size >= 0) {
+        r.synced_size = it->size;
+    }
+
+    auto done = std::remove_if(r.syncing.begin(), r.syncing.end(),
+                               [_token](const pending_sync& _p) {
+                                   if (_p.token > _token) {
+                                       return false;
+                                   }
+
+                                   static_nodes.fetch_sub(_p.ranges.size(), std::memory_order_relaxed);
+                                   return true;
+                               });
+    r.syncing.erase(done, r.syncing.end());
+} // finish_sync
+
+unsynced_ranges_ptr track_unsynced(int _fd, dev_t _dev, ino_t _ino) {
+    if (!static_enabled) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lk(static_registry_mutex);
+    auto& slot = static_registry[file_key{_dev, _ino}];
+    if (!slot) {
+        // a fresh open file description sheds O_APPEND and O_DIRECT, and
+        // a duplicate does when the file may not be opened again
+        char proc_path[64];
+        snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", _fd);
+        int fd = open(proc_path, O_WRONLY | O_CLOEXEC);
+        if (fd < 0) {
+            fd = fcntl(_fd, F_DUPFD_CLOEXEC, 0);
+        }
+
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            MUNGEFS_LOG(log_level::warning, "power loss not tracked for inode %llu [%s]",
+                        static_cast<unsigned long long>(_ino), strerror(errno));
+            if (fd >= 0) {
+                close(fd);
+            }
+
+            static_registry.erase(file_key{_dev, _ino});
+            return nullptr;
+        }
+
+        slot = std::make_shared<unsynced_ranges>(fd, _dev, _ino, st.st_size);
+    }
+
+    ++slot->handles;
+    return slot;
+} // track_unsynced
+
+void release_unsynced(unsynced_ranges_ptr& _ranges) {
+    if (!_ranges) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lk(static_registry_mutex);
+    auto& r = *_ranges;
+    if (0 == --r.handles) {
+        bool idle = false;
+        {
+            std::lock_guard<std::mutex> rlk(r.mutex);
+            idle = r.ranges.empty() && r.syncing.empty();
+        }
+
+        // nothing can be lost from a file that is gone
+        struct stat st;
+        if (!idle && fstat(r.fd, &st) == 0 && 0 == st.st_nlink) {
+            idle = true;
+        }
+
+        auto it = static_registry.find(file_key{r.dev, r.ino});
+        if (idle && it != static_registry.end() && it->second == _ranges) {
+            static_registry.erase(it);
+        }
+    }
+
+    _ranges.reset();
+} // release_unsynced
+
+// zero [_offset, _offset + _length), leaving a hole where the file system can
+static int zero_range(int _fd, off_t _offset, off_t _length) {
+    if (fallocate(_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, _offset, _length) == 0) {
+        return 0;
+    }
+
+    if (EOPNOTSUPP != errno) {
+        return -errno;
+    }
+
+    static const std::vector<char> zeros(64 * 1024, 0);
+    while (_length > 0) {
+        const size_t chunk = std::min<off_t>(zeros.size(), _length);
+        const ssize_t written = pwrite(_fd, zeros.data(), chunk, _offset);
+        if (written <= 0) {
+            return written < 0 ? -errno : -EIO;
+        }
+
+        _offset += written;
+        _length -= written;
+    }
+
+    return 0;
+} // zero_range
+
+// the draw of the tearing cut _cut for _index of the file, the same for
+// the same seed
+static uint64_t tear_draw(uint64_t _cut, ino_t _ino, uint64_t _index) {
+    const uint64_t seed = fault_seeded() ? fault_seed() : static_tear_seed;
+    const uint64_t ino = static_cast<uint64_t>(_ino);
+    auto draw = philox4x32(
+                    {{static_cast<uint32_t>(_index),
+                      static_cast<uint32_t>(_index >> 32),
+                      static_cast<uint32_t>(ino ^ (ino >> 32)),
+                      static_cast<uint32_t>(_cut)}},
+                    {{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)}});
+    return (static_cast<uint64_t>(draw[1]) << 32) | draw[0];
+} // tear_draw
+
+// lose what a file had not synced, holding its mutex
+static void cut_file_locked(
+    unsynced_ranges& _r,
+    power_cut_mode   _mode,
+    uint64_t         _cut,
+    powerloss_info&  _outcome) {
+    range_map lost;
+    for (const auto& range : _r.ranges) {
+        add_range(lost, lost.end(), range.first, range.second);
+    }
+
+    for (const auto& p : _r.syncing) {
+        for (const auto& range : p.ranges) {
+            add_range(lost, lost.end(), range.first, range.second);
+        }
+    }
+
+    struct stat st;
+    if (fstat(_r.fd, &st) != 0) {
+        ++_outcome.last_cut_failed;
+        static_nodes.fetch_sub(lost.size(), std::memory_order_relaxed);
+        return;
+    }
+
+    // a torn file keeps a random number of the pages it grew by
+    off_t keep_size = st.st_size;
+    if (st.st_size > _r.synced_size) {
+        keep_size = _r.synced_size;
+        if (power_cut_mode::tear == _mode) {
+            const uint64_t pages = (st.st_size - _r.synced_size + tear_page - 1) / tear_page;
+            const uint64_t draw = tear_draw(_cut, _r.ino, UINT64_MAX);
+            keep_size = std::min<off_t>(st.st_size, _r.synced_size + (draw % (pages + 1)) * tear_page);
+        }
+    }
+
+    int err = 0;
+    for (const auto& range : lost) {
+        const off_t start = range.first;
+        const off_t end = std::min(range.second, keep_size);
+        if (start >= end) {
+            continue;
+        }
+
+        if (power_cut_mode::discard == _mode) {
+            err = err ? err : zero_range(_r.fd, start, end - start);
+            _outcome.last_cut_lost_bytes += end - start;
+            continue;
+        }
+
+        // runs of lost pages are zeroed together
+        off_t run = -1;
+        for (off_t off = start; off < end;) {
+            const off_t next = std::min(end, (off / tear_page + 1) * tear_page);
+            if (tear_draw(_cut, _r.ino, off / tear_page) & 1) {
+                if (run >= 0) {
+                    err = err ? err : zero_range(_r.fd, run, off - run);
+                    run = -1;
+                }
+
+                _outcome.last_cut_kept_bytes += next - off;
+            }
+            else {
+                run = run < 0 ? off : run;
+                _outcome.last_cut_lost_bytes += next - off;
+            }
+
+            off = next;
+        }
+
+        if (run >= 0) {
+            err = err ? err : zero_range(_r.fd, run, end - run);
+        }
+    }
+
+    if (keep_size < st.st_size) {
+        if (ftruncate(_r.fd, keep_size) != 0) {
+            err = err ? err : -errno;
+        }
+
+        _outcome.last_cut_truncated_bytes += st.st_size - keep_size;
+    }
+
+    if (err) {
+        MUNGEFS_LOG(log_level::error, "power cut incomplete for inode %llu [%s]",
+                    static_cast<unsigned long long>(_r.ino), strerror(-err));
+        ++_outcome.last_cut_failed;
+    }
+
+    // reads after the cut must see what it left, not prefetched data
+    prefetch_invalidate(_r.dev, _r.ino, 0, 0);
+
+    static_nodes.fetch_sub(lost.size(), std::memory_order_relaxed);
+    ++_outcome.last_cut_files;
+} // cut_file_locked
+
+int power_cut(power_cut_mode _mode, std::string& _message) {
+    if (!static_enabled) {
+        _message = "power loss is not tracked, mount with -o mungefs_powerloss";
+        return -ENOTSUP;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // from here on handles opened before fail, and writes that passed the
+    // check before are waited for, so no write made before the cut lands
+    // after it
+    std::unique_lock<std::shared_timed_mutex> cycle_lk(static_power_cycle_mutex);
+    const uint64_t cut = power_cycle_counter.fetch_add(1, std::memory_order_acq_rel) + 1;
+
+    std::lock_guard<std::mutex> lk(static_registry_mutex);
+    powerloss_info outcome = {};
+    for (auto it = static_registry.begin(); it != static_registry.end();) {
+        auto& r = *it->second;
+        {
+            std::lock_guard<std::mutex> rlk(r.mutex);
+            if (!r.ranges.empty() || !r.syncing.empty()) {
+                cut_file_locked(r, _mode, cut, outcome);
+            }
+
+            static_nodes.fetch_sub(r.ranges.size(), std::memory_order_relaxed);
+            for (const auto& p : r.syncing) {
+                static_nodes.fetch_sub(p.ranges.size(), std::memory_order_relaxed);
+            }
+
+            r.ranges.clear();
+            r.syncing.clear();
+            r.hint = r.ranges.end();
+
+            struct stat st;
+            if (fstat(r.fd, &st) == 0) {
+                r.synced_size = st.st_size;
+            }
+        }
+
+        it = r.handles ? std::next(it) : static_registry.erase(it);
+    }
+
+    outcome.last_cut_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - start).count();
+    static_last_cut = outcome;
+
+    _message = std::string(power_cut_mode::tear == _mode ? "tore " : "discarded ") +
+               std::to_string(outcome.last_cut_lost_bytes) + " bytes in " +
+               std::to_string(outcome.last_cut_files) + " files";
+    MUNGEFS_LOG(log_level::info, "power cut %llu %s",
+                static_cast<unsigned long long>(cut), _message.c_str());
+    return outcome.last_cut_failed ? -EIO : 0;
+} // power_cut
+
+void get_powerloss_info(powerloss_info& _info) {
+    std::lock_guard<std::mutex> lk(static_registry_mutex);
+    _info = static_last_cut;
+    _info.enabled = static_enabled;
+    _info.cycle = current_power_cycle();
+    _info.files = static_registry.size();
+    _info.ranges = static_nodes.load(std::memory_order_relaxed);
+    _info.unsynced_bytes = 0;
+    _info.widened = static_widened.load(std::memory_order_relaxed);
+
+    // ranges a sync has set aside may overlap the newer ones, so this is
+    // an upper bound while syncs are in flight
+    for (const auto& entry : static_registry) {
+        auto& r = *entry.second;
+        std::lock_guard<std::mutex> rlk(r.mutex);
+        for (const auto& range : r.ranges) {
+            _info.unsynced_bytes += range.second - range.first;
+        }
+
+        for (const auto& p : r.syncing) {
+            for (const auto& range : p.ranges) {
+                _info.unsynced_bytes += range.second - range.first;
+            }
+        }
+    }
+} // get_powerloss_info
+
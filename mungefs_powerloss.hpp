@@ -0,0 +1,122 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_POWERLOSS_HPP
+#define MUNGEFS_POWERLOSS_HPP
+
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// with -o mungefs_powerloss every file written through mungefs has the
+// byte ranges written to it since it was last synced kept in an interval
+// map, merged as writes touch or overlap. a power cut then does to those
+// ranges what losing power would: they are discarded, reading back as
+// zeros, or torn, keeping a random subset of their pages. the size a file
+// had when first opened or last synced is taken as durable, and anything
+// it grew by since is cut off. the ranges are bounded by
+// -o mungefs_powerloss_mb; past it the ranges of a file are widened until
+// they fit, and a cut may then lose bytes lying between writes too.
+//
+// every cut advances the power cycle. writes, syncs and buffered data of
+// handles opened before it are lost with it and fail with EIO.
+struct unsynced_ranges;
+typedef std::shared_ptr<unsynced_ranges> unsynced_ranges_ptr;
+
+bool powerloss_enabled();
+void start_powerloss(unsigned _limit_mb);
+
+// the ranges of the file open on the writable _fd, shared by every handle
+// on the file. null unless tracking is enabled. the file is reopened so it
+// can still be cut once the handles on it are closed.
+unsynced_ranges_ptr track_unsynced(int _fd, dev_t _dev, ino_t _ino);
+
+// give up a handle's reference, forgetting the file once it has no open
+// handles and nothing left to lose
+void release_unsynced(unsynced_ranges_ptr& _ranges);
+
+void note_unsynced_range(unsynced_ranges& _ranges, off_t _offset, size_t _size);
+void note_synced_range(unsynced_ranges& _ranges, off_t _offset, size_t _size);
+
+// called once _size bytes have reached the backing file at _offset. the
+// bytes written through an O_SYNC or O_DSYNC descriptor are _durable.
+inline void note_written(
+    const unsynced_ranges_ptr& _ranges,
+    off_t                      _offset,
+    size_t                     _size,
+    bool                       _durable) {
+    if (!_ranges || !_size) {
+        return;
+    }
+
+    if (_durable) {
+        note_synced_range(*_ranges, _offset, _size);
+    }
+    else {
+        note_unsynced_range(*_ranges, _offset, _size);
+    }
+} // note_written
+
+// bracket a sync of the file. the ranges written before start_sync are
+// set aside and dropped when finish_sync is told the sync worked, while
+// writes landing during the sync stay unsynced.
+uint64_t start_sync(const unsynced_ranges_ptr& _ranges);
+void finish_sync(const unsynced_ranges_ptr& _ranges, uint64_t _token, bool _synced);
+
+extern std::atomic<uint64_t> power_cycle_counter;
+
+inline uint64_t current_power_cycle() {
+    return power_cycle_counter.load(std::memory_order_acquire);
+}
+
+inline bool powered_off_since(uint64_t _cycle) {
+    return _cycle != current_power_cycle();
+}
+
+// held shared by a write from its check of the power cycle until it has
+// noted what it wrote, and exclusively by a cut, so no write lands after
+// a cut without failing
+std::shared_timed_mutex& power_cycle_mutex();
+
+typedef std::shared_lock<std::shared_timed_mutex> power_cycle_guard;
+
+enum class power_cut_mode {
+    discard,  // every unsynced byte is lost
+    tear      // each unsynced page survives or not, as a coin decides
+};
+
+// tearing draws from the fault seed when one is set
+int power_cut(power_cut_mode _mode, std::string& _message);
+
+struct powerloss_info {
+    bool     enabled;
+    uint64_t cycle;
+    uint64_t files;                // files with open handles or unsynced data
+    uint64_t ranges;
+    uint64_t unsynced_bytes;
+    uint64_t widened;              // times the ranges of a file were widened
+    uint64_t last_cut_files;
+    uint64_t last_cut_lost_bytes;
+    uint64_t last_cut_kept_bytes;  // torn pages that survived
+    uint64_t last_cut_truncated_bytes;
+    uint64_t last_cut_failed;      // files the cut could not be applied to
+    uint64_t last_cut_us;
+};
+
+void get_powerloss_info(powerloss_info& _info);
+
+#endif // MUNGEFS_POWERLOSS_HPP
+
@@ -0,0 +1,394 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "mungefs_handle.hpp"
+#include "mungefs_io.hpp"
+#include "mungefs_options.hpp"
+#include "mungefs_prefetch.hpp"
+
+// the cache is made of aligned chunks of this size
+static const size_t chunk_size = 128 * 1024;
+
+// reads that must continue the previous one before we start prefetching
+static const unsigned sequential_threshold = 2;
+
+static const size_t initial_window = 2 * chunk_size;
+
+class prefetch_cache {
+public:
+    struct key_type {
+        dev_t dev;
+        ino_t ino;
+        off_t index;
+
+        bool operator==(const key_type& _rhs) const {
+            return index == _rhs.index && ino == _rhs.ino && dev == _rhs.dev;
+        }
+    };
+
+    struct key_hash {
+        size_t operator()(const key_type& _k) const {
+            size_t h = std::hash<uint64_t>()(_k.ino);
+            h ^= std::hash<uint64_t>()(_k.dev) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+            h ^= std::hash<uint64_t>()(_k.index) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+            return h;
+        }
+    };
+
+    // data is only written by the worker before ready is set and never
+    // changes after, so readers may copy it without holding the lock
+    struct chunk {
+        std::atomic<bool>             ready;
+        ssize_t                       length;
+        std::vector<char>             data;
+        std::list<key_type>::iterator lru;
+
+        chunk() : ready{false}, length{0} {
+        }
+    };
+
+    typedef std::shared_ptr<chunk> chunk_ptr;
+
+    struct job {
+        mungefs_file_handle* handle;
+        int          fd;
+        off_t        offset;
+        chunk_ptr    target;
+    };
+
+    prefetch_cache() : capacity_{0}, bytes_{0}, stop_{false} {
+    }
+
+    void start(size_t _capacity, size_t _workers) {
+        capacity_ = _capacity;
+        stop_ = false;
+        for (size_t i = 0; i < _workers; ++i) {
+            workers_.emplace_back(&prefetch_cache::worker, this);
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            stop_ = true;
+            jobs_.clear();
+        }
+
+        work_cv_.notify_all();
+        for (auto& w : workers_) {
+            w.join();
+        }
+
+        workers_.clear();
+        std::lock_guard<std::mutex> lk(mutex_);
+        chunks_.clear();
+        lru_.clear();
+        bytes_ = 0;
+    }
+
+    bool enabled() const {
+        return capacity_ > 0;
+    }
+
+    // queue every chunk touching [_begin, _end) that is not cached yet
+    void schedule(mungefs_file_handle& _handle, off_t _begin, off_t _end) {
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (stop_) {
+            return;
+        }
+
+        bool queued = false;
+        for (off_t idx = _begin / chunk_size; idx * static_cast<off_t>(chunk_size) < _end; ++idx) {
+            key_type key{_handle.dev, _handle.ino, idx};
+            if (chunks_.count(key)) {
+                continue;
+            }
+
+            if (!make_room()) {
+                break;
+            }
+
+            auto c = std::make_shared<chunk>();
+            lru_.push_front(key);
+            c->lru = lru_.begin();
+            chunks_.emplace(key, c);
+            bytes_ += chunk_size;
+
+            jobs_.push_back({&_handle, _handle.fd, idx * static_cast<off_t>(chunk_size), c});
+            queued = true;
+        }
+
+        if (queued) {
+            work_cv_.notify_all();
+        }
+    }
+
+    ssize_t serve(mungefs_file_handle& _handle, char* _buf, size_t _size, off_t _offset) {
+        if (!_size) {
+            return 0;
+        }
+
+        const off_t first = _offset / chunk_size;
+        const off_t last  = (_offset + _size - 1) / chunk_size;
+        std::vector<chunk_ptr> found;
+        found.reserve(last - first + 1);
+
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            for (off_t idx = first; idx <= last; ++idx) {
+                auto it = chunks_.find(key_type{_handle.dev, _handle.ino, idx});
+                if (chunks_.end() == it || !it->second->ready || it->second->length < 0) {
+                    return -1;
+                }
+
+                lru_.splice(lru_.begin(), lru_, it->second->lru);
+                found.push_back(it->second);
+
+                // a short chunk is the end of the file
+                if (static_cast<size_t>(it->second->length) < chunk_size) {
+                    break;
+                }
+            }
+        }
+
+        size_t copied = 0;
+        for (size_t i = 0; i < found.size() && copied < _size; ++i) {
+            const auto& c = found[i];
+            off_t from = _offset + copied - (first + static_cast<off_t>(i)) * chunk_size;
+            if (from >= c->length) {
+                break;
+            }
+
+            size_t n = std::min<size_t>(c->length - from, _size - copied);
+            memcpy(_buf + copied, c->data.data() + from, n);
+            copied += n;
+        }
+
+        return copied;
+    }
+
+    void invalidate(dev_t _dev, ino_t _ino, off_t _offset, size_t _size) {
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (chunks_.empty()) {
+            return;
+        }
+
+        const off_t first = _offset / chunk_size;
+        if (_size) {
+            const off_t last = (_offset + _size - 1) / chunk_size;
+            for (off_t idx = first; idx <= last; ++idx) {
+                erase(key_type{_dev, _ino, idx});
+            }
+
+            return;
+        }
+
+        for (auto it = chunks_.begin(); it != chunks_.end();) {
+            if (it->first.dev == _dev && it->first.ino == _ino && it->first.index >= first) {
+                lru_.erase(it->second->lru);
+                bytes_ -= chunk_size;
+                it = chunks_.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    void forget(mungefs_file_handle& _handle) {
+        std::unique_lock<std::mutex> lk(mutex_);
+        for (auto it = jobs_.begin(); it != jobs_.end();) {
+            if (it->handle == &_handle) {
+                erase(key_type{_handle.dev, _handle.ino, it->offset / static_cast<off_t>(chunk_size)}, it->target);
+                it = jobs_.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+
+        done_cv_.wait(lk, [&_handle] { return 0 == _handle.readahead.running; });
+    }
+
+private:
+    // evict least recently used chunks until one more fits, caller holds
+    // the lock. returns false if the cache is full of chunks in flight.
+    bool make_room() {
+        while (bytes_ + chunk_size > capacity_) {
+            if (lru_.empty()) {
+                return false;
+            }
+
+            auto it = chunks_.find(lru_.back());
+            if (!it->second->ready) {
+                return false;
+            }
+
+            lru_.pop_back();
+            chunks_.erase(it);
+            bytes_ -= chunk_size;
+        }
+
+        return true;
+    }
+
+    // erase a chunk, only if it is still _expected when one is given
+    void erase(const key_type& _key, const chunk_ptr& _expected = chunk_ptr()) {
+        auto it = chunks_.find(_key);
+        if (chunks_.end() == it || (_expected && _expected != it->second)) {
+            return;
+        }
+
+        lru_.erase(it->second->lru);
+        chunks_.erase(it);
+        bytes_ -= chunk_size;
+    }
+
+    void worker() {
+        std::unique_lock<std::mutex> lk(mutex_);
+        while (true) {
+            work_cv_.wait(lk, [this] { return stop_ || !jobs_.empty(); });
+            if (stop_) {
+                return;
+            }
+
+            job j = jobs_.front();
+            jobs_.pop_front();
+            ++j.handle->readahead.running;
+            lk.unlock();
+
+            j.target->data.resize(chunk_size);
+            j.target->length = backing_pread(j.fd, j.target->data.data(), chunk_size, j.offset);
+            j.target->ready = true;
+
+            lk.lock();
+            --j.handle->readahead.running;
+            if (j.target->length < 0) {
+                erase(key_type{j.handle->dev, j.handle->ino, j.offset / static_cast<off_t>(chunk_size)}, j.target);
+            }
+
+            done_cv_.notify_all();
+        }
+    }
+
+    size_t                  capacity_;
+    size_t                  bytes_;
+    bool                    stop_;
+    std::mutex              mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    std::deque<job>         jobs_;
+    std::list<key_type>     lru_;
+    std::unordered_map<key_type, chunk_ptr, key_hash> chunks_;
+    std::vector<std::thread> workers_;
+}; // class prefetch_cache
+
+static prefetch_cache static_prefetch_cache;
+
+void start_prefetch() {
+    const auto& opts = get_mungefs_options();
+    if (!opts.readahead_cache_mb) {
+        return;
+    }
+
+    static_prefetch_cache.start(
+        static_cast<size_t>(opts.readahead_cache_mb) * 1024 * 1024,
+        2);
+} // start_prefetch
+
+void stop_prefetch() {
+    if (static_prefetch_cache.enabled()) {
+        static_prefetch_cache.stop();
+    }
+} // stop_prefetch
+
+bool prefetch_enabled() {
+    return static_prefetch_cache.enabled();
+} // prefetch_enabled
+
+void prefetch_note_read(mungefs_file_handle& _handle, size_t _size, off_t _offset) {
+    if (!static_prefetch_cache.enabled()) {
+        return;
+    }
+
+    auto& ra = _handle.readahead;
+    off_t begin = 0;
+    off_t end   = 0;
+    {
+        std::lock_guard<std::mutex> lk(ra.mutex);
+        if (_offset == ra.next_offset) {
+            ++ra.sequential;
+        }
+        else {
+            ra.sequential    = 0;
+            ra.window        = initial_window;
+            ra.prefetched_to = 0;
+        }
+
+        if (!ra.window) {
+            ra.window = initial_window;
+        }
+
+        ra.next_offset = _offset + _size;
+        if (ra.sequential < sequential_threshold) {
+            return;
+        }
+
+        const size_t max_window = static_cast<size_t>(get_mungefs_options().readahead_max_kb) * 1024;
+        begin = std::max(ra.prefetched_to, ra.next_offset);
+        end   = ra.next_offset + ra.window;
+        ra.window = std::min(ra.window * 2, std::max(max_window, initial_window));
+        if (begin >= end) {
+            return;
+        }
+
+        ra.prefetched_to = end;
+    }
+
+    static_prefetch_cache.schedule(_handle, begin, end);
+} // prefetch_note_read
+
+ssize_t prefetch_serve(mungefs_file_handle& _handle, char* _buf, size_t _size, off_t _offset) {
+    if (!static_prefetch_cache.enabled()) {
+        return -1;
+    }
+
+    return static_prefetch_cache.serve(_handle, _buf, _size, _offset);
+} // prefetch_serve
+
+void prefetch_invalidate(dev_t _dev, ino_t _ino, off_t _offset, size_t _size) {
+    if (!static_prefetch_cache.enabled()) {
+        return;
+    }
+
+    static_prefetch_cache.invalidate(_dev, _ino, _offset, _size);
+} // prefetch_invalidate
+
+void prefetch_forget(mungefs_file_handle& _handle) {
+    if (!static_prefetch_cache.enabled()) {
+        return;
+    }
+
+    static_prefetch_cache.forget(_handle);
+} // prefetch_forget
+
@@ -0,0 +1,61 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_PREFETCH_HPP
+#define MUNGEFS_PREFETCH_HPP
+
+#include <mutex>
+
+#include <sys/types.h>
+
+// sequential access tracking for one open file
+struct readahead_state {
+    std::mutex mutex;
+    off_t      next_offset;    // where a sequential reader reads next
+    unsigned   sequential;     // consecutive reads that continued the last one
+    size_t     window;         // bytes to keep queued ahead of the reader
+    off_t      prefetched_to;  // end of the range already queued
+    unsigned   running;        // prefetch reads in flight, guarded by the cache
+
+    readahead_state() :
+        next_offset{0},
+        sequential{0},
+        window{0},
+        prefetched_to{0},
+        running{0} {
+    }
+};
+
+struct mungefs_file_handle;
+
+void start_prefetch();
+void stop_prefetch();
+bool prefetch_enabled();
+
+// record a read of _size bytes at _offset and queue background reads
+// ahead of it once the handle looks sequential
+void prefetch_note_read(mungefs_file_handle& _handle, size_t _size, off_t _offset);
+
+// copy [_offset, _offset + _size) out of the cache. returns the number of
+// bytes copied, which may be short at end of file, or -1 if any part of
+// the range is not cached
+ssize_t prefetch_serve(mungefs_file_handle& _handle, char* _buf, size_t _size, off_t _offset);
+
+// drop cached data overlapping a modified range, _size 0 means to the end
+void prefetch_invalidate(dev_t _dev, ino_t _ino, off_t _offset, size_t _size);
+
+// cancel queued reads for a handle and wait for running ones to finish,
+// must be called before the handle's descriptor is closed
+void prefetch_forget(mungefs_file_handle& _handle);
+
+#endif // MUNGEFS_PREFETCH_HPP
+
@@ -0,0 +1,131 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_PROTOCOL_HPP
+#define MUNGEFS_PROTOCOL_HPP
+
+#include <algorithm>
+
+#include <stdint.h>
+
+#include "avro/Decoder.hh"
+#include "avro/Encoder.hh"
+#include "avro/Specific.hh"
+#include "avro/Stream.hh"
+
+#include "message_broker.hpp"
+
+// every control message except the original bare mungefs_ctl starts with
+// a four byte header: the marker below and a message type. an encoded
+// mungefs_ctl cannot start with the marker, a leading zero is an empty
+// operations array and the next byte is then a boolean, 0 or 1.
+static const uint8_t MESSAGE_MARKER[] = {0x00, 'M', 'F'};
+static const size_t  MESSAGE_HEADER_SIZE = sizeof(MESSAGE_MARKER) + 1;
+
+static const uint8_t BATCH_MSG_TYPE = 'B';  // mungefs_batch
+static const uint8_t REPLY_MSG_TYPE = 'R';  // mungefs_reply
+static const uint8_t SCENARIO_MSG_TYPE = 'S';         // mungefs_scenario_ctl
+static const uint8_t SCENARIO_STATUS_MSG_TYPE = 's';  // mungefs_scenario_status
+static const uint8_t STATS_MSG_TYPE = 'T';            // header only
+static const uint8_t STATS_REPLY_MSG_TYPE = 't';      // mungefs_stats
+static const uint8_t JOURNAL_MSG_TYPE = 'J';          // mungefs_journal_request
+static const uint8_t JOURNAL_REPLY_MSG_TYPE = 'j';    // mungefs_journal_reply
+static const uint8_t SNAPSHOT_MSG_TYPE = 'P';         // mungefs_snapshot_ctl
+static const uint8_t SNAPSHOT_STATUS_MSG_TYPE = 'p';  // mungefs_snapshot_status
+static const uint8_t POWER_MSG_TYPE = 'W';            // mungefs_power_ctl
+static const uint8_t POWER_STATUS_MSG_TYPE = 'w';     // mungefs_power_status
+
+// a snapshot, reset or power cut is answered once done, which on a large
+// tree takes far longer than the sockets wait for other replies
+static const long SNAPSHOT_REPLY_WAIT_MS = 10 * 60 * 1000;
+
+// a message that is only a header, asking for something
+inline message_broker::data_type encode_message(const uint8_t _type) {
+    message_broker::data_type msg(MESSAGE_MARKER, MESSAGE_MARKER + sizeof(MESSAGE_MARKER));
+    msg.push_back(_type);
+    return msg;
+} // encode_message
+
+template <typename T>
+message_broker::data_type encode_message(
+    const uint8_t _type,
+    const T&      _body) {
+    auto out = avro::memoryOutputStream();
+    auto enc = avro::binaryEncoder();
+    enc->init(*out);
+    avro::encode(*enc, _body);
+    enc->flush();
+    auto data = avro::snapshot(*out);
+
+    message_broker::data_type msg(MESSAGE_MARKER, MESSAGE_MARKER + sizeof(MESSAGE_MARKER));
+    msg.push_back(_type);
+    msg.insert(msg.end(), data->begin(), data->end());
+    return msg;
+} // encode_message
+
+// returns false for a message without the header, a bare mungefs_ctl
+inline bool get_message_type(
+    const uint8_t* _data,
+    const size_t   _size,
+    uint8_t&       _type) {
+    if (_size < MESSAGE_HEADER_SIZE ||
+        !std::equal(MESSAGE_MARKER, MESSAGE_MARKER + sizeof(MESSAGE_MARKER), _data)) {
+        return false;
+    }
+
+    _type = _data[sizeof(MESSAGE_MARKER)];
+    return true;
+} // get_message_type
+
+inline bool get_message_type(
+    const message_broker::data_type& _msg,
+    uint8_t&                         _type) {
+    return get_message_type(_msg.data(), _msg.size(), _type);
+} // get_message_type
+
+inline bool get_message_type(
+    const zmq::message_t& _msg,
+    uint8_t&              _type) {
+    return get_message_type(static_cast<const uint8_t*>(_msg.data()), _msg.size(), _type);
+} // get_message_type
+
+// throws avro::Exception if the body does not decode as a T. avro reads
+// the body where it lies, in the vector or in zmq's own buffer.
+template <typename T>
+void decode_message(
+    const uint8_t* _data,
+    const size_t   _size,
+    T&             _body) {
+    auto in = avro::memoryInputStream(
+                  _data + MESSAGE_HEADER_SIZE,
+                  _size - MESSAGE_HEADER_SIZE);
+    auto dec = avro::binaryDecoder();
+    dec->init(*in);
+    avro::decode(*dec, _body);
+} // decode_message
+
+template <typename T>
+void decode_message(
+    const message_broker::data_type& _msg,
+    T&                               _body) {
+    decode_message(_msg.data(), _msg.size(), _body);
+} // decode_message
+
+template <typename T>
+void decode_message(
+    const zmq::message_t& _msg,
+    T&                    _body) {
+    decode_message(static_cast<const uint8_t*>(_msg.data()), _msg.size(), _body);
+} // decode_message
+
+#endif // MUNGEFS_PROTOCOL_HPP
+
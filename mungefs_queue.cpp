@@ -0,0 +1,56 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <chrono>
+
+#include "mungefs_queue.hpp"
+
+fifo_semaphore::fifo_semaphore(size_t _depth) :
+    depth_{_depth},
+    in_flight_{0} {
+} // fifo_semaphore::fifo_semaphore
+
+int64_t fifo_semaphore::acquire() {
+    std::unique_lock<std::mutex> lk(mutex_);
+    if (waiting_.empty() && in_flight_ < depth_) {
+        ++in_flight_;
+        return 0;
+    }
+
+    const auto queued = std::chrono::steady_clock::now();
+    waiter w;
+    waiting_.push_back(&w);
+    w.cv.wait(lk, [&w]() { return w.admitted; });
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - queued).count();
+} // fifo_semaphore::acquire
+
+void fifo_semaphore::release() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (waiting_.empty()) {
+        --in_flight_;
+        return;
+    }
+
+    // the place passes to the waiter, in_flight_ stays the same. notified
+    // under the lock, the waiter cannot return and free itself before.
+    waiter* w = waiting_.front();
+    waiting_.pop_front();
+    w->admitted = true;
+    w->cv.notify_one();
+} // fifo_semaphore::release
+
+size_t fifo_semaphore::in_flight() const {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return in_flight_;
+} // fifo_semaphore::in_flight
+
@@ -0,0 +1,92 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_QUEUE_HPP
+#define MUNGEFS_QUEUE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include <stdint.h>
+
+// emulates the bounded queue of a device: at most depth operations are in
+// flight, the others wait and are admitted strictly in the order they
+// arrived. a release hands its place straight to the oldest waiter, so a
+// newcomer can never overtake it.
+class fifo_semaphore {
+public:
+    explicit fifo_semaphore(size_t _depth);
+
+    fifo_semaphore(const fifo_semaphore&) = delete;
+    fifo_semaphore& operator=(const fifo_semaphore&) = delete;
+
+    // block until admitted, returning how long that took in microseconds
+    int64_t acquire();
+    void release();
+
+    size_t in_flight() const;
+
+private:
+    struct waiter {
+        std::condition_variable cv;
+        bool                    admitted;
+
+        waiter() : admitted{false} {
+        }
+    };
+
+    const size_t        depth_;
+    mutable std::mutex  mutex_;
+    size_t              in_flight_;
+    std::deque<waiter*> waiting_;
+}; // class fifo_semaphore
+
+// the place an operation holds in a queue, given up when the operation
+// returns and the slot goes out of scope. an operation holds one place at
+// most, even when two of its paths match queued faults.
+class queue_slot {
+public:
+    queue_slot() {
+    }
+
+    ~queue_slot() {
+        release();
+    }
+
+    queue_slot(const queue_slot&) = delete;
+    queue_slot& operator=(const queue_slot&) = delete;
+
+    // take over a place already acquired in _queue
+    void hold(const std::shared_ptr<fifo_semaphore>& _queue) {
+        release();
+        queue_ = _queue;
+    }
+
+    bool held() const {
+        return static_cast<bool>(queue_);
+    }
+
+    void release() {
+        if (queue_) {
+            queue_->release();
+            queue_.reset();
+        }
+    }
+
+private:
+    std::shared_ptr<fifo_semaphore> queue_;
+}; // class queue_slot
+
+#endif // MUNGEFS_QUEUE_HPP
+
@@ -0,0 +1,310 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <cerrno>
+
+#include "boost/algorithm/string.hpp"
+#include "boost/property_tree/json_parser.hpp"
+#include "boost/property_tree/ptree.hpp"
+
+#include "mungefs_batch.hpp"
+#include "mungefs_log.hpp"
+#include "mungefs_reply.hpp"
+#include "mungefs_scenario.hpp"
+#include "mungefs_scenario_status.hpp"
+#include "mungefs_server.hpp"
+
+// the scheduler sleeps until this close to a step, then spins, since a
+// sleep can overshoot by far more than the step needs to be accurate to
+static const std::chrono::microseconds spin_margin(200);
+
+struct scenario_step {
+    int64_t       at_us;
+    mungefs_batch batch;
+};
+
+struct scenario {
+    std::string                name;
+    std::vector<scenario_step> steps;
+};
+
+static mungefs_rule parse_rule(const boost::property_tree::ptree& _pt) {
+    mungefs_rule rule;
+
+    const auto action = _pt.get<std::string>("action", "set");
+    if ("set" == action) {
+        rule.action = SET_FAULT;
+    }
+    else if ("add" == action) {
+        rule.action = ADD_FAULT;
+    }
+    else if ("clear" == action) {
+        rule.action = CLEAR_FAULT;
+    }
+    else {
+        throw std::invalid_argument("unknown action [" + action + "]");
+    }
+
+    // a list, or a string as given to mungefsctl --operations
+    const auto& ops = _pt.get_child("operations");
+    if (ops.empty()) {
+        boost::split(
+            rule.operations,
+            ops.data(),
+            boost::is_any_of(", "),
+            boost::token_compress_on);
+    }
+    else {
+        for (const auto& op : ops) {
+            rule.operations.push_back(op.second.data());
+        }
+    }
+
+    rule.random          = _pt.get<bool>("random", false);
+    rule.err_no          = _pt.get<int32_t>("err_no", 0);
+    rule.probability     = _pt.get<int64_t>("probability", 0);
+    rule.regexp          = _pt.get<std::string>("regexp", "");
+    rule.kill_caller     = _pt.get<bool>("kill_caller", false);
+    rule.delay_us        = _pt.get<int64_t>("delay_us", 0);
+    rule.auto_delay      = _pt.get<bool>("auto_delay", false);
+    rule.corrupt_data    = _pt.get<bool>("corrupt_data", false);
+    rule.corrupt_size    = _pt.get<bool>("corrupt_size", false);
+    rule.skip_first      = _pt.get<int64_t>("skip_first", 0);
+    rule.every_nth       = _pt.get<int64_t>("every_nth", 0);
+    rule.max_fires       = _pt.get<int64_t>("max_fires", 0);
+    rule.active_after_us = _pt.get<int64_t>("active_after_us", 0);
+    rule.active_for_us   = _pt.get<int64_t>("active_for_us", 0);
+    rule.pid             = _pt.get<int32_t>("pid", 0);
+    rule.pid_tree        = _pt.get<bool>("pid_tree", false);
+    rule.uid             = _pt.get<int64_t>("uid", -1);
+    rule.gid             = _pt.get<int64_t>("gid", -1);
+    rule.comm            = _pt.get<std::string>("comm", "");
+    rule.queue_depth     = _pt.get<int64_t>("queue_depth", 0);
+    return rule;
+} // parse_rule
+
+// parse the document and check every rule, nothing is applied here
+static int parse_scenario(
+    const std::string& _name,
+    const std::string& _document,
+    scenario&          _out,
+    std::string&       _message) {
+    namespace pt = boost::property_tree;
+
+    try {
+        pt::ptree root;
+        std::istringstream in(_document);
+        pt::read_json(in, root);
+
+        _out.name = root.get<std::string>("name", _name);
+        for (const auto& s : root.get_child("steps")) {
+            scenario_step step;
+            step.at_us = s.second.get<int64_t>("at_us");
+            if (step.at_us < 0) {
+                throw std::invalid_argument("negative at_us");
+            }
+
+            step.batch.replace_all = s.second.get<bool>("replace_all", false);
+            auto rules = s.second.get_child_optional("rules");
+            if (rules) {
+                for (const auto& r : *rules) {
+                    step.batch.rules.push_back(parse_rule(r.second));
+                }
+            }
+
+            _out.steps.push_back(step);
+        }
+    }
+    catch (const std::exception& _e) {
+        _message = std::string("invalid scenario - ") + _e.what();
+        return -EINVAL;
+    }
+
+    // steps given out of order run in order
+    std::stable_sort(
+        _out.steps.begin(),
+        _out.steps.end(),
+        [](const scenario_step& _a, const scenario_step& _b) {
+            return _a.at_us < _b.at_us;
+        });
+
+    for (size_t i = 0; i < _out.steps.size(); ++i) {
+        mungefs_reply reply;
+        check_fault_batch(_out.steps[i].batch, reply);
+        for (size_t r = 0; r < reply.statuses.size(); ++r) {
+            if (reply.statuses[r].error) {
+                std::stringstream ss;
+                ss << "step " << i + 1 << " rule " << r + 1 << ": "
+                   << reply.statuses[r].message;
+                _message = ss.str();
+                return reply.statuses[r].error;
+            }
+        }
+    }
+
+    return 0;
+} // parse_scenario
+
+// applies the steps of one scenario at a time from its own thread
+class scenario_runner {
+public:
+    scenario_runner() : stop_{false}, step_{0} {
+    }
+
+    void start(std::unique_ptr<scenario> _scenario) {
+        stop();
+
+        std::lock_guard<std::mutex> lk(mutex_);
+        scenario_ = std::move(_scenario);
+        stop_ = false;
+        step_ = 0;
+        started_ = std::chrono::steady_clock::now();
+        thread_ = std::make_unique<std::thread>(&scenario_runner::run, this);
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            stop_ = true;
+        }
+
+        cv_.notify_all();
+        if (thread_) {
+            thread_->join();
+            thread_.reset();
+        }
+    }
+
+    void status(mungefs_scenario_status& _status) {
+        std::lock_guard<std::mutex> lk(mutex_);
+        _status.running = false;
+        _status.step = 0;
+        _status.steps = 0;
+        _status.elapsed_us = 0;
+        _status.next_at_us = -1;
+        if (!scenario_) {
+            return;
+        }
+
+        const size_t step = step_;
+        _status.name = scenario_->name;
+        _status.step = step;
+        _status.steps = scenario_->steps.size();
+        _status.running = !stop_ && step < scenario_->steps.size();
+        _status.elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                 std::chrono::steady_clock::now() - started_).count();
+        if (step < scenario_->steps.size()) {
+            _status.next_at_us = scenario_->steps[step].at_us;
+        }
+    }
+
+private:
+    // return false if stopped before _deadline
+    bool wait_until(std::chrono::steady_clock::time_point _deadline) {
+        {
+            std::unique_lock<std::mutex> lk(mutex_);
+            if (cv_.wait_until(lk, _deadline - spin_margin, [this] { return stop_; })) {
+                return false;
+            }
+        }
+
+        while (std::chrono::steady_clock::now() < _deadline) {
+        }
+
+        return true;
+    }
+
+    void run() {
+        const auto& steps = scenario_->steps;
+        for (size_t i = 0; i < steps.size(); ++i) {
+            const auto deadline = started_ + std::chrono::microseconds(steps[i].at_us);
+            if (!wait_until(deadline)) {
+                return;
+            }
+
+            mungefs_reply reply;
+            apply_fault_batch(steps[i].batch, reply);
+            const auto late = std::chrono::duration_cast<std::chrono::microseconds>(
+                                  std::chrono::steady_clock::now() - deadline).count();
+            step_ = i + 1;
+
+            std::stringstream ss;
+            ss << "scenario [" << scenario_->name << "] step " << i + 1
+               << "/" << steps.size() << " at " << steps[i].at_us << "us"
+               << " (+" << late << "us) "
+               << (reply.applied ? "applied" : "rejected")
+               << ", generation " << reply.generation;
+            log_message(ss.str());
+        }
+    }
+
+    bool                         stop_;
+    std::atomic<size_t>          step_;     // steps applied so far
+    std::chrono::steady_clock::time_point started_;
+    std::unique_ptr<scenario>    scenario_;
+    std::mutex                   mutex_;
+    std::condition_variable      cv_;
+    std::unique_ptr<std::thread> thread_;
+}; // class scenario_runner
+
+static scenario_runner static_scenario_runner;
+
+int start_scenario(
+    const std::string& _name,
+    const std::string& _document,
+    std::string&       _message) {
+    auto s = std::make_unique<scenario>();
+    int err = parse_scenario(_name, _document, *s, _message);
+    if (err) {
+        log_text(log_level::error, "scenario [" + _name + "] not started - " + _message);
+        return err;
+    }
+
+    log_message("scenario [" + s->name + "] started");
+    static_scenario_runner.start(std::move(s));
+    return 0;
+} // start_scenario
+
+int start_scenario_file(const std::string& _path) {
+    std::ifstream in(_path);
+    if (!in) {
+        log_text(log_level::error, "failed to open scenario file [" + _path + "]");
+        return -ENOENT;
+    }
+
+    std::stringstream document;
+    document << in.rdbuf();
+
+    std::string message;
+    return start_scenario(_path, document.str(), message);
+} // start_scenario_file
+
+void stop_scenario() {
+    static_scenario_runner.stop();
+} // stop_scenario
+
+void get_scenario_status(mungefs_scenario_status& _status) {
+    static_scenario_runner.status(_status);
+} // get_scenario_status
+
@@ -0,0 +1,46 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_SCENARIO_HPP
+#define MUNGEFS_SCENARIO_HPP
+
+#include <string>
+
+struct mungefs_scenario_status;
+
+// a scenario is a json timeline of fault batches:
+//
+// { "name": "...",
+//   "steps": [ { "at_us": 0, "replace_all": true,
+//                "rules": [ { "action": "set", "operations": ["write"],
+//                             "err_no": 5, "regexp": "/data/.*" } ] },
+//              ... ] }
+//
+// every step is applied as one batch when its offset from the start of the
+// scenario is reached. a rule takes the same fields as mungefsctl.
+
+// parse and validate _document, then run it in place of any running
+// scenario. returns 0 or -errno with the reason in _message.
+int start_scenario(
+    const std::string& _name,
+    const std::string& _document,
+    std::string&       _message);
+
+// start the scenario in the file at _path, as given at mount time
+int start_scenario_file(const std::string& _path);
+
+void stop_scenario();
+
+void get_scenario_status(mungefs_scenario_status& _status);
+
+#endif // MUNGEFS_SCENARIO_HPP
+
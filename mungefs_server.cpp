@@ -10,6 +10,7 @@
  * **
  */
 
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <map>
@@ -17,6 +18,7 @@
 #include <mutex>
 #include <random>
 #include <set>
+#include <sstream>
 #include <regex>
 #include <thread>
 #include <vector>
@@ -29,82 +31,168 @@
 #include <fuse.h>
 
 #include "message_broker.hpp"
+#include "mungefs_batch.hpp"
+#include "mungefs_caller.hpp"
 #include "mungefs_ctl.hpp"
-
-static std::ofstream err_log;
+#include "mungefs_decision.hpp"
+#include "mungefs_endpoint.hpp"
+#include "mungefs_journal.hpp"
+#include "mungefs_journal_reply.hpp"
+#include "mungefs_journal_request.hpp"
+#include "mungefs_power_ctl.hpp"
+#include "mungefs_power_status.hpp"
+#include "mungefs_powerloss.hpp"
+#include "mungefs_snapshot.hpp"
+#include "mungefs_snapshot_ctl.hpp"
+#include "mungefs_snapshot_status.hpp"
+#include "mungefs_log.hpp"
+#include "mungefs_matcher.hpp"
+#include "mungefs_protocol.hpp"
+#include "mungefs_queue.hpp"
+#include "mungefs_reply.hpp"
+#include "mungefs_scenario.hpp"
+#include "mungefs_scenario_ctl.hpp"
+#include "mungefs_scenario_status.hpp"
+#include "mungefs_server.hpp"
+#include "mungefs_stats.hpp"
 
 void print_ctl(const mungefs_ctl& _ctl) {
-    err_log << std::endl << std::endl
-            << __FUNCTION__ << std::endl 
-            << "random: " << _ctl.random << std::endl
-            << "err_no: " << _ctl.err_no << std::endl
-            << "probability: " << _ctl.probability << std::endl
-            << "regexp: " << _ctl.regexp << std::endl
-            << "kill_caller: " << _ctl.kill_caller << std::endl
-            << "delay_us: " << _ctl.delay_us << std::endl
-            << "auto_delay: " << _ctl.auto_delay << std::endl
-            << "corrupt_data: " << _ctl.corrupt_data << std::endl
-            << "corrupt_size: " << _ctl.corrupt_size << std::endl;
-    err_log << "operation: "<< std::endl;
-    err_log << "     ";
+    if (!log_enabled(log_level::debug)) {
+        return;
+    }
+
+    std::stringstream ss;
+    ss << __FUNCTION__ << std::endl
+       << "random: " << _ctl.random << std::endl
+       << "err_no: " << _ctl.err_no << std::endl
+       << "probability: " << _ctl.probability << std::endl
+       << "regexp: " << _ctl.regexp << std::endl
+       << "kill_caller: " << _ctl.kill_caller << std::endl
+       << "delay_us: " << _ctl.delay_us << std::endl
+       << "auto_delay: " << _ctl.auto_delay << std::endl
+       << "corrupt_data: " << _ctl.corrupt_data << std::endl
+       << "corrupt_size: " << _ctl.corrupt_size << std::endl;
+    ss << "operation: ";
     for(auto m : _ctl.operations) {
-        err_log << m << ", ";
+        ss << m << ", ";
     }
-    err_log << std::endl;
+    log_text(log_level::debug, ss.str());
 }
 
+static std::atomic<uint64_t> static_next_fault_id(0);
+
+struct fault_descriptor {
+    const uint64_t id;        // names the fault in the stats and the journal
+    bool        random;       // error code must be randomized
+    int         err_no;       // error code to return
+    int32_t     probability;  // 0 < probability < 100, rnd error injection
+    std::string regexp;       // regular expression on filename
+    std::regex  compiled;     // regexp, compiled once when the fault is set
+    bool        kill_caller;  // Must we kill the caller
+    int32_t     delay_us;     // operation delay in us
+    bool        auto_delay;   // must auto delay like an SSD
+    bool        corrupt_data; // corrupt read or write data
+    bool        corrupt_size; // corrupt the size reported in a stat
+
+    // triggers, zero means unused. calls are counted once the path matched
+    // and the fault is active, fires once the probability let them through.
+    // times are measured from when the fault was set.
+    int64_t     skip_first;      // let the first n calls through
+    int64_t     every_nth;       // then fire on every nth call only
+    int64_t     max_fires;       // stop firing after n times
+    int64_t     active_after_us; // stay dormant this long
+    int64_t     active_for_us;   // then stay active this long
+    std::chrono::steady_clock::time_point installed;
+
+    // caller filters, the fault only applies to matching requests
+    pid_t       pid;             // this process, 0 for any
+    bool        pid_tree;        // or any of its descendants
+    int64_t     uid;             // this user, -1 for any
+    int64_t     gid;             // this group, -1 for any
+    std::string comm;            // this command name, "" for any
+
+    // shared by every table the fault is published in
+    mutable std::atomic<int64_t> calls;
+    mutable std::atomic<int64_t> fires;
+
+    // the emulated device queue shared by the operations of the fault
+    int64_t                         queue_depth;  // calls in flight, 0 for no queue
+    std::shared_ptr<fifo_semaphore> queue;
+    mutable std::atomic<int64_t>    queued;        // calls admitted
+    mutable std::atomic<int64_t>    queue_waits;   // of which had to wait
+    mutable std::atomic<int64_t>    queue_wait_us;
+    mutable std::atomic<int64_t>    queue_wait_max_us;
+
+    // with a seed, keys the draws of the fault and counts its calls per path
+    uint64_t                   key;
+    mutable invocation_counter invocations;
+
+    fault_descriptor() :
+        id{static_next_fault_id.fetch_add(1, std::memory_order_relaxed) + 1},
+        random{false},
+        err_no{0},
+        probability{0},
+        regexp{""},
+        kill_caller{false},
+        delay_us{0},
+        auto_delay{false},
+        corrupt_data{false},
+        corrupt_size{false},
+        skip_first{0},
+        every_nth{0},
+        max_fires{0},
+        active_after_us{0},
+        active_for_us{0},
+        installed{std::chrono::steady_clock::now()},
+        pid{0},
+        pid_tree{false},
+        uid{-1},
+        gid{-1},
+        comm{""},
+        calls{0},
+        fires{0},
+        queue_depth{0},
+        queued{0},
+        queue_waits{0},
+        queue_wait_us{0},
+        queue_wait_max_us{0},
+        key{0} {
+    }
+
+    // the same rule set again draws the same values, whatever its id
+    void set_key() {
+        std::stringstream ss;
+        ss << random << ' ' << err_no << ' ' << probability << ' ' << regexp;
+        key = fnv1a(ss.str());
+    }
+
+    bool filters_caller() const {
+        return pid || uid >= 0 || gid >= 0 || !comm.empty();
+    }
+
+    // descriptors carry live counters, they are shared and never copied
+    fault_descriptor(const fault_descriptor&) = delete;
+    fault_descriptor& operator=(const fault_descriptor&) = delete;
+};
+
 class server_handler {
     public:
-    struct fault_descriptor {
-        bool        random;       // error code must be randomized
-        int         err_no;       // error code to return
-        int32_t     probability;  // 0 < probability < 100, rnd error injection
-        std::string regexp;       // regular expression on filename
-        bool        kill_caller;  // Must we kill the caller
-        int32_t     delay_us;     // operation delay in us
-        bool        auto_delay;   // must auto delay like an SSD
-        bool        corrupt_data; // corrupt read or write data
-        bool        corrupt_size; // corrupt the size reported in a stat
-        fault_descriptor() :
-            random{false},
-            err_no{0},
-            probability{0},
-            regexp{""},
-            kill_caller{false},
-            delay_us{0},
-            auto_delay{false},
-            corrupt_data{false},
-            corrupt_size{false} {
-        }
-        fault_descriptor( const fault_descriptor& _rhs) :
-            random{_rhs.random},
-            err_no{_rhs.err_no},
-            probability{_rhs.probability},
-            regexp{_rhs.regexp},
-            kill_caller{_rhs.kill_caller},
-            delay_us{_rhs.delay_us},
-            auto_delay{_rhs.auto_delay},
-            corrupt_data{_rhs.corrupt_data},
-            corrupt_size{_rhs.corrupt_size} {
-        }
-        fault_descriptor& operator=( const fault_descriptor& _rhs) {
-            if(this == &_rhs) {
-                return *this;
-            }
+    typedef std::shared_ptr<const fault_descriptor>     fault_ptr;
 
-            random = _rhs.random;
-            err_no = _rhs.err_no;
-            probability = _rhs.probability;
-            regexp = _rhs.regexp;
-            kill_caller = _rhs.kill_caller;
-            delay_us = _rhs.delay_us;
-            auto_delay = _rhs.auto_delay;
-            corrupt_data = _rhs.corrupt_data;
-            corrupt_size = _rhs.corrupt_size;
-            return *this;
-        }
+    // the faults of one operation, tried in order, the first match wins
+    typedef std::vector<fault_ptr>                      rule_list;
+    typedef std::map<std::string, rule_list>            rule_map;
+
+    // a rule list with the index used to find its first match quickly
+    struct compiled_rules {
+        rule_list    rules;
+        path_matcher matcher;
     };
 
+    typedef std::shared_ptr<const compiled_rules>       compiled_rules_ptr;
+    typedef std::map<std::string, compiled_rules_ptr>   fault_table;
+    typedef std::shared_ptr<const fault_table>          fault_table_ptr;
+
     void get_operations(std::vector<std::string> & _return) {
         for (auto op: valid_operations_) {
             _return.push_back(op);
@@ -112,13 +200,15 @@ class server_handler {
     }
 
     void clear_all_faults() {
-        std::lock_guard<std::mutex> lk(fault_mutex_);
-        fault_map_.clear();
+        std::lock_guard<std::mutex> lk(update_mutex_);
+        rules_.clear();
+        publish();
     }
 
     void clear_fault(const std::string& _operation) {
-        std::lock_guard<std::mutex> lk(fault_mutex_);
-        fault_map_.erase(_operation);
+        std::lock_guard<std::mutex> lk(update_mutex_);
+        rules_.erase(_operation);
+        publish();
     }
 
     void set_fault(
@@ -133,24 +223,39 @@ class server_handler {
         const bool                      _corrupt_data,
         const bool                      _corrupt_size) {
 
-        fault_descriptor descr;
-        descr.random       = _random;
-        descr.err_no       = _err_no;
-        descr.probability  = _probability;
-        descr.regexp       = _regexp;
-        descr.kill_caller  = _kill_caller;
-        descr.delay_us     = _delay_us;
-        descr.auto_delay   = _auto_delay;
-        descr.corrupt_data = _corrupt_data;
-        descr.corrupt_size = _corrupt_size;
-
-        std::lock_guard<std::mutex> lk(fault_mutex_);
+        auto descr = std::make_shared<fault_descriptor>();
+        descr->random       = _random;
+        descr->err_no       = _err_no;
+        descr->probability  = _probability;
+        descr->regexp       = _regexp;
+        descr->kill_caller  = _kill_caller;
+        descr->delay_us     = _delay_us;
+        descr->auto_delay   = _auto_delay;
+        descr->corrupt_data = _corrupt_data;
+        descr->corrupt_size = _corrupt_size;
+        descr->set_key();
+
+        if(!_regexp.empty()) {
+            try {
+                descr->compiled = std::regex(_regexp);
+            }
+            catch(const std::regex_error& _e) {
+                MUNGEFS_LOG(log_level::warning, "invalid regexp [%s] - %s",
+                            _regexp.c_str(), _e.what());
+                return;
+            }
+        }
+
+        // the original protocol replaces whatever the operation had
+        std::lock_guard<std::mutex> lk(update_mutex_);
         for (auto op: _operations) {
             if (is_valid_method(op)) {
-                fault_map_[op] = descr;
+                rules_[op] = rule_list{descr};
             }
         } // for
 
+        publish();
+
     } // set_fault
 
     void set_all_fault(
@@ -181,7 +286,39 @@ class server_handler {
             _corrupt_size);
     } // set_all_fault
 
-    server_handler() {
+    // apply every rule of _batch to one copy of the rules and publish it,
+    // or publish nothing if any rule is rejected or this is a dry run
+    void apply_batch(
+        const mungefs_batch& _batch,
+        mungefs_reply&       _reply,
+        const bool           _dry_run = false) {
+        std::lock_guard<std::mutex> lk(update_mutex_);
+        rule_map rules;
+        if (!_batch.replace_all) {
+            rules = rules_;
+        }
+
+        bool valid = true;
+        for (const auto& rule : _batch.rules) {
+            mungefs_rule_status status;
+            status.error = apply_rule(rule, rules, status.message);
+            valid = valid && !status.error;
+            _reply.statuses.push_back(status);
+        }
+
+        if (valid && !_dry_run) {
+            rules_.swap(rules);
+            publish();
+        }
+
+        _reply.applied = valid && !_dry_run;
+        _reply.generation = generation();
+    } // apply_batch
+
+    server_handler() :
+        faults_{std::make_shared<fault_table>()},
+        generation_{1},
+        lookup_epoch_{1} {
         valid_operations_.insert("getattr");
         valid_operations_.insert("readlink");
         valid_operations_.insert("mknod");
@@ -219,27 +356,88 @@ class server_handler {
         valid_operations_.insert("poll");
         valid_operations_.insert("flock");
         valid_operations_.insert("fallocate");
+        valid_operations_.insert("copy_file_range");
+        valid_operations_.insert("lseek");
     }
 
     bool is_valid_method(const std::string& _operation) const {
         return valid_operations_.count(_operation);
     }
 
-    bool check_for_fault(const std::string& _m) {
-        std::lock_guard<std::mutex> lk(fault_mutex_);
-        return fault_map_.find(_m) != fault_map_.end(); 
+    // the operations that can wait in a device queue
+    static bool is_queued_operation(const std::string& _operation) {
+        return "read" == _operation ||
+               "write" == _operation ||
+               "fsync" == _operation ||
+               "fallocate" == _operation ||
+               "copy_file_range" == _operation;
     }
 
-    const fault_descriptor get_fault(const std::string& _m) {
-        std::lock_guard<std::mutex> lk(fault_mutex_);
-        return fault_map_[_m]; 
+    // the first fault set for _operation whose regexp accepts _path and
+    // that _accept takes
+    template <typename F>
+    fault_ptr match_fault(
+        const std::string& _path,
+        const std::string& _operation,
+        F                  _accept) const {
+        auto table = std::atomic_load(&faults_);
+        auto it = table->find(_operation);
+        if (table->end() == it) {
+            return fault_ptr();
+        }
+
+        thread_local std::vector<uint32_t> candidates;
+        const auto& compiled = *it->second;
+        compiled.matcher.candidates(_path, candidates);
+        for (auto i : candidates) {
+            const auto& descr = compiled.rules[i];
+            if ((descr->regexp.empty() ||
+                 std::regex_match(_path, descr->compiled)) &&
+                _accept(descr)) {
+                return descr;
+            }
+        }
+
+        return fault_ptr();
+    }
+
+    // bumped whenever the rules change, so cached lookups can be revalidated
+    uint64_t generation() const {
+        return generation_.load(std::memory_order_acquire);
+    }
+
+    void bump_generation() {
+        generation_.fetch_add(1, std::memory_order_acq_rel);
+        invalidate_lookups();
+    }
+
+    // bumped with the generation and whenever paths move under open
+    // handles, which the generation clients see does not count
+    uint64_t lookup_epoch() const {
+        return lookup_epoch_.load(std::memory_order_acquire);
+    }
+
+    void invalidate_lookups() {
+        lookup_epoch_.fetch_add(1, std::memory_order_acq_rel);
     }
 
     typedef message_broker::data_type data_t;
+
+    // handle one control message, read in place from zmq's buffer, and
+    // fill in the reply to send back
     void process_message(
-        data_t& _msg) {
+        const zmq::message_t& _msg,
+        data_t&               _reply) {
+        uint8_t type = 0;
+        if (get_message_type(_msg, type)) {
+            process_framed_message(type, _msg, _reply);
+            return;
+        }
+
+        // the original protocol, acknowledged whatever the outcome
+        _reply = ACK_MSG;
         auto in = avro::memoryInputStream(
-                      &_msg[0],
+                      static_cast<const uint8_t*>(_msg.data()),
                       _msg.size());
         auto dec = avro::binaryDecoder();
         dec->init( *in );
@@ -259,95 +457,653 @@ class server_handler {
             ctl.corrupt_size);
     } // process_message
 
+    void process_framed_message(
+        const uint8_t         _type,
+        const zmq::message_t& _msg,
+        data_t&               _reply) {
+        if (SCENARIO_MSG_TYPE == _type) {
+            process_scenario_message(_msg, _reply);
+            return;
+        }
+
+        if (STATS_MSG_TYPE == _type) {
+            mungefs_stats stats;
+            get_stats(stats);
+            _reply = encode_message(STATS_REPLY_MSG_TYPE, stats);
+            return;
+        }
+
+        if (JOURNAL_MSG_TYPE == _type) {
+            process_journal_message(_msg, _reply);
+            return;
+        }
+
+        if (SNAPSHOT_MSG_TYPE == _type) {
+            process_snapshot_message(_msg, _reply);
+            return;
+        }
+
+        if (POWER_MSG_TYPE == _type) {
+            process_power_message(_msg, _reply);
+            return;
+        }
+
+        mungefs_reply reply;
+        reply.applied = false;
+        reply.generation = generation();
+
+        try {
+            if (BATCH_MSG_TYPE == _type) {
+                mungefs_batch batch;
+                decode_message(_msg, batch);
+                apply_batch(batch, reply);
+            }
+            else {
+                mungefs_rule_status status;
+                status.error = -ENOTSUP;
+                status.message = std::string("unknown message type [") +
+                                 static_cast<char>(_type) + "]";
+                reply.statuses.push_back(status);
+            }
+        }
+        catch(const std::exception& _e) {
+            mungefs_rule_status status;
+            status.error = -EBADMSG;
+            status.message = std::string("failed to decode message - ") + _e.what();
+            reply.statuses.push_back(status);
+        }
+
+        _reply = encode_message(REPLY_MSG_TYPE, reply);
+    } // process_framed_message
+
+    void process_scenario_message(
+        const zmq::message_t& _msg,
+        data_t&               _reply) {
+        mungefs_scenario_status status;
+        try {
+            mungefs_scenario_ctl ctl;
+            decode_message(_msg, ctl);
+            if (START_SCENARIO == ctl.command) {
+                status.error = start_scenario(ctl.name, ctl.document, status.message);
+            }
+            else if (STOP_SCENARIO == ctl.command) {
+                stop_scenario();
+            }
+        }
+        catch(const std::exception& _e) {
+            status.error = -EBADMSG;
+            status.message = std::string("failed to decode message - ") + _e.what();
+        }
+
+        // the status comes with every answer, error or not
+        int error = status.error;
+        std::string message = status.message;
+        get_scenario_status(status);
+        status.error = error;
+        status.message = message;
+        _reply = encode_message(SCENARIO_STATUS_MSG_TYPE, status);
+    } // process_scenario_message
+
+    void process_journal_message(
+        const zmq::message_t& _msg,
+        data_t&               _reply) const {
+        mungefs_journal_reply journal;
+        journal.error = 0;
+        journal.next_seq = 0;
+        journal.lost = journal_lost();
+
+        mungefs_journal_request request;
+        try {
+            decode_message(_msg, request);
+        }
+        catch(const std::exception& _e) {
+            journal.error = -EBADMSG;
+            journal.message = std::string("failed to decode message - ") + _e.what();
+            _reply = encode_message(JOURNAL_REPLY_MSG_TYPE, journal);
+            return;
+        }
+
+        // keep a reply to a few hundred kilobytes
+        static const int max_events = 1024;
+        const size_t count = request.max_events > 0 && request.max_events < max_events ?
+                             request.max_events : max_events;
+
+        std::vector<journal_event> events;
+        journal.next_seq = read_journal(std::max<int64_t>(request.after_seq, 0), count, events);
+        for (const auto& e : events) {
+            mungefs_journal_event je;
+            je.seq = e.seq;
+            je.mono_ns = e.mono_ns;
+            je.wall_ns = e.wall_ns;
+            je.rule_id = e.rule_id;
+            je.pid = e.pid;
+            je.operation = e.operation;
+            je.path = e.path;
+            je.err_no = e.err_no;
+            je.delay_us = e.delay_us;
+            je.corrupted = (e.flags & JOURNAL_CORRUPTED) != 0;
+            je.killed = (e.flags & JOURNAL_KILLED) != 0;
+            je.truncated = (e.flags & JOURNAL_TRUNCATED) != 0;
+            journal.events.push_back(je);
+        }
+
+        _reply = encode_message(JOURNAL_REPLY_MSG_TYPE, journal);
+    } // process_journal_message
+
+    // answered once the snapshot is taken or the reset done, which holds
+    // up other control messages until then
+    void process_snapshot_message(
+        const zmq::message_t& _msg,
+        data_t&               _reply) {
+        mungefs_snapshot_status status;
+        try {
+            mungefs_snapshot_ctl ctl;
+            decode_message(_msg, ctl);
+            if (TAKE_SNAPSHOT == ctl.command) {
+                status.error = take_snapshot(ctl.root, ctl.store, status.message);
+            }
+            else if (RESET_SNAPSHOT == ctl.command) {
+                status.error = reset_to_snapshot(status.message);
+            }
+            else if (DROP_SNAPSHOT == ctl.command) {
+                status.error = drop_snapshot(status.message);
+            }
+        }
+        catch(const std::exception& _e) {
+            status.error = -EBADMSG;
+            status.message = std::string("failed to decode message - ") + _e.what();
+        }
+
+        snapshot_info info;
+        get_snapshot_info(info);
+        status.active = info.active;
+        status.root = info.root;
+        status.store = info.store;
+        status.epoch = info.epoch;
+        status.entries = info.entries;
+        status.cloned = info.cloned;
+        status.copied = info.copied;
+        status.changed = info.changed;
+        status.last_reset_us = info.last_reset_us;
+        status.last_reset_paths = info.last_reset_paths;
+        _reply = encode_message(SNAPSHOT_STATUS_MSG_TYPE, status);
+    } // process_snapshot_message
+
+    void process_power_message(
+        const zmq::message_t& _msg,
+        data_t&               _reply) {
+        mungefs_power_status status;
+        try {
+            mungefs_power_ctl ctl;
+            decode_message(_msg, ctl);
+            if (CUT_POWER == ctl.command) {
+                status.error = power_cut(
+                                   TEAR_UNSYNCED == ctl.mode ? power_cut_mode::tear : power_cut_mode::discard,
+                                   status.message);
+            }
+        }
+        catch(const std::exception& _e) {
+            status.error = -EBADMSG;
+            status.message = std::string("failed to decode message - ") + _e.what();
+        }
+
+        powerloss_info info;
+        get_powerloss_info(info);
+        status.enabled = info.enabled;
+        status.cycle = info.cycle;
+        status.files = info.files;
+        status.ranges = info.ranges;
+        status.unsynced_bytes = info.unsynced_bytes;
+        status.widened = info.widened;
+        status.last_cut_files = info.last_cut_files;
+        status.last_cut_lost_bytes = info.last_cut_lost_bytes;
+        status.last_cut_kept_bytes = info.last_cut_kept_bytes;
+        status.last_cut_truncated_bytes = info.last_cut_truncated_bytes;
+        status.last_cut_failed = info.last_cut_failed;
+        status.last_cut_us = info.last_cut_us;
+        _reply = encode_message(POWER_STATUS_MSG_TYPE, status);
+    } // process_power_message
+
+    // the counters of every fault in the published table
+    void get_stats(mungefs_stats& _stats) const {
+        _stats.generation = generation();
+        auto table = std::atomic_load(&faults_);
+        for (const auto& entry : *table) {
+            const auto& rules = entry.second->rules;
+            for (size_t i = 0; i < rules.size(); ++i) {
+                mungefs_rule_stats rs;
+                rs.id = rules[i]->id;
+                rs.operation = entry.first;
+                rs.position = i;
+                rs.regexp = rules[i]->regexp;
+                rs.calls = rules[i]->calls.load(std::memory_order_relaxed);
+                rs.fires = rules[i]->fires.load(std::memory_order_relaxed);
+                rs.queue_depth = rules[i]->queue_depth;
+                rs.in_flight = rules[i]->queue ? rules[i]->queue->in_flight() : 0;
+                rs.queued = rules[i]->queued.load(std::memory_order_relaxed);
+                rs.queue_waits = rules[i]->queue_waits.load(std::memory_order_relaxed);
+                rs.queue_wait_us = rules[i]->queue_wait_us.load(std::memory_order_relaxed);
+                rs.queue_wait_max_us = rules[i]->queue_wait_max_us.load(std::memory_order_relaxed);
+                _stats.rules.push_back(rs);
+            }
+        }
+    } // get_stats
+
 private:
+    // validate _rule and apply it to _table, returning 0 or -errno
+    int apply_rule(
+        const mungefs_rule& _rule,
+        rule_map&           _rules,
+        std::string&        _message) const {
+        if (_rule.operations.empty()) {
+            _message = "no operations given";
+            return -EINVAL;
+        }
+
+        for (const auto& op : _rule.operations) {
+            if (!is_valid_method(op)) {
+                _message = "unknown operation [" + op + "]";
+                return -EINVAL;
+            }
+        }
+
+        if (CLEAR_FAULT == _rule.action) {
+            for (const auto& op : _rule.operations) {
+                _rules.erase(op);
+            }
+
+            return 0;
+        }
+
+        if (_rule.err_no < 0 || _rule.probability < 0 ||
+            _rule.delay_us < 0 || _rule.delay_us > INT32_MAX) {
+            _message = "err_no, probability and delay_us must be positive";
+            return -EINVAL;
+        }
+
+        if (_rule.skip_first < 0 || _rule.every_nth < 0 || _rule.max_fires < 0 ||
+            _rule.active_after_us < 0 || _rule.active_for_us < 0) {
+            _message = "trigger counts and times must be positive";
+            return -EINVAL;
+        }
+
+        if (_rule.pid < 0 || (_rule.pid_tree && !_rule.pid)) {
+            _message = "pid_tree needs a pid";
+            return -EINVAL;
+        }
+
+        if (_rule.queue_depth < 0) {
+            _message = "queue_depth must be positive";
+            return -EINVAL;
+        }
+
+        // a place in the queue is held until the operation is done, which
+        // only the data operations are written to do
+        if (_rule.queue_depth) {
+            for (const auto& op : _rule.operations) {
+                if (!is_queued_operation(op)) {
+                    _message = "queue_depth does not apply to [" + op + "]";
+                    return -EINVAL;
+                }
+            }
+        }
+
+        auto descr = std::make_shared<fault_descriptor>();
+        descr->random       = _rule.random;
+        descr->err_no       = _rule.err_no;
+        descr->probability  = _rule.probability;
+        descr->regexp       = _rule.regexp;
+        descr->kill_caller  = _rule.kill_caller;
+        descr->delay_us     = _rule.delay_us;
+        descr->auto_delay   = _rule.auto_delay;
+        descr->corrupt_data = _rule.corrupt_data;
+        descr->corrupt_size = _rule.corrupt_size;
+        descr->skip_first      = _rule.skip_first;
+        descr->every_nth       = _rule.every_nth;
+        descr->max_fires       = _rule.max_fires;
+        descr->active_after_us = _rule.active_after_us;
+        descr->active_for_us   = _rule.active_for_us;
+        descr->pid             = _rule.pid;
+        descr->pid_tree        = _rule.pid_tree;
+        descr->uid             = _rule.uid;
+        descr->gid             = _rule.gid;
+        descr->comm            = _rule.comm;
+        descr->queue_depth     = _rule.queue_depth;
+        if (_rule.queue_depth) {
+            descr->queue = std::make_shared<fifo_semaphore>(_rule.queue_depth);
+        }
+        descr->set_key();
+
+        if(!_rule.regexp.empty()) {
+            try {
+                descr->compiled = std::regex(_rule.regexp);
+            }
+            catch(const std::regex_error& _e) {
+                _message = "invalid regexp [" + _rule.regexp + "] - " + _e.what();
+                return -EINVAL;
+            }
+        }
+
+        for (const auto& op : _rule.operations) {
+            if (ADD_FAULT == _rule.action) {
+                _rules[op].push_back(descr);
+            }
+            else {
+                _rules[op] = rule_list{descr};
+            }
+        }
+
+        return 0;
+    } // apply_rule
+
+    // compile rules_ into a new table, caller holds the update mutex.
+    // readers load the table without locking, so it is never modified
+    // once published. the generation moves after the table does.
+    void publish() {
+        auto current = std::atomic_load(&faults_);
+        auto table = std::make_shared<fault_table>();
+        for (const auto& entry : rules_) {
+            if (entry.second.empty()) {
+                continue;
+            }
+
+            // operations whose rules did not change keep their index
+            auto it = current->find(entry.first);
+            if (current->end() != it && it->second->rules == entry.second) {
+                (*table)[entry.first] = it->second;
+                continue;
+            }
+
+            std::vector<std::string> patterns;
+            for (const auto& descr : entry.second) {
+                patterns.push_back(descr->regexp);
+            }
+
+            auto compiled = std::make_shared<compiled_rules>();
+            compiled->rules = entry.second;
+            compiled->matcher = path_matcher(patterns);
+            (*table)[entry.first] = compiled;
+        }
+
+        std::atomic_store(&faults_, fault_table_ptr(table));
+        bump_generation();
+    }
+
     std::set<std::string>                   valid_operations_;
-    std::map<std::string, fault_descriptor> fault_map_;
-    std::mutex                              fault_mutex_;
+    rule_map                                rules_;
+    fault_table_ptr                         faults_;
+    std::mutex                              update_mutex_;
+    std::atomic<uint64_t>                   generation_;
+    std::atomic<uint64_t>                   lookup_epoch_;
 }; // class server_handler
 
 static server_handler static_server_instance;
 
-// return a random err_no
-static int get_random_err_no() {
+// return a random err_no, or the one _draw picks when seeded
+static int get_random_err_no(const fault_draw* _draw) {
+    if (_draw) {
+        return E2BIG + static_cast<int>(_draw->err_no % (EXFULL - E2BIG + 1));
+    }
+
     std::random_device rd;
     std::uniform_int_distribution<int> dist(E2BIG, EXFULL);
     return dist(rd);
 } // get_random_err_no
 
 // return true if random number is not in the probability
-static bool check_for_random_fault(int _probability) {
-    std::random_device rd;
-    std::uniform_int_distribution<int> dist(1, 100000);
-
+static bool check_for_random_fault(int _probability, const fault_draw* _draw) {
     if (!_probability) {
         return false;
     }
 
-    if (dist(rd) > _probability) {
+    int value = 0;
+    if (_draw) {
+        value = 1 + static_cast<int>(_draw->fire % 100000);
+    }
+    else {
+        std::random_device rd;
+        std::uniform_int_distribution<int> dist(1, 100000);
+        value = dist(rd);
+    }
+
+    if (value > _probability) {
         return true;
     }
     
     return false;
 } // check_for_random_fault
 
-// return an err_no if we must proceed to error injection
-static int evaluate_fault_for_operation_impl(
-    const std::string&                _path,
-    const std::string&                _operation,
-    server_handler::fault_descriptor& _descr) {
-    int err_no = 0;
+// the process behind the current fuse request, looked up on first use
+struct caller_context {
+    bool  loaded;
+    pid_t pid;
+    uid_t uid;
+    gid_t gid;
 
-    try {
-        if (!static_server_instance.check_for_fault(_operation)) {
-            return 0;
-        }
+    caller_context() : loaded{false}, pid{0}, uid{0}, gid{0} {
+    }
+};
 
-        _descr = static_server_instance.get_fault(_operation);
-        // randomly skip the fault evaluation
-        if(check_for_random_fault(_descr.probability)) {
-            return 0;
-        }
+// return true if the caller filters of the fault accept the caller
+static bool check_caller(
+    const fault_descriptor& _descr,
+    caller_context&         _caller) {
+    if (!_descr.filters_caller()) {
+        return true;
+    }
 
-        if(!_descr.regexp.empty()) {
-            std::regex r(_descr.regexp);
-            if (!std::regex_match(_path, r)) {
-                return 0;
-            }
+    if (!_caller.loaded) {
+        struct fuse_context* context = fuse_get_context();
+        if (!context) {
+            return false;
         }
 
-        if(_descr.err_no) {
-            err_no = _descr.err_no;
-        }
-        else if(_descr.random) {
-            err_no = get_random_err_no();
-        }
+        // fuse reports the calling thread while rules name its process,
+        // 0 once that exited so it matches no pid and no comm
+        _caller.pid = thread_group(context->pid);
+        _caller.uid = context->uid;
+        _caller.gid = context->gid;
+        _caller.loaded = true;
+    }
 
-        uint32_t delay = 0;
-        if (_descr.delay_us) {
-            delay = _descr.delay_us;
-        }
+    if ((_descr.uid >= 0 && _descr.uid != _caller.uid) ||
+        (_descr.gid >= 0 && _descr.gid != _caller.gid)) {
+        return false;
+    }
 
-        if (_descr.auto_delay) {
-            // FIXME currently a no-op?
-            delay = 0;
-        }
+    if (_descr.pid &&
+        !(_descr.pid_tree ? is_descendant(_caller.pid, _descr.pid) :
+                            _descr.pid == _caller.pid)) {
+        return false;
+    }
 
-        if (delay) {
-            std::this_thread::sleep_for(
-                std::chrono::microseconds(delay));
-        }
+    return _descr.comm.empty() || _descr.comm == process_name(_caller.pid);
+} // check_caller
 
-        if (_descr.kill_caller) {
-            static struct fuse_context *context;
-            context = fuse_get_context();
-            kill(context->pid, SIGKILL);
-            return 0;
+// find the first fault set for _operation whose regexp accepts _path and
+// whose caller filters accept the current caller
+static server_handler::fault_ptr match_fault(
+    const std::string& _path,
+    const std::string& _operation) {
+    caller_context caller;
+    return static_server_instance.match_fault(
+               _path,
+               _operation,
+               [&caller](const server_handler::fault_ptr& _descr) {
+                   return check_caller(*_descr, caller);
+               });
+} // match_fault
+
+// return true if the time window of the fault excludes now
+static bool check_for_inactive_fault(const fault_descriptor& _descr) {
+    if (!_descr.active_after_us && !_descr.active_for_us) {
+        return false;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::steady_clock::now() - _descr.installed).count();
+    if (elapsed < _descr.active_after_us) {
+        return true;
+    }
+
+    return _descr.active_for_us &&
+           elapsed >= _descr.active_after_us + _descr.active_for_us;
+} // check_for_inactive_fault
+
+// return true if the call counter says this call is let through
+static bool check_for_counted_fault(const fault_descriptor& _descr) {
+    // counted whether or not a trigger needs it, for the stats
+    const int64_t call = _descr.calls.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (call <= _descr.skip_first) {
+        return true;
+    }
+
+    return _descr.every_nth && (call - _descr.skip_first) % _descr.every_nth;
+} // check_for_counted_fault
+
+// return true if the fault has fired as often as it may
+static bool check_for_spent_fault(const fault_descriptor& _descr) {
+    if (!_descr.max_fires) {
+        _descr.fires.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // only count fires that happen, so the counter stops at max_fires
+    int64_t fired = _descr.fires.load(std::memory_order_relaxed);
+    do {
+        if (fired >= _descr.max_fires) {
+            return true;
         }
+    } while (!_descr.fires.compare_exchange_weak(fired, fired + 1, std::memory_order_relaxed));
+
+    return false;
+} // check_for_spent_fault
+
+static bool corrupts_operation(
+    const fault_descriptor& _descr,
+    const std::string&      _operation) {
+    if(_descr.corrupt_data &&
+       ("write" == _operation || 
+        "read"  == _operation ||
+        "copy_file_range" == _operation)) {
+        return true;
+    }
+
+    if(_descr.corrupt_size && 
+       "getattr"  == _operation) {
+        return true;
     }
-    catch(const std::out_of_range& _e) {
-        err_log << __FUNCTION__ 
-                << " operation is not in the fault map ["
-                << _operation << "]" << std::endl; 
+
+    return false;
+} // corrupts_operation
+
+// wait for a place in the queue of the fault, which _slot keeps until the
+// operation is done
+static void enter_fault_queue(
+    const fault_descriptor& _descr,
+    queue_slot&             _slot) {
+    const int64_t wait_us = _descr.queue->acquire();
+    _slot.hold(_descr.queue);
+
+    _descr.queued.fetch_add(1, std::memory_order_relaxed);
+    if (!wait_us) {
+        return;
+    }
+
+    _descr.queue_waits.fetch_add(1, std::memory_order_relaxed);
+    _descr.queue_wait_us.fetch_add(wait_us, std::memory_order_relaxed);
+    int64_t max = _descr.queue_wait_max_us.load(std::memory_order_relaxed);
+    while (wait_us > max &&
+           !_descr.queue_wait_max_us.compare_exchange_weak(max, wait_us, std::memory_order_relaxed)) {
+    }
+} // enter_fault_queue
+
+// return an err_no if we must proceed to error injection, and when not, set
+// _corrupt_flag if the data must be corrupted. a null _corrupt_flag means
+// the caller corrupts nothing. a null _slot means the operation is not one
+// that queues. every fault that fires goes to the journal.
+static int evaluate_fault_for_operation_impl(
+    const fault_descriptor& _descr,
+    const std::string&      _path,
+    const std::string&      _operation,
+    bool*                   _corrupt_flag,
+    queue_slot*             _slot) {
+    int err_no = 0;
+
+    if(check_for_inactive_fault(_descr)) {
+        return 0;
+    }
+
+    // every active call is counted on its path, so the k-th call draws the
+    // same values however calls on other paths interleave with it
+    fault_draw draw;
+    const fault_draw* seeded = nullptr;
+    if(fault_seeded()) {
+        draw = draw_fault(_descr.key, _operation, _path, _descr.invocations);
+        seeded = &draw;
+    }
+
+    // every active call queues, whether the fault then fires or not, and
+    // an injected delay keeps its place busy like a slow device would
+    if(_descr.queue && _slot && !_slot->held()) {
+        enter_fault_queue(_descr, *_slot);
+    }
+
+    if(check_for_counted_fault(_descr)) {
+        return 0;
+    }
+
+    // randomly skip the fault evaluation
+    if(check_for_random_fault(_descr.probability, seeded)) {
+        return 0;
+    }
+
+    if(check_for_spent_fault(_descr)) {
+        return 0;
+    }
+
+    if(_descr.err_no) {
+        err_no = _descr.err_no;
+    }
+    else if(_descr.random) {
+        err_no = get_random_err_no(seeded);
+    }
+
+    uint32_t delay = 0;
+    if (_descr.delay_us) {
+        delay = _descr.delay_us;
+    }
+
+    if (_descr.auto_delay) {
+        // FIXME currently a no-op?
+        delay = 0;
+    }
+
+    if (delay) {
+        std::this_thread::sleep_for(
+            std::chrono::microseconds(delay));
+    }
+
+    uint32_t flags = 0;
+    if (_descr.kill_caller) {
+        err_no = 0;
+        flags |= JOURNAL_KILLED;
+    }
+
+    if (!err_no && _corrupt_flag && corrupts_operation(_descr, _operation)) {
+        *_corrupt_flag = true;
+        flags |= JOURNAL_CORRUPTED;
+    }
+
+    // a fault that only queues did nothing worth journaling
+    struct fuse_context *context = fuse_get_context();
+    if (err_no || delay || flags) {
+        journal_fault(_descr.id, context->pid, _operation, _path, err_no, delay, flags);
+    }
+
+    if (_descr.kill_caller) {
+        kill(context->pid, SIGKILL);
+        return 0;
     }
 
     return -err_no;
@@ -356,76 +1112,141 @@ static int evaluate_fault_for_operation_impl(
 
 int evaluate_fault_for_operation(
     const std::string& _path,
-    const std::string& _operation) {
+    const std::string& _operation,
+    queue_slot*        _slot) {
 
-    server_handler::fault_descriptor fd;
-    return evaluate_fault_for_operation_impl(
-               _path,
-               _operation,
-               fd);
+    auto descr = match_fault(_path, _operation);
+    if (!descr) {
+        return 0;
+    }
+
+    return evaluate_fault_for_operation_impl(*descr, _path, _operation, nullptr, _slot);
 } // evaluate_fault_for_operation
 
 int evaluate_fault_for_operation(
     const std::string& _path,
     const std::string& _operation,
-    bool&              _corrupt_flag) {
+    bool&              _corrupt_flag,
+    queue_slot*        _slot) {
     _corrupt_flag = false;
 
-    server_handler::fault_descriptor fd;
-    int err = evaluate_fault_for_operation_impl(
-                 _path,
-                 _operation,
-                 fd);
-    if(err) {
-        return err;
+    auto descr = match_fault(_path, _operation);
+    if (!descr) {
+        return 0;
     }
 
-    if(fd.corrupt_data &&
-       ("write" == _operation || 
-        "read"  == _operation)) {
-        _corrupt_flag = true;
-    }
+    return evaluate_fault_for_operation_impl(*descr, _path, _operation, &_corrupt_flag, _slot);
+} // evaluate_fault_for_operation
 
-    if(fd.corrupt_size && 
-       "getattr"  == _operation) {
-        _corrupt_flag = true;
+void apply_fault_batch(const mungefs_batch& _batch, mungefs_reply& _reply) {
+    static_server_instance.apply_batch(_batch, _reply);
+} // apply_fault_batch
+
+void check_fault_batch(const mungefs_batch& _batch, mungefs_reply& _reply) {
+    static_server_instance.apply_batch(_batch, _reply, true);
+} // check_fault_batch
+
+uint64_t resolved_fault_epoch() {
+    return static_server_instance.lookup_epoch();
+} // resolved_fault_epoch
+
+void invalidate_resolved_faults() {
+    static_server_instance.invalidate_lookups();
+} // invalidate_resolved_faults
+
+std::shared_ptr<const resolved_fault> resolve_fault(
+    const std::string& _path,
+    const std::string& _operation) {
+    auto resolved = std::make_shared<resolved_fault>();
+    resolved->epoch = resolved_fault_epoch();
+    resolved->path = _path;
+
+    // the caller changes from call to call, so keep every fault matching
+    // the path up to the first one without caller filters
+    static_server_instance.match_fault(
+        _path,
+        _operation,
+        [&resolved](const server_handler::fault_ptr& _descr) {
+            resolved->faults.push_back(_descr);
+            return !_descr->filters_caller();
+        });
+    return resolved;
+} // resolve_fault
+
+int evaluate_resolved_fault(
+    const resolved_fault& _resolved,
+    const std::string&    _operation,
+    bool&                 _corrupt_flag,
+    queue_slot*           _slot) {
+    _corrupt_flag = false;
+
+    caller_context caller;
+    for (const auto& descr : _resolved.faults) {
+        if (!check_caller(*descr, caller)) {
+            continue;
+        }
+
+        return evaluate_fault_for_operation_impl(
+                   *descr, _resolved.path, _operation, &_corrupt_flag, _slot);
     }
 
     return 0;
-} // evaluate_fault_for_operation
+} // evaluate_resolved_fault
 
-void server_thread_executor() {
+void server_thread_executor(const std::string& _endpoint) {
     try {
         typedef message_broker::data_type data_t;
         message_broker bro("ZMQ_REP");
-        bro.bind("tcp://*:9000");
-
-        bool exit_flg = false;
-        while(!exit_flg) {
-            data_t msg;
-            bro.receive(msg, ZMQ_DONTWAIT, true);
-            if(msg.size() > 0) {
-                if(QUIT_MSG == msg) {
-                    bro.send(ACK_MSG);
-                    exit_flg = true;
-                    break;
-                } // if quit
-
-                static_server_instance.process_message(msg);
+        bro.bind(_endpoint);
+        log_message("listening on " + _endpoint);
+
+        // block in zmq until a message arrives, the receive timeout only
+        // brings the loop round again
+        while(true) {
+            zmq::message_t msg;
+            if(!bro.receive(msg)) {
+                continue;
+            }
+
+            if(msg.size() == QUIT_MSG.size() &&
+               std::equal(QUIT_MSG.begin(), QUIT_MSG.end(), static_cast<const uint8_t*>(msg.data()))) {
                 bro.send(ACK_MSG);
+                break;
+            } // if quit
+
+            // a rep socket has to answer before it can receive again, so a
+            // message that fails to decode is still acknowledged
+            data_t reply;
+            try {
+                static_server_instance.process_message(msg, reply);
+            }
+            catch( const std::exception& _e) {
+                MUNGEFS_LOG(log_level::warning, "failed to decode control message [%s]", _e.what());
+                reply = ACK_MSG;
+            }
 
-            } // if msg
+            try {
+                bro.send(std::move(reply));
+            }
+            catch( const message_broker::exception& _e) {
+                MUNGEFS_LOG(log_level::warning, "failed to reply [%s]", _e.what());
+            }
         } // while
     }
     catch( const message_broker::exception& _e) {
-        err_log << __FUNCTION__ << " [" << _e.what() << "]" << std::endl;
+        MUNGEFS_LOG(log_level::error, "%s [%s]", __FUNCTION__, _e.what());
     }
 } // server_thread_executor
 
 static std::unique_ptr<std::thread> static_server_thread;
-void start_server_thread() {
-    err_log.open("/tmp/mungefs_log.txt", std::fstream::in|std::fstream::out|std::fstream::app);
-    static_server_thread = std::make_unique<std::thread>(server_thread_executor);
+static std::string static_server_endpoint;
+void start_server_thread(const std::string& _endpoint) {
+    message_broker::reporter() = [](const char* _what) {
+        MUNGEFS_LOG(log_level::error, "control socket [%s]", _what);
+    };
+
+    static_server_endpoint = _endpoint;
+    static_server_thread = std::make_unique<std::thread>(server_thread_executor, _endpoint);
 } // start_server_thread
 
 void stop_server_thread() {
@@ -433,18 +1254,17 @@ void stop_server_thread() {
     try {
         typedef message_broker::data_type data_t;
         message_broker bro("ZMQ_REQ");
-        bro.connect("tcp://localhost:9000");
+        bro.connect(connect_endpoint(static_server_endpoint));
         bro.send(QUIT_MSG);
         
         data_t rcv_msg;
         bro.receive(rcv_msg);
     }
     catch( const message_broker::exception& _e) {
-        err_log << __FUNCTION__ << " [" << _e.what() << "]" << std::endl;
+        MUNGEFS_LOG(log_level::error, "%s [%s]", __FUNCTION__, _e.what());
     }
     
     static_server_thread->join();
-    err_log.close();
 
 } // stop_server_thread
 
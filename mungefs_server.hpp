@@ -2,15 +2,59 @@
 #ifndef MUNGEFS_SERVER_HPP
 #define MUNGEFS_SERVER_HPP
 
+#include <memory>
 #include <string>
+#include <vector>
+
+#include <stdint.h>
+
+struct fault_descriptor;
+struct mungefs_batch;
+struct mungefs_reply;
+class queue_slot;
+
+// a fault with a queue_depth makes the operation wait for a place in its
+// queue, kept in _slot until the slot goes out of scope. without a _slot
+// the operation does not queue.
 int evaluate_fault_for_operation(
     const std::string& _path,
-    const std::string& _operation);
+    const std::string& _operation,
+    queue_slot*        _slot = nullptr);
 int evaluate_fault_for_operation(
     const std::string& _path,
     const std::string& _operation,
-    bool&              _corrupt_flag);
-void start_server_thread();
+    bool&              _corrupt_flag,
+    queue_slot*        _slot = nullptr);
+
+// a rule lookup cached by an open handle, stale once the epoch moves with
+// a rule change or a rename.
+// holds the faults matching the path in order, up to the first one that
+// applies to every caller.
+struct resolved_fault {
+    uint64_t                                             epoch;
+    std::string                                          path;
+    std::vector<std::shared_ptr<const fault_descriptor>> faults;
+};
+
+uint64_t resolved_fault_epoch();
+void invalidate_resolved_faults();
+std::shared_ptr<const resolved_fault> resolve_fault(
+    const std::string& _path,
+    const std::string& _operation);
+int evaluate_resolved_fault(
+    const resolved_fault& _resolved,
+    const std::string&    _operation,
+    bool&                 _corrupt_flag,
+    queue_slot*           _slot = nullptr);
+
+// apply a batch of rules as one update, as if sent over the control socket
+void apply_fault_batch(const mungefs_batch& _batch, mungefs_reply& _reply);
+
+// report what apply_fault_batch would say about a batch, changing nothing
+void check_fault_batch(const mungefs_batch& _batch, mungefs_reply& _reply);
+
+// serve control messages on the zmq _endpoint, a tcp:// or ipc:// address
+void start_server_thread(const std::string& _endpoint);
 void stop_server_thread();
 
 #endif // MUNGEFS_SERVER_HPP
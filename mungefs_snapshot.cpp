@@ -0,0 +1,813 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+#include "mungefs_log.hpp"
+#include "mungefs_memfs.hpp"
+#include "mungefs_prefetch.hpp"
+#include "mungefs_snapshot.hpp"
+#include "mungefs_writeback.hpp"
+
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
+std::atomic<uint64_t> snapshot_epoch_counter(0);
+
+typedef std::vector<std::pair<std::string, std::string>> xattr_list;
+
+// what a path held when the snapshot was taken
+struct snapshot_entry {
+    mode_t          mode;
+    uid_t           uid;
+    gid_t           gid;
+    dev_t           rdev;
+    struct timespec atime;
+    struct timespec mtime;
+    uint64_t        id;      // of a regular file, names it in the store
+    std::string     target;  // of a symbolic link
+    xattr_list      xattrs;
+};
+
+// a regular file of the snapshot, under every name it had
+struct snapshot_file {
+    ino_t                    ino;        // of the backing file holding it now
+    bool                     preserved;  // the store has its content
+    std::vector<std::string> paths;
+};
+
+struct snapshot_state {
+    std::string                           root;
+    std::string                           store;
+    dev_t                                 dev;
+    std::map<std::string, snapshot_entry> entries;  // by path below root, "" for root
+    std::vector<snapshot_file>            files;    // by id
+    std::unordered_map<ino_t, uint64_t>   inodes;   // backing inode to id
+
+    // guards the rest, which operations change while holding the
+    // snapshot mutex shared
+    std::mutex                            mutex;
+    std::map<std::string, bool>           changed;  // path to whether a subtree moved
+    uint64_t                              cloned;
+    uint64_t                              copied;
+    uint64_t                              last_reset_us;
+    uint64_t                              last_reset_paths;
+};
+
+static std::shared_timed_mutex         static_snapshot_mutex;
+static std::unique_ptr<snapshot_state> static_snapshot;
+static std::atomic<uint64_t>           static_reset_epoch(0);
+
+std::shared_timed_mutex& snapshot_mutex() {
+    return static_snapshot_mutex;
+} // snapshot_mutex
+
+static std::string full_path(const snapshot_state& _s, const std::string& _rel) {
+    return _rel.empty() ? _s.root : _s.root + "/" + _rel;
+} // full_path
+
+static std::string child_path(const std::string& _rel, const char* _name) {
+    return _rel.empty() ? std::string(_name) : _rel + "/" + _name;
+} // child_path
+
+static std::string store_path(const snapshot_state& _s, uint64_t _id) {
+    return _s.store + "/" + std::to_string(_id);
+} // store_path
+
+// the path below the root _path names, false if it is not below it
+static bool relative_path(const snapshot_state& _s, const char* _path, std::string& _rel) {
+    const size_t n = _s.root.size();
+    if (!_path || 0 != strncmp(_path, _s.root.c_str(), n) ||
+        ('\0' != _path[n] && '/' != _path[n])) {
+        return false;
+    }
+
+    _rel = _path[n] ? _path + n + 1 : "";
+    return true;
+} // relative_path
+
+static xattr_list read_xattrs(const std::string& _path) {
+    xattr_list xattrs;
+    ssize_t size = llistxattr(_path.c_str(), nullptr, 0);
+    if (size <= 0) {
+        return xattrs;
+    }
+
+    std::vector<char> names(size);
+    size = llistxattr(_path.c_str(), names.data(), names.size());
+    for (ssize_t off = 0; off < size; off += strlen(names.data() + off) + 1) {
+        const char* name = names.data() + off;
+        ssize_t length = lgetxattr(_path.c_str(), name, nullptr, 0);
+        if (length < 0) {
+            continue;
+        }
+
+        std::string value(length, '\0');
+        length = lgetxattr(_path.c_str(), name, &value[0], value.size());
+        if (length >= 0) {
+            value.resize(length);
+            xattrs.emplace_back(name, value);
+        }
+    }
+
+    return xattrs;
+} // read_xattrs
+
+static int copy_data(int _in, int _out) {
+    // the kernel may share or copy the extents itself
+    while (true) {
+        ssize_t n = copy_file_range(_in, nullptr, _out, nullptr, 1 << 30, 0);
+        if (0 == n) {
+            return 0;
+        }
+
+        if (n < 0) {
+            if (EXDEV != errno && ENOSYS != errno && EINVAL != errno && EOPNOTSUPP != errno) {
+                return -errno;
+            }
+
+            break;
+        }
+    }
+
+    // the file offsets moved past whatever was copied already
+    char buf[64 * 1024];
+    while (true) {
+        ssize_t n = read(_in, buf, sizeof(buf));
+        if (n <= 0) {
+            return n < 0 ? -errno : 0;
+        }
+
+        for (ssize_t done = 0; done < n;) {
+            ssize_t w = write(_out, buf + done, n - done);
+            if (w < 0) {
+                return -errno;
+            }
+
+            done += w;
+        }
+    }
+} // copy_data
+
+// put the content of _from in the new file _to, reflinked if the file
+// system allows, copied otherwise when _copy is set
+static int clone_file(const std::string& _from, const std::string& _to, bool _copy) {
+    int in = open(_from.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (in < 0) {
+        return -errno;
+    }
+
+    int out = open(_to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (out < 0) {
+        int err = errno;
+        close(in);
+        return -err;
+    }
+
+    int ret = 0;
+    if (ioctl(out, FICLONE, in) < 0) {
+        ret = _copy ? copy_data(in, out) : -errno;
+    }
+
+    close(in);
+    close(out);
+    if (ret) {
+        unlink(_to.c_str());
+    }
+
+    return ret;
+} // clone_file
+
+// remove _path and anything below it, dropping what the prefetch cache
+// holds of the files
+static void remove_tree(const std::string& _path) {
+    struct stat st;
+    if (lstat(_path.c_str(), &st) < 0) {
+        return;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        if (DIR* d = opendir(_path.c_str())) {
+            while (struct dirent* de = readdir(d)) {
+                if (strcmp(de->d_name, ".") && strcmp(de->d_name, "..")) {
+                    remove_tree(_path + "/" + de->d_name);
+                }
+            }
+            closedir(d);
+        }
+
+        if (rmdir(_path.c_str()) < 0) {
+            MUNGEFS_LOG(log_level::error, "snapshot reset failed to remove %s [%s]", _path.c_str(), strerror(errno));
+        }
+
+        return;
+    }
+
+    if (unlink(_path.c_str()) < 0) {
+        MUNGEFS_LOG(log_level::error, "snapshot reset failed to remove %s [%s]", _path.c_str(), strerror(errno));
+        return;
+    }
+
+    if (S_ISREG(st.st_mode)) {
+        prefetch_invalidate(st.st_dev, st.st_ino, 0, 0);
+    }
+} // remove_tree
+
+// record _rel and everything below it, reflinking regular files into the
+// store until the file system turns out not to support it
+static int record_tree(
+    snapshot_state&    _s,
+    const std::string& _rel,
+    const struct stat& _st,
+    bool&              _reflink) {
+    const std::string path = full_path(_s, _rel);
+    snapshot_entry e;
+    e.mode = _st.st_mode;
+    e.uid = _st.st_uid;
+    e.gid = _st.st_gid;
+    e.rdev = _st.st_rdev;
+    e.atime = _st.st_atim;
+    e.mtime = _st.st_mtim;
+    e.id = 0;
+    e.xattrs = read_xattrs(path);
+    if (S_ISLNK(_st.st_mode)) {
+        char target[PATH_MAX];
+        ssize_t n = readlink(path.c_str(), target, sizeof(target));
+        if (n < 0) {
+            return -errno;
+        }
+
+        e.target.assign(target, n);
+    }
+    else if (S_ISREG(_st.st_mode)) {
+        auto known = _s.inodes.find(_st.st_ino);
+        if (known != _s.inodes.end()) {
+            e.id = known->second;
+            _s.files[e.id].paths.push_back(_rel);
+        }
+        else {
+            e.id = _s.files.size();
+            _s.files.push_back(snapshot_file{_st.st_ino, false, {_rel}});
+            _s.inodes[_st.st_ino] = e.id;
+            int ret = _reflink ? clone_file(path, store_path(_s, e.id), false) : -EOPNOTSUPP;
+            if (!ret) {
+                _s.files[e.id].preserved = true;
+                ++_s.cloned;
+            }
+            else if (-EOPNOTSUPP == ret || -EXDEV == ret || -EINVAL == ret || -ENOTTY == ret) {
+                _reflink = false;
+            }
+            else {
+                MUNGEFS_LOG(log_level::warning, "snapshot could not reflink %s [%s], copying it when it changes",
+                            path.c_str(), strerror(-ret));
+            }
+        }
+    }
+
+    _s.entries.emplace(_rel, std::move(e));
+    if (!S_ISDIR(_st.st_mode)) {
+        return 0;
+    }
+
+    DIR* d = opendir(path.c_str());
+    if (!d) {
+        return -errno;
+    }
+
+    int ret = 0;
+    while (struct dirent* de = readdir(d)) {
+        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) {
+            continue;
+        }
+
+        const std::string rel = child_path(_rel, de->d_name);
+        struct stat st;
+        if (lstat(full_path(_s, rel).c_str(), &st) < 0) {
+            ret = -errno;
+            break;
+        }
+
+        if (st.st_dev != _s.dev) {
+            MUNGEFS_LOG(log_level::warning, "snapshot skips mount point %s", full_path(_s, rel).c_str());
+            continue;
+        }
+
+        ret = record_tree(_s, rel, st, _reflink);
+        if (ret) {
+            break;
+        }
+    }
+
+    closedir(d);
+    return ret;
+} // record_tree
+
+// keep the content of the snapshot's file at _path before it changes, with
+// the state's mutex held
+static void preserve_file(snapshot_state& _s, const char* _path, const struct stat& _st) {
+    auto known = _s.inodes.find(_st.st_ino);
+    if (_st.st_dev != _s.dev || known == _s.inodes.end()) {
+        return;
+    }
+
+    snapshot_file& f = _s.files[known->second];
+    if (f.preserved) {
+        return;
+    }
+
+    int ret = clone_file(_path, store_path(_s, known->second), true);
+    if (ret) {
+        MUNGEFS_LOG(log_level::error, "snapshot failed to keep %s, a reset cannot restore it [%s]",
+                    _path, strerror(-ret));
+        return;
+    }
+
+    f.preserved = true;
+    ++_s.copied;
+} // preserve_file
+
+static void preserve_tree(snapshot_state& _s, const std::string& _path) {
+    DIR* d = opendir(_path.c_str());
+    if (!d) {
+        return;
+    }
+
+    while (struct dirent* de = readdir(d)) {
+        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) {
+            continue;
+        }
+
+        const std::string path = _path + "/" + de->d_name;
+        struct stat st;
+        if (lstat(path.c_str(), &st) < 0) {
+            continue;
+        }
+
+        if (S_ISREG(st.st_mode)) {
+            preserve_file(_s, path.c_str(), st);
+        }
+        else if (S_ISDIR(st.st_mode)) {
+            preserve_tree(_s, path);
+        }
+    }
+
+    closedir(d);
+} // preserve_tree
+
+// _st is what _path holds now, null if nothing
+static void note_change(const char* _path, const struct stat* _st, unsigned _flags) {
+    snapshot_state* s = static_snapshot.get();
+    std::string rel;
+    if (!s || !relative_path(*s, _path, rel)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lk(s->mutex);
+    const bool moves_tree = _st && S_ISDIR(_st->st_mode) && (_flags & SNAPSHOT_SUBTREE);
+    if (_st && (_flags & SNAPSHOT_CONTENT)) {
+        if (S_ISREG(_st->st_mode)) {
+            preserve_file(*s, _path, *_st);
+        }
+        else if (moves_tree) {
+            preserve_tree(*s, _path);
+        }
+    }
+
+    bool& subtree = s->changed[rel];
+    subtree = subtree || moves_tree;
+} // note_change
+
+void note_snapshot_change(const char* _path, unsigned _flags) {
+    if (!static_snapshot) {
+        return;
+    }
+
+    struct stat st;
+    note_change(_path, 0 == lstat(_path, &st) ? &st : nullptr, _flags);
+} // note_snapshot_change
+
+int snapshot_catch_up(
+    const char*            _path,
+    int                    _fd,
+    std::atomic<uint64_t>& _epoch,
+    bool                   _modifies) {
+    if (_epoch.load(std::memory_order_relaxed) < static_reset_epoch.load(std::memory_order_acquire)) {
+        return -ESTALE;
+    }
+
+    if (!_modifies) {
+        return 0;
+    }
+
+    const uint64_t epoch = snapshot_epoch();
+    if (_epoch.load(std::memory_order_relaxed) < static_reset_epoch.load(std::memory_order_relaxed)) {
+        return -ESTALE;
+    }
+
+    // the file may have been renamed or unlinked since it was opened
+    struct stat st;
+    if (_fd >= 0 && 0 == fstat(_fd, &st)) {
+        note_change(_path, &st, SNAPSHOT_CONTENT);
+    }
+
+    _epoch.store(epoch, std::memory_order_relaxed);
+    return 0;
+} // snapshot_catch_up
+
+static bool is_empty_directory(const std::string& _path) {
+    DIR* d = opendir(_path.c_str());
+    if (!d) {
+        return false;
+    }
+
+    bool empty = true;
+    while (struct dirent* de = readdir(d)) {
+        empty = empty && (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."));
+    }
+
+    closedir(d);
+    return empty;
+} // is_empty_directory
+
+// remove the store and what is in it, with the snapshot mutex held
+static void drop_locked() {
+    if (!static_snapshot) {
+        return;
+    }
+
+    const std::string& store = static_snapshot->store;
+    for (size_t id = 0; id < static_snapshot->files.size(); ++id) {
+        unlink(store_path(*static_snapshot, id).c_str());
+    }
+
+    rmdir(store.c_str());
+    static_snapshot.reset();
+} // drop_locked
+
+int take_snapshot(const std::string& _root, const std::string& _store, std::string& _message) {
+    if (memfs_enabled()) {
+        _message = "memfs has no backing directory to snapshot";
+        return -ENOTSUP;
+    }
+
+    // paths are matched as fuse passes them, so the root is kept as given
+    std::string root = _root;
+    while (root.size() > 1 && '/' == root.back()) {
+        root.pop_back();
+    }
+
+    const std::string store = _store.empty() ? root + ".mungefs_snapshot" : _store;
+    if (root.size() < 2 || '/' != root[0] || '/' != store[0]) {
+        _message = "the root and store must be absolute paths below /";
+        return -EINVAL;
+    }
+
+    if (0 == store.compare(0, root.size(), root) &&
+        (store.size() == root.size() || '/' == store[root.size()])) {
+        _message = "the store cannot be inside the root";
+        return -EINVAL;
+    }
+
+    std::unique_lock<std::shared_timed_mutex> lk(static_snapshot_mutex);
+    drop_locked();
+
+    // writes made before the snapshot reach the files before they are kept
+    flush_all_write_buffers();
+
+    struct stat st;
+    if (lstat(root.c_str(), &st) < 0) {
+        int err = errno;
+        _message = "cannot snapshot [" + root + "]";
+        return -err;
+    }
+
+    if (!S_ISDIR(st.st_mode)) {
+        _message = "cannot snapshot [" + root + "]";
+        return -ENOTDIR;
+    }
+
+    if (mkdir(store.c_str(), 0700) < 0 && !(EEXIST == errno && is_empty_directory(store))) {
+        _message = "the store [" + store + "] must be missing or empty";
+        return -EEXIST;
+    }
+
+    const auto started = std::chrono::steady_clock::now();
+    std::unique_ptr<snapshot_state> s(new snapshot_state);
+    s->root = root;
+    s->store = store;
+    s->dev = st.st_dev;
+    s->cloned = 0;
+    s->copied = 0;
+    s->last_reset_us = 0;
+    s->last_reset_paths = 0;
+
+    bool reflink = true;
+    int ret = record_tree(*s, "", st, reflink);
+    static_snapshot = std::move(s);
+    if (ret) {
+        drop_locked();
+        _message = std::string("failed to record [") + root + "] - " + strerror(-ret);
+        return ret;
+    }
+
+    // handles open now keep their files before changing them
+    snapshot_epoch_counter.fetch_add(1, std::memory_order_release);
+
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - started).count();
+    _message = std::to_string(static_snapshot->entries.size()) + " entries, " +
+               std::to_string(static_snapshot->cloned) + " files reflinked" +
+               (reflink ? "" : ", the rest copied when first changed") +
+               " in " + std::to_string(us) + "us";
+    MUNGEFS_LOG(log_level::info, "snapshot of %s in %s: %s", root.c_str(), store.c_str(), _message.c_str());
+    return 0;
+} // take_snapshot
+
+static void restore_attributes(const std::string& _path, const snapshot_entry& _e) {
+    // ownership first, changing it clears the set-id bits
+    if (lchown(_path.c_str(), _e.uid, _e.gid) < 0 && EPERM != errno) {
+        MUNGEFS_LOG(log_level::warning, "snapshot reset failed to chown %s [%s]", _path.c_str(), strerror(errno));
+    }
+
+    if (!S_ISLNK(_e.mode)) {
+        chmod(_path.c_str(), _e.mode & 07777);
+    }
+
+    const xattr_list now = read_xattrs(_path);
+    for (const auto& x : now) {
+        bool kept = false;
+        for (const auto& want : _e.xattrs) {
+            kept = kept || want.first == x.first;
+        }
+
+        if (!kept) {
+            lremovexattr(_path.c_str(), x.first.c_str());
+        }
+    }
+
+    for (const auto& x : _e.xattrs) {
+        lsetxattr(_path.c_str(), x.first.c_str(), x.second.data(), x.second.size(), 0);
+    }
+
+    const struct timespec times[2] = {_e.atime, _e.mtime};
+    utimensat(AT_FDCWD, _path.c_str(), times, AT_SYMLINK_NOFOLLOW);
+} // restore_attributes
+
+// add everything below _rel there is now to _paths
+static void list_tree(const snapshot_state& _s, const std::string& _rel, std::set<std::string>& _paths) {
+    DIR* d = opendir(full_path(_s, _rel).c_str());
+    if (!d) {
+        return;
+    }
+
+    while (struct dirent* de = readdir(d)) {
+        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) {
+            continue;
+        }
+
+        const std::string rel = child_path(_rel, de->d_name);
+        _paths.insert(rel);
+        struct stat st;
+        if (DT_DIR == de->d_type ||
+            (DT_UNKNOWN == de->d_type && 0 == lstat(full_path(_s, rel).c_str(), &st) && S_ISDIR(st.st_mode))) {
+            list_tree(_s, rel, _paths);
+        }
+    }
+
+    closedir(d);
+} // list_tree
+
+// a path that still holds what the snapshot had there stays, only its
+// attributes are put back
+static bool keeps(const snapshot_state& _s, const snapshot_entry& _e, const struct stat& _st) {
+    if (S_ISDIR(_e.mode) && S_ISDIR(_st.st_mode)) {
+        return true;
+    }
+
+    return S_ISREG(_e.mode) && S_ISREG(_st.st_mode) &&
+           _s.files[_e.id].ino == _st.st_ino && !_s.files[_e.id].preserved;
+} // keeps
+
+static int restore_entry(
+    snapshot_state&                   _s,
+    const snapshot_entry&             _e,
+    const std::string&                _path,
+    std::map<uint64_t, std::string>& _restored) {
+    if (S_ISDIR(_e.mode)) {
+        return mkdir(_path.c_str(), 0700) < 0 ? -errno : 0;
+    }
+
+    if (S_ISLNK(_e.mode)) {
+        return symlink(_e.target.c_str(), _path.c_str()) < 0 ? -errno : 0;
+    }
+
+    if (!S_ISREG(_e.mode)) {
+        return mknod(_path.c_str(), _e.mode, _e.rdev) < 0 ? -errno : 0;
+    }
+
+    // the other names of a hard linked file link to the first one restored
+    auto linked = _restored.find(_e.id);
+    if (linked != _restored.end()) {
+        return link(linked->second.c_str(), _path.c_str()) < 0 ? -errno : 0;
+    }
+
+    snapshot_file& f = _s.files[_e.id];
+    if (!f.preserved) {
+        // changed or removed behind mungefs' back
+        return -ENOENT;
+    }
+
+    int ret = clone_file(store_path(_s, _e.id), _path, true);
+    struct stat st;
+    if (ret || lstat(_path.c_str(), &st) < 0) {
+        return ret ? ret : -errno;
+    }
+
+    _s.inodes.erase(f.ino);
+    f.ino = st.st_ino;
+    _s.inodes[f.ino] = _e.id;
+    _restored[_e.id] = _path;
+    return 0;
+} // restore_entry
+
+int reset_to_snapshot(std::string& _message) {
+    std::unique_lock<std::shared_timed_mutex> lk(static_snapshot_mutex);
+    if (!static_snapshot) {
+        _message = "no snapshot";
+        return -ENOENT;
+    }
+
+    // nothing buffered may land on top of what is restored
+    flush_all_write_buffers();
+
+    // every handle open until now goes stale
+    static_reset_epoch.store(
+        snapshot_epoch_counter.fetch_add(1, std::memory_order_acq_rel) + 1,
+        std::memory_order_release);
+
+    const auto started = std::chrono::steady_clock::now();
+    snapshot_state& s = *static_snapshot;
+
+    // the paths changed, and below a directory that moved everything the
+    // snapshot had there and everything there is now
+    std::set<std::string> paths;
+    for (const auto& c : s.changed) {
+        paths.insert(c.first);
+        if (!c.second) {
+            continue;
+        }
+
+        const std::string prefix = c.first + "/";
+        for (auto it = s.entries.lower_bound(prefix);
+             it != s.entries.end() && 0 == it->first.compare(0, prefix.size(), prefix);
+             ++it) {
+            paths.insert(it->first);
+        }
+
+        list_tree(s, c.first, paths);
+    }
+
+    // a hard linked file is restored under all of its names or none
+    std::vector<std::string> linked;
+    for (const auto& rel : paths) {
+        auto e = s.entries.find(rel);
+        if (e != s.entries.end() && S_ISREG(e->second.mode) && s.files[e->second.id].paths.size() > 1) {
+            const auto& names = s.files[e->second.id].paths;
+            linked.insert(linked.end(), names.begin(), names.end());
+        }
+    }
+    paths.insert(linked.begin(), linked.end());
+
+    // a path sorts after its parent, so going backwards removes children
+    // first and going forwards creates parents first
+    for (auto it = paths.rbegin(); it != paths.rend(); ++it) {
+        const std::string path = full_path(s, *it);
+        struct stat st;
+        if (lstat(path.c_str(), &st) < 0) {
+            continue;
+        }
+
+        auto e = s.entries.find(*it);
+        if (e == s.entries.end() || !keeps(s, e->second, st)) {
+            remove_tree(path);
+        }
+    }
+
+    size_t failed = 0;
+    std::map<uint64_t, std::string> restored;
+    for (const auto& rel : paths) {
+        auto e = s.entries.find(rel);
+        if (e == s.entries.end()) {
+            continue;
+        }
+
+        const std::string path = full_path(s, rel);
+        struct stat st;
+        if (0 == lstat(path.c_str(), &st)) {
+            if (S_ISREG(st.st_mode)) {
+                restored.emplace(e->second.id, path);
+            }
+
+            continue;
+        }
+
+        int ret = restore_entry(s, e->second, path, restored);
+        if (ret) {
+            ++failed;
+            MUNGEFS_LOG(log_level::error, "snapshot reset failed to restore %s [%s]", path.c_str(), strerror(-ret));
+        }
+    }
+
+    // attributes last and children before parents, adding an entry
+    // changes the times of the directory it is in
+    std::set<std::string> attributes(paths);
+    for (const auto& rel : paths) {
+        std::string parent = rel;
+        for (size_t slash; std::string::npos != (slash = parent.rfind('/'));) {
+            parent.resize(slash);
+            if (!attributes.insert(parent).second) {
+                break;
+            }
+        }
+    }
+    attributes.insert("");
+
+    for (auto it = attributes.rbegin(); it != attributes.rend(); ++it) {
+        auto e = s.entries.find(*it);
+        if (e != s.entries.end()) {
+            restore_attributes(full_path(s, *it), e->second);
+        }
+    }
+
+    s.changed.clear();
+    s.last_reset_paths = paths.size();
+    s.last_reset_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - started).count();
+    _message = "reset " + std::to_string(paths.size()) + " paths in " +
+               std::to_string(s.last_reset_us) + "us";
+    if (failed) {
+        _message += ", " + std::to_string(failed) + " could not be restored";
+    }
+
+    MUNGEFS_LOG(log_level::info, "snapshot of %s %s", s.root.c_str(), _message.c_str());
+    return failed ? -EIO : 0;
+} // reset_to_snapshot
+
+int drop_snapshot(std::string& _message) {
+    std::unique_lock<std::shared_timed_mutex> lk(static_snapshot_mutex);
+    _message = static_snapshot ? "dropped" : "no snapshot";
+    drop_locked();
+    return 0;
+} // drop_snapshot
+
+void get_snapshot_info(snapshot_info& _info) {
+    snapshot_guard guard(static_snapshot_mutex);
+    _info.active = static_cast<bool>(static_snapshot);
+    _info.epoch = snapshot_epoch();
+    _info.entries = _info.cloned = _info.copied = _info.changed = 0;
+    _info.last_reset_us = _info.last_reset_paths = 0;
+    _info.root.clear();
+    _info.store.clear();
+    if (!static_snapshot) {
+        return;
+    }
+
+    snapshot_state& s = *static_snapshot;
+    std::lock_guard<std::mutex> lk(s.mutex);
+    _info.root = s.root;
+    _info.store = s.store;
+    _info.entries = s.entries.size();
+    _info.cloned = s.cloned;
+    _info.copied = s.copied;
+    _info.changed = s.changed.size();
+    _info.last_reset_us = s.last_reset_us;
+    _info.last_reset_paths = s.last_reset_paths;
+} // get_snapshot_info
+
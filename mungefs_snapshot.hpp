@@ -0,0 +1,86 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_SNAPSHOT_HPP
+#define MUNGEFS_SNAPSHOT_HPP
+
+#include <atomic>
+#include <shared_mutex>
+#include <string>
+
+#include <stdint.h>
+
+// a snapshot records the tree below a backing directory so it can later be
+// put back the way it was. regular files are reflinked into a store
+// directory when the file system can; when it cannot, a file is copied into
+// the store just before mungefs first changes it. a reset only visits the
+// paths changed through the mount since the last one, so it costs what the
+// test iteration touched rather than what the tree holds. changes made to
+// the backing directory behind mungefs' back are not undone.
+//
+// every reset advances the epoch. file and directory handles opened before
+// it refer to files that may no longer be there, so they fail with ESTALE
+// from then on, except for release.
+
+struct snapshot_info {
+    bool        active;
+    std::string root;
+    std::string store;
+    uint64_t    epoch;
+    uint64_t    entries;           // files, directories and links recorded
+    uint64_t    cloned;            // files reflinked when it was taken
+    uint64_t    copied;            // files copied before their first change
+    uint64_t    changed;           // paths changed since the last reset
+    uint64_t    last_reset_us;
+    uint64_t    last_reset_paths;  // paths the last reset visited
+};
+
+// replaces the snapshot there is. _store may be empty for _root plus
+// ".mungefs_snapshot", and must be empty or missing.
+int take_snapshot(const std::string& _root, const std::string& _store, std::string& _message);
+int reset_to_snapshot(std::string& _message);
+int drop_snapshot(std::string& _message);
+void get_snapshot_info(snapshot_info& _info);
+
+// held shared by an operation that changes the backing tree or opens a
+// file, from before it notes the change until it is done, so a snapshot or
+// reset never runs in the middle of one
+std::shared_timed_mutex& snapshot_mutex();
+
+typedef std::shared_lock<std::shared_timed_mutex> snapshot_guard;
+
+static const unsigned SNAPSHOT_CONTENT = 1 << 0;  // data or xattrs change
+static const unsigned SNAPSHOT_SUBTREE = 1 << 1;  // a directory moves
+
+// note that _path is about to change, keeping its content first if need be
+void note_snapshot_change(const char* _path, unsigned _flags);
+
+// advanced by every snapshot and reset, and remembered by open handles
+extern std::atomic<uint64_t> snapshot_epoch_counter;
+
+inline uint64_t snapshot_epoch() {
+    return snapshot_epoch_counter.load(std::memory_order_acquire);
+}
+
+// for a handle whose epoch is behind: -ESTALE if a reset came since it was
+// opened. otherwise a snapshot was taken since, and a handle about to
+// change its file has the file kept first and is brought up to date.
+// when _modifies the caller holds a snapshot_guard until its change is
+// written, or a snapshot could be taken between the two and miss it.
+int snapshot_catch_up(
+    const char*            _path,
+    int                    _fd,
+    std::atomic<uint64_t>& _epoch,
+    bool                   _modifies);
+
+#endif // MUNGEFS_SNAPSHOT_HPP
+
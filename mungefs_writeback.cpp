@@ -0,0 +1,400 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <thread>
+
+#include <fcntl.h>
+
+#include "mungefs_direct.hpp"
+#include "mungefs_handle.hpp"
+#include "mungefs_io.hpp"
+#include "mungefs_options.hpp"
+#include "mungefs_powerloss.hpp"
+#include "mungefs_prefetch.hpp"
+#include "mungefs_writeback.hpp"
+
+// threshold flushes stop at a multiple of this so the backing writes
+// stay page aligned, the unaligned tail waits for the next write
+static const off_t flush_alignment = 4096;
+
+// periodically flushes buffers that have held data for too long
+class write_flusher {
+public:
+    write_flusher() : stop_{false} {
+    }
+
+    void start(std::chrono::milliseconds _max_age) {
+        max_age_ = _max_age;
+        stop_ = false;
+        thread_ = std::make_unique<std::thread>(&write_flusher::run, this);
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            stop_ = true;
+        }
+
+        cv_.notify_all();
+        if (thread_) {
+            thread_->join();
+            thread_.reset();
+        }
+    }
+
+    void watch(mungefs_file_handle* _handle) {
+        std::lock_guard<std::mutex> lk(mutex_);
+        handles_.insert(_handle);
+    }
+
+    // once this returns the flusher will not touch _handle again
+    void forget(mungefs_file_handle* _handle) {
+        std::unique_lock<std::mutex> lk(mutex_);
+        handles_.erase(_handle);
+        idle_cv_.wait(lk, [&] { return !busy_.count(_handle); });
+    }
+
+    bool flush_file(dev_t _dev, ino_t _ino);
+    void flush_all();
+
+private:
+    void run();
+
+    // mark the handles _pick chooses busy, so they can be flushed without
+    // holding mutex_ and forget waits for them. each is given back by done.
+    template <typename Pick>
+    std::vector<mungefs_file_handle*> claim(Pick _pick) {
+        std::vector<mungefs_file_handle*> claimed;
+        std::lock_guard<std::mutex> lk(mutex_);
+        for (auto h : handles_) {
+            if (_pick(*h)) {
+                claimed.push_back(h);
+                busy_.insert(h);
+            }
+        }
+
+        return claimed;
+    }
+
+    void done(mungefs_file_handle* _handle) {
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            busy_.erase(busy_.find(_handle));
+        }
+
+        idle_cv_.notify_all();
+    }
+
+    bool                                 stop_;
+    std::chrono::milliseconds            max_age_;
+    std::mutex                           mutex_;
+    std::condition_variable              cv_;
+    std::condition_variable              idle_cv_;
+    std::set<mungefs_file_handle*>       handles_;
+    std::multiset<mungefs_file_handle*>  busy_;
+    std::unique_ptr<std::thread>         thread_;
+}; // class write_flusher
+
+static write_flusher static_write_flusher;
+
+// write the first _len buffered bytes, caller holds a power_cycle_guard
+// and then the buffer mutex. on failure everything buffered is dropped, as a failed writeback would.
+static int flush_locked(
+    mungefs_file_handle& _handle,
+    size_t               _len,
+    bool                 _sync = false,
+    bool                 _datasync = false) {
+    auto& wb = _handle.writeback;
+    if (!_len) {
+        return 0;
+    }
+
+    // buffered data of a handle that outlived a power cut went with it
+    if (powered_off_since(_handle.power_cycle)) {
+        wb.data.clear();
+        return -EIO;
+    }
+
+    ssize_t written = _sync ?
+        backing_pwrite_and_sync(_handle.fd, wb.data.data(), _len, wb.offset, _datasync) :
+        backing_pwrite(_handle.fd, wb.data.data(), _len, wb.offset);
+    prefetch_invalidate(_handle.dev, _handle.ino, wb.offset, _len);
+
+    if (written < 0 || static_cast<size_t>(written) < _len) {
+        wb.data.clear();
+        return written < 0 ? written : -EIO;
+    }
+
+    if (!_sync) {
+        note_written(_handle.unsynced, wb.offset, _len, false);
+    }
+
+    wb.data.erase(wb.data.begin(), wb.data.begin() + _len);
+    wb.offset += _len;
+    wb.first_write = std::chrono::steady_clock::now();
+    return 0;
+} // flush_locked
+
+// write out everything _handle has buffered, keeping a failure for its
+// next call. returns true if anything was written.
+static bool flush_buffered(mungefs_file_handle& _handle) {
+    auto& wb = _handle.writeback;
+    power_cycle_guard power(power_cycle_mutex());
+    std::lock_guard<std::mutex> lk(wb.mutex);
+    if (wb.data.empty()) {
+        return false;
+    }
+
+    int err = flush_locked(_handle, wb.data.size());
+    if (err && !wb.error) {
+        wb.error = err;
+    }
+
+    return true;
+} // flush_buffered
+
+// hand back a deferred error exactly once
+static int take_error_locked(write_buffer& _wb) {
+    int err = _wb.error;
+    _wb.error = 0;
+    return err;
+} // take_error_locked
+
+void write_flusher::run() {
+    std::unique_lock<std::mutex> lk(mutex_);
+    while (!stop_) {
+        cv_.wait_for(lk, max_age_ / 2);
+        if (stop_) {
+            break;
+        }
+
+        lk.unlock();
+        const auto now = std::chrono::steady_clock::now();
+        auto due = claim([&](mungefs_file_handle& _h) {
+            // a worker holding the buffer will flush it anyway
+            auto& wb = _h.writeback;
+            std::unique_lock<std::mutex> wlk(wb.mutex, std::try_to_lock);
+            return wlk.owns_lock() && !wb.data.empty() && now - wb.first_write >= max_age_;
+        });
+
+        for (auto h : due) {
+            flush_buffered(*h);
+            done(h);
+        }
+
+        lk.lock();
+    }
+} // write_flusher::run
+
+bool write_flusher::flush_file(dev_t _dev, ino_t _ino) {
+    bool flushed = false;
+    auto claimed = claim([&](const mungefs_file_handle& _h) {
+        return _h.dev == _dev && _h.ino == _ino;
+    });
+
+    for (auto h : claimed) {
+        flushed = flush_buffered(*h) || flushed;
+        done(h);
+    }
+
+    return flushed;
+} // write_flusher::flush_file
+
+void write_flusher::flush_all() {
+    auto claimed = claim([](const mungefs_file_handle&) { return true; });
+    for (auto h : claimed) {
+        flush_buffered(*h);
+        done(h);
+    }
+} // write_flusher::flush_all
+
+void start_write_coalescing() {
+    const auto& opts = get_mungefs_options();
+    if (!opts.write_buffer_kb) {
+        return;
+    }
+
+    static_write_flusher.start(
+        std::chrono::milliseconds(std::max(2u, opts.write_buffer_ms)));
+} // start_write_coalescing
+
+void stop_write_coalescing() {
+    static_write_flusher.stop();
+} // stop_write_coalescing
+
+bool write_coalescing_enabled() {
+    return 0 != get_mungefs_options().write_buffer_kb;
+} // write_coalescing_enabled
+
+void init_write_buffer(mungefs_file_handle& _handle, int _flags) {
+    auto& wb = _handle.writeback;
+    if (!get_mungefs_options().write_buffer_kb) {
+        return;
+    }
+
+    // appends ignore the offset and synchronous files promise the data is
+    // on disk when write returns, neither can be deferred. checksums are
+    // kept of what the backing file holds, so their writes are not either.
+    if (_handle.crc ||
+        (_flags & O_ACCMODE) == O_RDONLY ||
+        (_flags & (O_APPEND | O_SYNC | O_DSYNC | O_DIRECT))) {
+        return;
+    }
+
+    wb.enabled = true;
+    wb.limit = static_cast<size_t>(get_mungefs_options().write_buffer_kb) * 1024;
+    static_write_flusher.watch(&_handle);
+} // init_write_buffer
+
+ssize_t write_through(
+    mungefs_file_handle& _handle,
+    const char*          _buf,
+    size_t               _size,
+    off_t                _offset) {
+    ssize_t ret = _handle.direct ?
+        direct_pwrite(_handle, _buf, _size, _offset) :
+        backing_pwrite(_handle.fd, _buf, _size, _offset);
+    prefetch_invalidate(_handle.dev, _handle.ino, _offset, _size);
+    if (ret > 0) {
+        note_written(_handle.unsynced, _offset, ret, _handle.sync_writes);
+    }
+
+    return ret;
+} // write_through
+
+ssize_t coalesce_write(
+    mungefs_file_handle& _handle,
+    const char*          _buf,
+    size_t               _size,
+    off_t                _offset) {
+    auto& wb = _handle.writeback;
+    power_cycle_guard power(power_cycle_mutex());
+    if (powered_off_since(_handle.power_cycle)) {
+        return -EIO;
+    }
+
+    if (!wb.enabled) {
+        return write_through(_handle, _buf, _size, _offset);
+    }
+
+    std::lock_guard<std::mutex> lk(wb.mutex);
+    if (int err = take_error_locked(wb)) {
+        return err;
+    }
+
+    // only a write continuing the buffered range may join it
+    if (!wb.data.empty() &&
+        wb.offset + static_cast<off_t>(wb.data.size()) != _offset) {
+        if (int err = flush_locked(_handle, wb.data.size())) {
+            return err;
+        }
+    }
+
+    // nothing to gain from copying a write that fills the buffer by itself
+    if (wb.data.empty() && _size >= wb.limit) {
+        ssize_t ret = backing_pwrite(_handle.fd, _buf, _size, _offset);
+        prefetch_invalidate(_handle.dev, _handle.ino, _offset, _size);
+        if (ret > 0) {
+            note_written(_handle.unsynced, _offset, ret, false);
+        }
+
+        return ret;
+    }
+
+    // reserved by the first buffered write, many handles never write
+    if (wb.data.empty()) {
+        wb.offset = _offset;
+        wb.first_write = std::chrono::steady_clock::now();
+        wb.data.reserve(2 * wb.limit);
+    }
+
+    wb.data.insert(wb.data.end(), _buf, _buf + _size);
+
+    if (wb.data.size() >= wb.limit) {
+        off_t end = wb.offset + wb.data.size();
+        off_t aligned_end = end - (end % flush_alignment);
+        size_t len = aligned_end > wb.offset ? aligned_end - wb.offset : wb.data.size();
+        if (int err = flush_locked(_handle, len)) {
+            return err;
+        }
+    }
+
+    return _size;
+} // coalesce_write
+
+int flush_write_buffer(mungefs_file_handle& _handle) {
+    auto& wb = _handle.writeback;
+    if (!wb.enabled) {
+        return 0;
+    }
+
+    power_cycle_guard power(power_cycle_mutex());
+    std::lock_guard<std::mutex> lk(wb.mutex);
+    if (int err = take_error_locked(wb)) {
+        wb.data.clear();
+        return err;
+    }
+
+    return flush_locked(_handle, wb.data.size());
+} // flush_write_buffer
+
+bool flush_write_buffers(dev_t _dev, ino_t _ino) {
+    return write_coalescing_enabled() && static_write_flusher.flush_file(_dev, _ino);
+} // flush_write_buffers
+
+void flush_all_write_buffers() {
+    if (write_coalescing_enabled()) {
+        static_write_flusher.flush_all();
+    }
+} // flush_all_write_buffers
+
+int flush_write_buffer_and_sync(mungefs_file_handle& _handle, bool _datasync) {
+    auto& wb = _handle.writeback;
+    power_cycle_guard power(power_cycle_mutex());
+    if (powered_off_since(_handle.power_cycle)) {
+        return -EIO;
+    }
+
+    if (wb.enabled) {
+        std::lock_guard<std::mutex> lk(wb.mutex);
+        if (int err = take_error_locked(wb)) {
+            wb.data.clear();
+            return err;
+        }
+
+        // the buffered bytes are written by the sync that covers them
+        if (!wb.data.empty()) {
+            note_written(_handle.unsynced, wb.offset, wb.data.size(), false);
+            const uint64_t token = start_sync(_handle.unsynced);
+            int ret = flush_locked(_handle, wb.data.size(), true, _datasync);
+            finish_sync(_handle.unsynced, token, 0 == ret);
+            return ret;
+        }
+    }
+
+    const uint64_t token = start_sync(_handle.unsynced);
+    int ret = backing_fsync(_handle.fd, _datasync);
+    finish_sync(_handle.unsynced, token, 0 == ret);
+    return ret;
+} // flush_write_buffer_and_sync
+
+void forget_write_buffer(mungefs_file_handle& _handle) {
+    if (_handle.writeback.enabled) {
+        static_write_flusher.forget(&_handle);
+    }
+} // forget_write_buffer
+
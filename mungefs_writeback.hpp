@@ -0,0 +1,85 @@
+/*
+ * ** 19-10-2026
+ * **
+ * ** The author disclaims copyright to this source code.  In place of
+ * ** a legal notice, here is a blessing:
+ * **
+ * **    May you do good and not evil.
+ * **    May you find forgiveness for yourself and forgive others.
+ * **    May you share freely, never taking more than you give.
+ * **
+ */
+
+#ifndef MUNGEFS_WRITEBACK_HPP
+#define MUNGEFS_WRITEBACK_HPP
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include <sys/types.h>
+
+// write-behind buffer for one open file, merging adjacent small writes
+struct write_buffer {
+    std::mutex        mutex;
+    bool              enabled;   // chosen at open from the mount options and flags
+    size_t            limit;     // flush once this much is buffered
+    std::vector<char> data;
+    off_t             offset;    // file offset of data[0]
+    int               error;     // failure of a background flush, not yet reported
+    std::chrono::steady_clock::time_point first_write;
+
+    write_buffer() :
+        enabled{false},
+        limit{0},
+        offset{0},
+        error{0} {
+    }
+};
+
+struct mungefs_file_handle;
+
+void start_write_coalescing();
+void stop_write_coalescing();
+bool write_coalescing_enabled();
+
+// decide whether writes through a handle opened with _flags are buffered
+void init_write_buffer(mungefs_file_handle& _handle, int _flags);
+
+// buffer or write through _size bytes at _offset, returning _size or -errno.
+// unbuffered writes to O_DIRECT handles are aligned as needed.
+// an error from an earlier buffered write is returned instead, once.
+ssize_t coalesce_write(
+    mungefs_file_handle& _handle,
+    const char*          _buf,
+    size_t               _size,
+    off_t                _offset);
+
+// write _size bytes at _offset past the buffer, aligned as needed for an
+// O_DIRECT handle, and note them written. the caller holds a
+// power_cycle_guard and has checked the handle's power cycle.
+ssize_t write_through(
+    mungefs_file_handle& _handle,
+    const char*          _buf,
+    size_t               _size,
+    off_t                _offset);
+
+// write out anything buffered, returning 0 or the first pending error
+int flush_write_buffer(mungefs_file_handle& _handle);
+
+// write out what every handle on the file has buffered, so a stat by path
+// sees its size and a read through any handle sees the data. errors are reported by the handles' next calls. returns
+// true if anything was written.
+bool flush_write_buffers(dev_t _dev, ino_t _ino);
+
+// write out what every handle has buffered, errors as above
+void flush_all_write_buffers();
+
+// as above, then sync the file. the sync is linked to the final write.
+int flush_write_buffer_and_sync(mungefs_file_handle& _handle, bool _datasync);
+
+// stop the background flusher from looking at a handle about to be closed
+void forget_write_buffer(mungefs_file_handle& _handle);
+
+#endif // MUNGEFS_WRITEBACK_HPP
+
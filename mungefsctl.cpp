@@ -1,8 +1,32 @@
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <thread>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "message_broker.hpp"
+#include "mungefs_batch.hpp"
+#include "mungefs_client.hpp"
 #include "mungefs_ctl.hpp"
+#include "mungefs_endpoint.hpp"
+#include "mungefs_protocol.hpp"
+#include "mungefs_reply.hpp"
+#include "mungefs_scenario_ctl.hpp"
+#include "mungefs_scenario_status.hpp"
+#include "mungefs_power_ctl.hpp"
+#include "mungefs_power_status.hpp"
+#include "mungefs_snapshot_ctl.hpp"
+#include "mungefs_snapshot_status.hpp"
 
 #include "boost/program_options.hpp"
 #include "boost/any.hpp"
@@ -51,18 +75,48 @@ int usage(T& _os) {
     _os << "--auto_delay : set delay to simulate ssd" << std::endl;
     _os << "--corrupt_data : corrupt read or write data" << std::endl;
     _os << "--corrupt_size : report an invalid file size" << std::endl;
+    _os << "--skip_first : let the first n matching calls through" << std::endl;
+    _os << "--every_nth : then fire on every nth matching call only" << std::endl;
+    _os << "--max_fires : stop firing after n times" << std::endl;
+    _os << "--active_after_us : stay dormant this long after being set" << std::endl;
+    _os << "--active_for_us : then stay active this long" << std::endl;
+    _os << "--queue_depth : let this many calls be in flight, queue the rest" << std::endl;
+    _os << "--pid : only fault calls made by this process" << std::endl;
+    _os << "--pid_tree : or by any of its descendants" << std::endl;
+    _os << "--uid : only fault calls made by this user" << std::endl;
+    _os << "--gid : only fault calls made by this group" << std::endl;
+    _os << "--comm : only fault calls made by this command name" << std::endl;
+    _os << "--add : append the fault to those the operations already have" << std::endl;
+    _os << "--rules : file of rules, one per line, applied all at once" << std::endl;
+    _os << "--replace_all : with --rules, drop every fault not in the file" << std::endl;
+    _os << "--scenario : start the timeline in a scenario file" << std::endl;
+    _os << "--scenario_stop : stop the running scenario" << std::endl;
+    _os << "--scenario_status : show where the scenario is in its timeline" << std::endl;
+    _os << "--stats : show how often each fault was checked and fired" << std::endl;
+    _os << "--snapshot : record the backing directory given to the subdir module" << std::endl;
+    _os << "--snapshot_store : keep the snapshot's files here, next to the directory by default" << std::endl;
+    _os << "--snapshot_reset : put the backing directory back as it was recorded" << std::endl;
+    _os << "--snapshot_drop : forget the snapshot and remove its store" << std::endl;
+    _os << "--snapshot_status : show the snapshot and what changed since the last reset" << std::endl;
+    _os << "--power_cut : discard or tear what was written and not synced" << std::endl;
+    _os << "--power_status : show how much would be lost and what the last cut lost" << std::endl;
+    _os << "--journal : show the faults that fired, as kept by the mount" << std::endl;
+    _os << "--journal_follow : then keep showing faults as they fire" << std::endl;
+    _os << "--journal_after : start from this sequence number" << std::endl;
+    _os << "--endpoint : control socket of the mount, or set MUNGEFS_ENDPOINT" << std::endl;
+    _os << "--mountpoint : find the control socket from the mountpoint instead" << std::endl;
+    _os << "--stdin : run the commands read from stdin over one connection" << std::endl;
+    _os << "--batch : run the commands in a file over one connection" << std::endl;
     return 1;
 }
 
-int parse_program_options(
-    int          _argc,
-    char*        _argv[],
-    mungefs_ctl& _ctl_out ) {
+// the options describing a single fault, shared by the command line and
+// the lines of a rules file
+boost::program_options::options_description fault_options() {
     namespace po = boost::program_options;
 
-    po::options_description opt_desc( "options" );
+    po::options_description opt_desc( "fault" );
     opt_desc.add_options()
-    ( "help,h", "show command usage" )
     ( "operations", po::value<std::string>(), "list of operations to apply a a fault")
     ( "random", "randomize error injection" )
     ( "err_no", po::value<int>(), "error number to force" )
@@ -72,30 +126,32 @@ int parse_program_options(
     ( "delay_us", po::value<long>(), "delay a method by a given number of microsecods")
     ( "auto_delay", "set delay to simulate ssd" )
     ( "corrupt_data", "corrupt read or write data" )
-    ( "corrupt_size", "report an invalid file size" );
-
-    po::variables_map vm;
-    try {
-        po::store(
-            po::command_line_parser(
-                _argc, _argv ).options(
-                opt_desc ).run(), vm );
-        po::notify( vm );
-    }
-    catch(const po::error& _e ) {
-        std::cerr << std::endl
-                  << "Error: "
-                  << _e.what()
-                  << std::endl
-                  << std::endl;
-        return usage(std::cerr);
-    }
+    ( "corrupt_size", "report an invalid file size" )
+    ( "skip_first", po::value<long>(), "let the first n matching calls through" )
+    ( "every_nth", po::value<long>(), "then fire on every nth matching call only" )
+    ( "max_fires", po::value<long>(), "stop firing after n times" )
+    ( "active_after_us", po::value<long>(), "stay dormant this long after being set" )
+    ( "active_for_us", po::value<long>(), "then stay active this long" )
+    ( "queue_depth", po::value<long>(), "let this many calls be in flight, queue the rest" )
+    ( "pid", po::value<int>(), "only fault calls made by this process" )
+    ( "pid_tree", "or by any of its descendants" )
+    ( "uid", po::value<long>(), "only fault calls made by this user" )
+    ( "gid", po::value<long>(), "only fault calls made by this group" )
+    ( "comm", po::value<std::string>(), "only fault calls made by this command name" )
+    ( "add", "append the fault to those the operations already have" );
+    return opt_desc;
+} // fault_options
 
-    if(vm.count("operations")) {
+// fill a mungefs_ctl or mungefs_rule from parsed fault options
+template <typename T>
+int fill_fault(
+    const boost::program_options::variables_map& _vm,
+    T&                                           _out) {
+    if(_vm.count("operations")) {
         try {
             boost::split(
-                _ctl_out.operations,
-                vm[ "operations" ].as<std::string>(),
+                _out.operations,
+                _vm[ "operations" ].as<std::string>(),
                 boost::is_any_of( ", " ),
                 boost::token_compress_on );
         }
@@ -108,67 +164,922 @@ int parse_program_options(
         return usage(std::cerr);
     }
 
-    _ctl_out.random       = (vm.count("random") > 0);
-    _ctl_out.kill_caller  = (vm.count("kill_caller") > 0);
-    _ctl_out.auto_delay   = (vm.count("auto_delay") > 0);
-    _ctl_out.corrupt_data = (vm.count("corrupt_data") > 0);
-    _ctl_out.corrupt_size = (vm.count("corrupt_size") > 0);
+    _out.random       = (_vm.count("random") > 0);
+    _out.kill_caller  = (_vm.count("kill_caller") > 0);
+    _out.auto_delay   = (_vm.count("auto_delay") > 0);
+    _out.corrupt_data = (_vm.count("corrupt_data") > 0);
+    _out.corrupt_size = (_vm.count("corrupt_size") > 0);
+
+    if(_vm.count("err_no")) {
+        _out.err_no = _vm["err_no"].as<int>();
+    }
+
+    if(_vm.count("probability")) {
+        _out.probability = _vm["probability"].as<long>();
+    }
+
+    if(_vm.count("regexp")) {
+        _out.regexp = _vm["regexp"].as<std::string>();
+    }
+
+    if(_vm.count("delay_us")) {
+        _out.delay_us = _vm["delay_us"].as<long>();
+    }
+
+    return 0;
+} // fill_fault
+
+// fill the triggers and queue depth of a mungefs_rule, the original message
+// has none. returns true if any was given.
+bool fill_triggers(
+    const boost::program_options::variables_map& _vm,
+    mungefs_rule&                                _out) {
+    bool found = false;
+    auto fill = [&](const char* _name, int64_t& _field) {
+        if(_vm.count(_name)) {
+            _field = _vm[_name].as<long>();
+            found = true;
+        }
+    };
+
+    fill("skip_first", _out.skip_first);
+    fill("every_nth", _out.every_nth);
+    fill("max_fires", _out.max_fires);
+    fill("active_after_us", _out.active_after_us);
+    fill("active_for_us", _out.active_for_us);
+    fill("queue_depth", _out.queue_depth);
+    return found;
+} // fill_triggers
+
+// fill the caller filters of a mungefs_rule, by default it applies to
+// every caller. returns true if any was given.
+bool fill_callers(
+    const boost::program_options::variables_map& _vm,
+    mungefs_rule&                                _out) {
+    _out.uid = -1;
+    _out.gid = -1;
+    if(_vm.count("uid")) {
+        _out.uid = _vm["uid"].as<long>();
+    }
+
+    if(_vm.count("gid")) {
+        _out.gid = _vm["gid"].as<long>();
+    }
+
+    if(_vm.count("pid")) {
+        _out.pid = _vm["pid"].as<int>();
+    }
+
+    if(_vm.count("comm")) {
+        _out.comm = _vm["comm"].as<std::string>();
+    }
+
+    _out.pid_tree = (_vm.count("pid_tree") > 0);
+    return _vm.count("uid") || _vm.count("gid") || _vm.count("pid") ||
+           _vm.count("comm") || _out.pid_tree;
+} // fill_callers
+
+// each line of a rules file holds the options of one fault, or --clear
+// and the operations whose faults are removed. blank lines and lines
+// starting with # are skipped.
+int parse_rules_file(
+    const std::string& _path,
+    mungefs_batch&     _batch) {
+    namespace po = boost::program_options;
+
+    std::ifstream in(_path);
+    if(!in) {
+        std::cerr << "failed to open rules file [" << _path << "]" << std::endl;
+        return 1;
+    }
+
+    auto opt_desc = fault_options();
+    opt_desc.add_options()
+    ( "clear", "remove the fault from the operations" );
+
+    std::string line;
+    for(size_t line_no = 1; std::getline(in, line); ++line_no) {
+        boost::trim(line);
+        if(line.empty() || '#' == line[0]) {
+            continue;
+        }
+
+        // no escape character, backslashes belong to the regexps
+        std::vector<std::string> args = po::split_unix(line, " \t", "'\"", "");
+        po::variables_map vm;
+        try {
+            po::store(
+                po::command_line_parser(
+                    args ).options(
+                    opt_desc ).run(), vm );
+            po::notify( vm );
+        }
+        catch(const po::error& _e ) {
+            std::cerr << _path << ":" << line_no << ": " << _e.what() << std::endl;
+            return 1;
+        }
+
+        mungefs_rule rule;
+        rule.action = vm.count("clear") ? CLEAR_FAULT :
+                      vm.count("add")   ? ADD_FAULT   : SET_FAULT;
+        fill_triggers(vm, rule);
+        fill_callers(vm, rule);
+        int err = fill_fault(vm, rule);
+        if(err) {
+            std::cerr << _path << ":" << line_no << ": no operations given" << std::endl;
+            return err;
+        }
+
+        _batch.rules.push_back(rule);
+    }
+
+    return 0;
+} // parse_rules_file
+
+// read a scenario file, mungefs parses it so it need not see the file
+int read_scenario_file(
+    const std::string&    _path,
+    mungefs_scenario_ctl& _scenario) {
+    std::ifstream in(_path);
+    if(!in) {
+        std::cerr << "failed to open scenario file [" << _path << "]" << std::endl;
+        return 1;
+    }
+
+    std::stringstream document;
+    document << in.rdbuf();
+    _scenario.command = START_SCENARIO;
+    _scenario.name = _path;
+    _scenario.document = document.str();
+    return 0;
+} // read_scenario_file
+
+// the control socket to talk to, --endpoint first, then the socket of
+// --mountpoint, then MUNGEFS_ENDPOINT
+int find_endpoint(
+    const boost::program_options::variables_map& _vm,
+    std::string&                                 _endpoint) {
+    if(_vm.count("endpoint")) {
+        _endpoint = connect_endpoint(_vm["endpoint"].as<std::string>());
+        return 0;
+    }
+
+    if(_vm.count("mountpoint")) {
+        _endpoint = default_endpoint(_vm["mountpoint"].as<std::string>());
+        return 0;
+    }
+
+    const char* env = getenv("MUNGEFS_ENDPOINT");
+    if(env && *env) {
+        _endpoint = connect_endpoint(env);
+        return 0;
+    }
+
+    std::cerr << "no mount given, use --endpoint, --mountpoint or set MUNGEFS_ENDPOINT"
+              << std::endl;
+    return 1;
+} // find_endpoint
+
+// the options of one command, on the command line or a line of a stream
+boost::program_options::options_description command_options() {
+    namespace po = boost::program_options;
+
+    po::options_description opt_desc( "command" );
+    opt_desc.add_options()
+    ( "rules", po::value<std::string>(), "file of rules applied all at once" )
+    ( "replace_all", "drop every fault not in the rules file" )
+    ( "scenario", po::value<std::string>(), "start the timeline in a scenario file" )
+    ( "scenario_stop", "stop the running scenario" )
+    ( "scenario_status", "show where the scenario is in its timeline" )
+    ( "stats", "show how often each fault was checked and fired" )
+    ( "snapshot", po::value<std::string>(), "record the backing directory given to the subdir module" )
+    ( "snapshot_store", po::value<std::string>(), "keep the snapshot's files here" )
+    ( "snapshot_reset", "put the backing directory back as it was recorded" )
+    ( "snapshot_drop", "forget the snapshot and remove its store" )
+    ( "snapshot_status", "show the snapshot and what changed since the last reset" )
+    ( "power_cut", po::value<std::string>(), "discard or tear what was written and not synced" )
+    ( "power_status", "show how much would be lost and what the last cut lost" );
+    opt_desc.add(fault_options());
+    return opt_desc;
+} // command_options
+
+// one command to send, msg_type is 0 for a bare mungefs_ctl
+struct command {
+    uint8_t              msg_type;
+    mungefs_ctl          ctl;
+    mungefs_batch        batch;
+    mungefs_scenario_ctl scenario;
+    mungefs_snapshot_ctl snapshot;
+    mungefs_power_ctl    power;
+};
+
+int parse_command(
+    const boost::program_options::variables_map& _vm,
+    command&                                     _cmd) {
+    _cmd.msg_type = STATS_MSG_TYPE;
+    if(_vm.count("stats")) {
+        return 0;
+    }
+
+    _cmd.msg_type = SNAPSHOT_MSG_TYPE;
+    if(_vm.count("snapshot")) {
+        _cmd.snapshot.command = TAKE_SNAPSHOT;
+        _cmd.snapshot.root = _vm["snapshot"].as<std::string>();
+        if(_vm.count("snapshot_store")) {
+            _cmd.snapshot.store = _vm["snapshot_store"].as<std::string>();
+        }
+
+        return 0;
+    }
+
+    if(_vm.count("snapshot_reset") || _vm.count("snapshot_drop") || _vm.count("snapshot_status")) {
+        _cmd.snapshot.command = _vm.count("snapshot_reset") ? RESET_SNAPSHOT :
+                                _vm.count("snapshot_drop")  ? DROP_SNAPSHOT :
+                                                              SNAPSHOT_STATUS;
+        return 0;
+    }
+
+    _cmd.msg_type = POWER_MSG_TYPE;
+    if(_vm.count("power_cut")) {
+        const std::string mode = _vm["power_cut"].as<std::string>();
+        if("discard" != mode && "tear" != mode) {
+            std::cerr << "--power_cut takes discard or tear, not [" << mode << "]" << std::endl;
+            return 1;
+        }
+
+        _cmd.power.command = CUT_POWER;
+        _cmd.power.mode = "tear" == mode ? TEAR_UNSYNCED : DISCARD_UNSYNCED;
+        return 0;
+    }
+
+    if(_vm.count("power_status")) {
+        _cmd.power.command = POWER_STATUS;
+        return 0;
+    }
+
+    _cmd.msg_type = SCENARIO_MSG_TYPE;
+    if(_vm.count("scenario")) {
+        return read_scenario_file(_vm["scenario"].as<std::string>(), _cmd.scenario);
+    }
+
+    if(_vm.count("scenario_stop") || _vm.count("scenario_status")) {
+        _cmd.scenario.command = _vm.count("scenario_stop") ? STOP_SCENARIO : SCENARIO_STATUS;
+        return 0;
+    }
+
+    // the original message can only replace an operation's faults, and
+    // has no triggers, queues or caller filters
+    _cmd.msg_type = BATCH_MSG_TYPE;
+    mungefs_rule rule;
+    const bool triggers = fill_triggers(_vm, rule);
+    const bool callers = fill_callers(_vm, rule);
+    if(triggers || callers || _vm.count("add")) {
+        rule.action = _vm.count("add") ? ADD_FAULT : SET_FAULT;
+        int err = fill_fault(_vm, rule);
+        _cmd.batch.rules.push_back(rule);
+        return err;
+    }
+
+    if(_vm.count("rules") || _vm.count("replace_all")) {
+        _cmd.batch.replace_all = (_vm.count("replace_all") > 0);
+        if(!_vm.count("rules")) {
+            return 0;
+        }
+
+        return parse_rules_file(_vm["rules"].as<std::string>(), _cmd.batch);
+    }
+
+    _cmd.msg_type = 0;
+    return fill_fault(_vm, _cmd.ctl);
+} // parse_command
+
+message_broker::data_type encode_command(const command& _cmd) {
+    if(BATCH_MSG_TYPE == _cmd.msg_type) {
+        return encode_message(BATCH_MSG_TYPE, _cmd.batch);
+    }
+
+    if(SCENARIO_MSG_TYPE == _cmd.msg_type) {
+        return encode_message(SCENARIO_MSG_TYPE, _cmd.scenario);
+    }
+
+    if(STATS_MSG_TYPE == _cmd.msg_type) {
+        return encode_message(STATS_MSG_TYPE);
+    }
+
+    if(SNAPSHOT_MSG_TYPE == _cmd.msg_type) {
+        return encode_message(SNAPSHOT_MSG_TYPE, _cmd.snapshot);
+    }
+
+    if(POWER_MSG_TYPE == _cmd.msg_type) {
+        return encode_message(POWER_MSG_TYPE, _cmd.power);
+    }
+
+    auto out = avro::memoryOutputStream();
+    auto enc = avro::binaryEncoder();
+    enc->init( *out );
+    avro::encode( *enc, _cmd.ctl );
+    enc->flush();
+    auto data = avro::snapshot( *out );
+    return *data;
+} // encode_command
+
+// print the outcome of a batch, returning non zero if it was not applied
+int print_reply(const mungefs_reply& _reply) {
+    for(size_t i = 0; i < _reply.statuses.size(); ++i) {
+        const auto& status = _reply.statuses[i];
+        if(status.error) {
+            std::cerr << "rule " << i + 1 << ": "
+                      << status.message
+                      << " [" << strerror(-status.error) << "]"
+                      << std::endl;
+        }
+    }
+
+    std::cout << (_reply.applied ? "applied" : "rejected")
+              << ", generation " << _reply.generation << std::endl;
+    return _reply.applied ? 0 : 1;
+} // print_reply
+
+// print the state of the scenario, returning non zero on an error
+int print_scenario_status(const mungefs_scenario_status& _status) {
+    if(_status.error) {
+        std::cerr << _status.message
+                  << " [" << strerror(-_status.error) << "]"
+                  << std::endl;
+    }
+
+    if(_status.name.empty()) {
+        std::cout << "no scenario" << std::endl;
+        return _status.error ? 1 : 0;
+    }
+
+    std::cout << "scenario: " << _status.name << std::endl
+              << "running: " << (_status.running ? "yes" : "no") << std::endl
+              << "step: " << _status.step << "/" << _status.steps << std::endl
+              << "elapsed_us: " << _status.elapsed_us << std::endl;
+    if(_status.next_at_us >= 0) {
+        std::cout << "next_at_us: " << _status.next_at_us << std::endl;
+    }
+
+    return _status.error ? 1 : 0;
+} // print_scenario_status
+
+// print the state of the snapshot, returning non zero on an error
+int print_snapshot_status(const mungefs_snapshot_status& _status) {
+    if(_status.error) {
+        std::cerr << _status.message
+                  << " [" << strerror(-_status.error) << "]"
+                  << std::endl;
+    }
+    else if(!_status.message.empty()) {
+        std::cout << _status.message << std::endl;
+    }
+
+    if(!_status.active) {
+        std::cout << "no snapshot" << std::endl;
+        return _status.error ? 1 : 0;
+    }
+
+    std::cout << "snapshot: " << _status.root << std::endl
+              << "store: " << _status.store << std::endl
+              << "epoch: " << _status.epoch << std::endl
+              << "entries: " << _status.entries << std::endl
+              << "reflinked: " << _status.cloned << std::endl
+              << "copied: " << _status.copied << std::endl
+              << "changed: " << _status.changed << std::endl
+              << "last_reset: " << _status.last_reset_paths << " paths in "
+              << _status.last_reset_us << "us" << std::endl;
+    return _status.error ? 1 : 0;
+} // print_snapshot_status
+
+// print what a power cut would lose and what the last one lost, returning
+// non zero on an error
+int print_power_status(const mungefs_power_status& _status) {
+    if(_status.error) {
+        std::cerr << _status.message
+                  << " [" << strerror(-_status.error) << "]"
+                  << std::endl;
+    }
+    else if(!_status.message.empty()) {
+        std::cout << _status.message << std::endl;
+    }
+
+    if(!_status.enabled) {
+        return _status.error ? 1 : 0;
+    }
+
+    std::cout << "cycle: " << _status.cycle << std::endl
+              << "files: " << _status.files << std::endl
+              << "ranges: " << _status.ranges << std::endl
+              << "unsynced_bytes: " << _status.unsynced_bytes << std::endl
+              << "widened: " << _status.widened << std::endl
+              << "last_cut: " << _status.last_cut_files << " files in "
+              << _status.last_cut_us << "us" << std::endl
+              << "last_cut_lost_bytes: " << _status.last_cut_lost_bytes << std::endl
+              << "last_cut_kept_bytes: " << _status.last_cut_kept_bytes << std::endl
+              << "last_cut_truncated_bytes: " << _status.last_cut_truncated_bytes << std::endl
+              << "last_cut_failed: " << _status.last_cut_failed << std::endl;
+    return _status.error ? 1 : 0;
+} // print_power_status
 
-    if(vm.count("err_no")) {
-        _ctl_out.err_no = vm["err_no"].as<int>();
+// print the counters of every fault, one per line
+int print_stats(const mungefs_stats& _stats) {
+    std::cout << "generation " << _stats.generation << std::endl;
+    for(const auto& rule : _stats.rules) {
+        std::cout << rule.operation << "[" << rule.position << "]"
+                  << " id " << rule.id
+                  << " regexp '" << rule.regexp << "'"
+                  << " calls " << rule.calls
+                  << " fires " << rule.fires;
+        if(rule.queue_depth) {
+            std::cout << " queue_depth " << rule.queue_depth
+                      << " in_flight " << rule.in_flight
+                      << " queued " << rule.queued
+                      << " waited " << rule.queue_waits
+                      << " wait_us " << rule.queue_wait_us
+                      << " max_wait_us " << rule.queue_wait_max_us;
+        }
+        std::cout << std::endl;
     }
 
-    if(vm.count("probability")) {
-        _ctl_out.probability = vm["probability"].as<long>();
+    return 0;
+} // print_stats
+
+// one line per fault that fired, with the wall clock time it fired at
+void print_journal_event(const mungefs_journal_event& _e) {
+    time_t seconds = _e.wall_ns / 1000000000;
+    struct tm tm;
+    localtime_r(&seconds, &tm);
+    char wall[64];
+    size_t n = strftime(wall, sizeof(wall), "%Y-%m-%d %H:%M:%S", &tm);
+    snprintf(wall + n, sizeof(wall) - n, ".%06lld",
+             static_cast<long long>(_e.wall_ns % 1000000000 / 1000));
+
+    std::cout << _e.seq << " " << wall
+              << " mono_ns " << _e.mono_ns
+              << " rule " << _e.rule_id
+              << " pid " << _e.pid
+              << " " << _e.operation
+              << " " << (_e.truncated ? "..." : "") << _e.path
+              << " err_no " << _e.err_no
+              << " delay_us " << _e.delay_us;
+    if(_e.corrupted) {
+        std::cout << " corrupted";
     }
+    if(_e.killed) {
+        std::cout << " killed";
+    }
+    std::cout << std::endl;
+} // print_journal_event
 
-    if(vm.count("regexp")) {
-        _ctl_out.regexp = vm["regexp"].as<std::string>();
+// print the journal from _after_seq on, and when following, keep asking
+// for what fired since until interrupted
+int run_journal(
+    const std::string& _endpoint,
+    int64_t            _after_seq,
+    bool               _follow) {
+    mungefs_client client(_endpoint);
+    int64_t next = _after_seq;
+    int64_t missed = 0;
+    int64_t lost = 0;
+    while(true) {
+        const mungefs_journal_reply journal = client.journal(next);
+        if(journal.error) {
+            std::cerr << journal.message
+                      << " [" << strerror(-journal.error) << "]"
+                      << std::endl;
+            return 1;
+        }
+
+        for(const auto& e : journal.events) {
+            missed += e.seq - next;
+            print_journal_event(e);
+            next = e.seq + 1;
+        }
+
+        // what the reply skipped over was overwritten or lost
+        missed += journal.next_seq - next;
+        next = journal.next_seq;
+        lost = journal.lost;
+
+        if(journal.events.empty()) {
+            if(!_follow) {
+                break;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
     }
 
-    if(vm.count("delay_us")) {
-        _ctl_out.delay_us = vm["delay_us"].as<long>();
+    if(missed) {
+        std::cerr << missed << " events missed, " << lost
+                  << " lost by the mount since it started" << std::endl;
     }
 
     return 0;
-} // parse_program_options
+} // run_journal
+
+// one line describing the reply to a streamed command, returning non zero
+// if the command failed
+int summarize_reply(
+    const message_broker::data_type& _msg,
+    const uint8_t                    _msg_type,
+    std::string&                     _text) {
+    std::stringstream ss;
+    uint8_t type = 0;
+    if(!_msg_type) {
+        _text = ACK_MSG == _msg ? "ack" : "unexpected reply";
+        return ACK_MSG == _msg ? 0 : 1;
+    }
+
+    const uint8_t expected = BATCH_MSG_TYPE == _msg_type    ? REPLY_MSG_TYPE :
+                             STATS_MSG_TYPE == _msg_type    ? STATS_REPLY_MSG_TYPE :
+                             SNAPSHOT_MSG_TYPE == _msg_type ? SNAPSHOT_STATUS_MSG_TYPE :
+                             POWER_MSG_TYPE == _msg_type    ? POWER_STATUS_MSG_TYPE :
+                                                              SCENARIO_STATUS_MSG_TYPE;
+    if(!get_message_type(_msg, type) || expected != type) {
+        _text = "unexpected reply";
+        return 1;
+    }
+
+    if(STATS_REPLY_MSG_TYPE == type) {
+        mungefs_stats stats;
+        decode_message(_msg, stats);
+        int64_t calls = 0;
+        int64_t fires = 0;
+        for(const auto& rule : stats.rules) {
+            calls += rule.calls;
+            fires += rule.fires;
+        }
+
+        ss << "generation " << stats.generation << ", " << stats.rules.size()
+           << " faults, " << calls << " calls, " << fires << " fires";
+        _text = ss.str();
+        return 0;
+    }
+
+    if(REPLY_MSG_TYPE == type) {
+        mungefs_reply reply;
+        decode_message(_msg, reply);
+        ss << (reply.applied ? "applied" : "rejected")
+           << ", generation " << reply.generation;
+        for(size_t i = 0; i < reply.statuses.size(); ++i) {
+            if(reply.statuses[i].error) {
+                ss << "; rule " << i + 1 << ": " << reply.statuses[i].message;
+            }
+        }
+
+        _text = ss.str();
+        return reply.applied ? 0 : 1;
+    }
+
+    if(SNAPSHOT_STATUS_MSG_TYPE == type) {
+        mungefs_snapshot_status snapshot;
+        decode_message(_msg, snapshot);
+        if(snapshot.message.empty()) {
+            ss << (snapshot.active ? "snapshot of " + snapshot.root : std::string("no snapshot"));
+        }
+        else {
+            ss << snapshot.message;
+        }
+
+        if(snapshot.active) {
+            ss << ", " << snapshot.changed << " paths changed";
+        }
+
+        _text = ss.str();
+        return snapshot.error ? 1 : 0;
+    }
+
+    if(POWER_STATUS_MSG_TYPE == type) {
+        mungefs_power_status power;
+        decode_message(_msg, power);
+        if(power.message.empty()) {
+            ss << power.unsynced_bytes << " bytes unsynced in " << power.files << " files";
+        }
+        else {
+            ss << power.message;
+        }
+
+        _text = ss.str();
+        return power.error ? 1 : 0;
+    }
+
+    mungefs_scenario_status status;
+    decode_message(_msg, status);
+    if(status.error) {
+        ss << status.message;
+    }
+    else if(status.name.empty()) {
+        ss << "no scenario";
+    }
+    else {
+        ss << "scenario " << status.name
+           << (status.running ? " running" : " stopped")
+           << ", step " << status.step << "/" << status.steps;
+    }
+
+    _text = ss.str();
+    return status.error ? 1 : 0;
+} // summarize_reply
+
+// lines read from a descriptor as they arrive, so replies can be reported
+// while the writer of the stream waits on them
+class line_reader {
+public:
+    explicit line_reader(int _fd) : fd_(_fd), eof_(false) {
+    }
+
+    int fd() const {
+        return fd_;
+    }
+
+    bool eof() const {
+        return eof_;
+    }
+
+    // read what is available, returns false on a read error
+    bool fill() {
+        char buf[65536];
+        ssize_t n = read(fd_, buf, sizeof(buf));
+        if(n < 0) {
+            return EINTR == errno || EAGAIN == errno;
+        }
+
+        if(0 == n) {
+            eof_ = true;
+            return true;
+        }
+
+        buffer_.append(buf, n);
+        return true;
+    }
+
+    // the next complete line, or the unterminated last one at eof
+    bool next(std::string& _line) {
+        size_t end = buffer_.find('\n');
+        if(std::string::npos == end) {
+            if(!eof_ || buffer_.empty()) {
+                return false;
+            }
+
+            end = buffer_.size();
+        }
+
+        _line = buffer_.substr(0, end);
+        buffer_.erase(0, std::min(end + 1, buffer_.size()));
+        return true;
+    }
+
+private:
+    int         fd_;
+    bool        eof_;
+    std::string buffer_;
+}; // class line_reader
+
+// commands sent but not yet answered, mungefs answers them in order
+struct pending_command {
+    size_t                                line_no;
+    uint8_t                               msg_type;
+    std::chrono::steady_clock::time_point sent;
+};
+
+// most commands in flight on a stream at once
+static const size_t stream_window = 64;
+
+// run every line of _fd as a command over one connection, printing the
+// line number, outcome and round trip of each as its reply arrives
+int run_stream(
+    const std::string& _endpoint,
+    int                _fd) {
+    namespace po = boost::program_options;
+    typedef message_broker::data_type data_t;
+    typedef std::chrono::steady_clock clock_t;
+
+    message_broker bro("ZMQ_DEALER");
+    bro.connect(_endpoint);
+
+    const auto opt_desc = command_options();
+    line_reader reader(_fd);
+    std::deque<pending_command> pending;
+    size_t line_no = 0;
+    size_t commands = 0;
+    size_t failed = 0;
+    size_t replies = 0;
+    int64_t max_us = 0;
+    int64_t total_us = 0;
+    const auto started = clock_t::now();
+
+    auto report = [&](size_t _line_no, int _err, int64_t _us, const std::string& _text) {
+        std::cout << _line_no << " " << (_err ? "failed" : "ok")
+                  << " " << _us << "us " << _text << std::endl;
+        ++commands;
+        failed += _err ? 1 : 0;
+    };
+
+    while(!reader.eof() || !pending.empty()) {
+        // send every complete line the window allows
+        std::string line;
+        while(pending.size() < stream_window && reader.next(line)) {
+            ++line_no;
+            boost::trim(line);
+            if(line.empty() || '#' == line[0]) {
+                continue;
+            }
+
+            command cmd;
+            int err = 0;
+            try {
+                po::variables_map vm;
+                po::store(
+                    po::command_line_parser(
+                        po::split_unix(line, " \t", "'\"", "") ).options(
+                        opt_desc ).run(), vm );
+                po::notify( vm );
+                err = parse_command(vm, cmd);
+            }
+            catch(const po::error& _e ) {
+                report(line_no, 1, 0, _e.what());
+                continue;
+            }
+
+            if(err) {
+                report(line_no, 1, 0, "invalid command");
+                continue;
+            }
+
+            bro.send_envelope(encode_command(cmd));
+            pending.push_back(pending_command{line_no, cmd.msg_type, clock_t::now()});
+        }
+
+        zmq::pollitem_t items[] = {
+            { static_cast<void*>(bro.socket()), 0, ZMQ_POLLIN, 0 },
+            { NULL, reader.fd(), ZMQ_POLLIN, 0 }
+        };
+
+        // stop reading while the window is full, and give up on a mount
+        // that has not answered in time
+        const bool want_lines = !reader.eof() && pending.size() < stream_window;
+        const long timeout_ms = pending.empty() ? -1 :
+                                SNAPSHOT_MSG_TYPE == pending.front().msg_type ? SNAPSHOT_REPLY_WAIT_MS :
+                                POWER_MSG_TYPE == pending.front().msg_type    ? SNAPSHOT_REPLY_WAIT_MS :
+                                1500;
+        int ready = zmq::poll(items, want_lines ? 2 : 1, timeout_ms);
+        if(0 == ready) {
+            std::cerr << "no reply from mungefs" << std::endl;
+            return 1;
+        }
+
+        if(items[0].revents & ZMQ_POLLIN) {
+            data_t msg;
+            bro.receive_envelope(msg);
+            const pending_command cmd = pending.front();
+            pending.pop_front();
+
+            const int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                   clock_t::now() - cmd.sent).count();
+            max_us = std::max(max_us, us);
+            total_us += us;
+            ++replies;
+
+            std::string text;
+            int err = summarize_reply(msg, cmd.msg_type, text);
+            report(cmd.line_no, err, us, text);
+        }
+
+        if(want_lines && (items[1].revents & ZMQ_POLLIN) && !reader.fill()) {
+            std::cerr << "failed to read commands [" << strerror(errno) << "]" << std::endl;
+            return 1;
+        }
+    }
+
+    const int64_t elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                   clock_t::now() - started).count();
+    std::cerr << commands << " commands, " << failed << " failed in "
+              << elapsed_us << "us";
+    if(replies) {
+        std::cerr << ", mean round trip " << total_us / static_cast<int64_t>(replies)
+                  << "us, max " << max_us << "us";
+    }
+    std::cerr << std::endl;
+
+    return failed ? 1 : 0;
+} // run_stream
 
 int main(
     int   _argc,
     char* _argv[]) {
+    namespace po = boost::program_options;
     typedef message_broker::data_type data_t;
-   
-    try { 
-        mungefs_ctl ctl;
-        int err = parse_program_options(_argc, _argv, ctl);
+
+    po::options_description opt_desc( "options" );
+    opt_desc.add_options()
+    ( "help,h", "show command usage" )
+    ( "endpoint", po::value<std::string>(), "control socket of the mount" )
+    ( "mountpoint", po::value<std::string>(), "find the control socket from the mountpoint" )
+    ( "stdin", "run the commands read from stdin over one connection" )
+    ( "batch", po::value<std::string>(), "run the commands in a file over one connection" )
+    ( "journal", "show the faults that fired" )
+    ( "journal_follow", "then keep showing faults as they fire" )
+    ( "journal_after", po::value<int64_t>(), "start from this sequence number" );
+    opt_desc.add(command_options());
+
+    po::variables_map vm;
+    try {
+        po::store(
+            po::command_line_parser(
+                _argc, _argv ).options(
+                opt_desc ).run(), vm );
+        po::notify( vm );
+    }
+    catch(const po::error& _e ) {
+        std::cerr << std::endl
+                  << "Error: "
+                  << _e.what()
+                  << std::endl
+                  << std::endl;
+        return usage(std::cerr);
+    }
+
+    if(vm.count("help")) {
+        return usage(std::cout);
+    }
+
+    std::string endpoint;
+    if(find_endpoint(vm, endpoint)) {
+        return 1;
+    }
+
+    try {
+        if(vm.count("stdin")) {
+            return run_stream(endpoint, STDIN_FILENO);
+        }
+
+        if(vm.count("journal") || vm.count("journal_follow")) {
+            return run_journal(
+                       endpoint,
+                       vm.count("journal_after") ? vm["journal_after"].as<int64_t>() : 0,
+                       vm.count("journal_follow") > 0);
+        }
+
+        if(vm.count("batch")) {
+            const std::string path = vm["batch"].as<std::string>();
+            int fd = open(path.c_str(), O_RDONLY);
+            if(fd < 0) {
+                std::cerr << "failed to open command file [" << path << "]" << std::endl;
+                return 1;
+            }
+
+            int err = run_stream(endpoint, fd);
+            close(fd);
+            return err;
+        }
+
+        command cmd;
+        int err = parse_command(vm, cmd);
         if(err) {
             return err;
         }
 
-        //print_ctl(ctl);
+        // the original message is only acknowledged
+        if(!cmd.msg_type) {
+            message_broker bro("ZMQ_REQ");
+            bro.connect(endpoint);
+            bro.send(encode_command(cmd));
 
-        auto out = avro::memoryOutputStream();
-        auto enc = avro::binaryEncoder();
-        enc->init( *out );
-        avro::encode( *enc, ctl );
-        auto data = avro::snapshot( *out );
+            data_t rcv_msg;
+            bro.receive(rcv_msg);
+            return 0;
+        }
 
-        message_broker bro("ZMQ_REQ");
-        bro.connect("tcp://localhost:9000");
-        bro.send(*data);
+        mungefs_client client(endpoint);
+        if(BATCH_MSG_TYPE == cmd.msg_type) {
+            return print_reply(client.apply(cmd.batch));
+        }
+
+        if(STATS_MSG_TYPE == cmd.msg_type) {
+            return print_stats(client.stats());
+        }
 
-        data_t msg;
-        bro.receive(msg);
-        
-        //std::cout << msg << std::endl;
+        if(SNAPSHOT_MSG_TYPE == cmd.msg_type) {
+            return print_snapshot_status(client.snapshot_async(cmd.snapshot).get());
+        }
+
+        if(POWER_MSG_TYPE == cmd.msg_type) {
+            return print_power_status(client.power_async(cmd.power).get());
+        }
+
+        return print_scenario_status(client.scenario_async(cmd.scenario).get());
     }
     catch( const message_broker::exception& _e) {
         std::cerr << _e.what() << std::endl;
         return 1;
     }
+    catch( const std::runtime_error& _e) {
+        std::cerr << _e.what() << std::endl;
+        return 1;
+    }
 
     return 0;
 }
 
-
-